@@ -0,0 +1,323 @@
+/*
+ * Aggregation stage benchmark: runs generated reading streams through
+ * sample_aggregate.c and checks each window's summary against a reference
+ * computed in double precision from the same readings, two passes over the
+ * buffered window. The usual single-pass alternative on a small MCU, float
+ * sums of the values and of their squares, is checked the same way.
+ *
+ * Streams, each with windows of 6, 12, 60 and 720 readings:
+ *   - BME280 noise around a slow drift (datasheet RMS noise, filter off)
+ *   - DHT11 whole-degree and whole-percent steps
+ *   - BME280 with a door opening in some windows (steps of several degC,
+ *     %RH and tens of Pa), the worst case for a running mean
+ * Mean and standard deviation errors are in sample units (0.01 degC,
+ * 0.01 %RH, Pa); minimum and maximum must be exact.
+ *
+ * Then reports the memory a window takes against buffering its readings,
+ * the time per reading, and the bytes a generated day takes on the uplink
+ * as summaries plus raw breaches, against batches of every reading and of
+ * the samples the filtering stage passes on. Every summary is decoded back
+ * and compared with the one encoded.
+ *
+ * usage: aggregate_bench [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "sample_aggregate.h"
+#include "sample_codec.h"
+#include "sample_filter.h"
+
+#define BENCH_WINDOWS 2000
+#define BENCH_MAX_WINDOW 720
+#define BENCH_DAY_S 86400
+#define BENCH_PERIOD_S 5
+#define BENCH_BATCH 6
+#define BENCH_TIMED_READINGS 10000000
+
+typedef enum
+{
+    STREAM_BME280 = 0,
+    STREAM_DHT11,
+    STREAM_DOOR,
+    STREAM_COUNT
+} bench_stream_t;
+
+typedef struct
+{
+    double mean_max;
+    double stddev_max;
+    uint32_t minmax_wrong;
+} bench_error_t;
+
+static const char *const s_stream_names[STREAM_COUNT] = { "BME280 noise", "DHT11 steps", "BME280 door" };
+static const char *const s_channel_names[SAMPLE_AGGREGATE_CHANNELS] = { "temperature", "humidity", "pressure" };
+static const uint8_t s_channel_flags[SAMPLE_AGGREGATE_CHANNELS] = {
+    SAMPLE_HAS_TEMPERATURE, SAMPLE_HAS_HUMIDITY, SAMPLE_HAS_PRESSURE,
+};
+static const size_t s_window_lengths[] = { 6, 12, 60, 720 };
+
+// Firmware defaults (main.c)
+static const sample_aggregate_config_t s_config = { .window_s = 60, .breach = { 200, 1000, 200 } };
+static const sample_filter_config_t s_filter_config = { .ewma_shift = 2, .deadband = { 20, 100, 20 },
+                                                        .heartbeat_s = 600 };
+
+static sensor_sample_t s_window[BENCH_MAX_WINDOW];
+static uint32_t s_rand = 1;
+
+static double bench_uniform(void)
+{
+    // xorshift32, reproducible across hosts
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return (s_rand + 0.5) / 4294967296.0;
+}
+
+static double bench_gauss(double sigma)
+{
+    return sigma * sqrt(-2.0 * log(bench_uniform())) * cos(2.0 * M_PI * bench_uniform());
+}
+
+static int32_t channel_value(const sensor_sample_t *sample, int channel)
+{
+    return channel == 0 ? sample->temperature : channel == 1 ? sample->humidity : (int32_t)sample->pressure;
+}
+
+/* Indoor day: temperature and humidity follow the heating, opposite ways. */
+static void indoor(double t, double *temperature, double *humidity, double *pressure)
+{
+    double day = sin(2.0 * M_PI * (t / BENCH_DAY_S - 0.3));
+    *temperature = 2250.0 + 180.0 * day + 30.0 * sin(2.0 * M_PI * t / 5400.0);
+    *humidity = 5200.0 - 700.0 * day;
+    *pressure = 101300.0 + 400.0 * sin(2.0 * M_PI * t / (2.5 * BENCH_DAY_S)) + 40.0 * sin(2.0 * M_PI * t / 43200.0);
+}
+
+/* A door open for a minute or two, about twice an hour: colder, damper air and a pressure dip. */
+static void door(double t, double *temperature, double *humidity, double *pressure)
+{
+    double phase = fmod(t, 1800.0);
+    double open = phase >= 600.0 && phase < 600.0 + 60.0 + 60.0 * (fmod(t / 1800.0, 2.0) >= 1.0) ? 1.0 : 0.0;
+
+    *temperature -= 600.0 * open;
+    *humidity += 1500.0 * open;
+    *pressure -= 30.0 * open;
+}
+
+static sensor_sample_t reading(bench_stream_t stream, uint32_t t)
+{
+    sensor_sample_t s = { .timestamp = t, .flags = SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY };
+    double temperature, humidity, pressure;
+
+    indoor(t, &temperature, &humidity, &pressure);
+    if (stream == STREAM_DHT11) {
+        s.sensor = SAMPLE_SENSOR_ID(SAMPLE_SENSOR_DHT, 0);
+        s.temperature = lround((temperature + bench_gauss(30.0)) / 100.0) * 100;
+        s.humidity = lround((humidity + bench_gauss(50.0)) / 100.0) * 100;
+        return s;
+    }
+    if (stream == STREAM_DOOR) {
+        door(t, &temperature, &humidity, &pressure);
+    }
+    s.sensor = SAMPLE_SENSOR_ID(SAMPLE_SENSOR_BME280, 0);
+    s.flags |= SAMPLE_HAS_PRESSURE;
+    s.temperature = lround(temperature + bench_gauss(0.5));
+    s.humidity = lround(humidity + bench_gauss(2.0));
+    s.pressure = lround(pressure + bench_gauss(2.5));
+    return s;
+}
+
+/* Two-pass mean and population standard deviation of a buffered window, in double. */
+static void reference(const sensor_sample_t *window, size_t n, int ch, double *mean, double *stddev,
+                      int32_t *min, int32_t *max)
+{
+    double sum = 0.0, sq = 0.0;
+
+    *min = *max = channel_value(&window[0], ch);
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = channel_value(&window[i], ch);
+        sum += v;
+        *min = v < *min ? v : *min;
+        *max = v > *max ? v : *max;
+    }
+    *mean = sum / n;
+    for (size_t i = 0; i < n; i++) {
+        double d = channel_value(&window[i], ch) - *mean;
+        sq += d * d;
+    }
+    *stddev = sqrt(sq / n);
+}
+
+/* Single pass over float sums: variance as mean of squares minus square of mean. */
+static void float_sums(const sensor_sample_t *window, size_t n, int ch, double *mean, double *stddev)
+{
+    float sum = 0.0f, sum_sq = 0.0f;
+
+    for (size_t i = 0; i < n; i++) {
+        float v = (float)channel_value(&window[i], ch);
+        sum += v;
+        sum_sq += v * v;
+    }
+    float m = sum / n;
+    float var = sum_sq / n - m * m;
+    *mean = m;
+    *stddev = var > 0.0f ? sqrtf(var) : 0.0f;
+}
+
+static void error_add(bench_error_t *e, double mean, double ref_mean, double stddev, double ref_stddev)
+{
+    e->mean_max = fmax(e->mean_max, fabs(mean - ref_mean));
+    e->stddev_max = fmax(e->stddev_max, fabs(stddev - ref_stddev));
+}
+
+static void accuracy(bench_stream_t stream, size_t n)
+{
+    bench_error_t fixed[SAMPLE_AGGREGATE_CHANNELS] = { 0 };
+    bench_error_t floats[SAMPLE_AGGREGATE_CHANNELS] = { 0 };
+    sample_aggregate_t aggregate;
+    size_t windows = n > 60 ? BENCH_WINDOWS / 10 : BENCH_WINDOWS;
+    uint32_t t = 0;
+
+    memset(&aggregate, 0, sizeof(aggregate));
+    for (size_t w = 0; w < windows; w++) {
+        sample_summary_t summary;
+        for (size_t i = 0; i < n; i++, t += BENCH_PERIOD_S) {
+            s_window[i] = reading(stream, t);
+            sample_aggregate_add(&aggregate, &s_config, &s_window[i], t);
+        }
+        sample_aggregate_close(&aggregate, &summary);
+        for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+            double ref_mean, ref_stddev, mean, stddev;
+            int32_t min, max;
+            if (!(summary.flags & s_channel_flags[ch])) {
+                continue;
+            }
+            reference(s_window, n, ch, &ref_mean, &ref_stddev, &min, &max);
+            error_add(&fixed[ch], summary.channels[ch].mean, ref_mean, summary.channels[ch].stddev, ref_stddev);
+            fixed[ch].minmax_wrong += summary.channels[ch].min != min || summary.channels[ch].max != max;
+            float_sums(s_window, n, ch, &mean, &stddev);
+            error_add(&floats[ch], mean, ref_mean, stddev, ref_stddev);
+        }
+    }
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        if (stream == STREAM_DHT11 && ch == 2) {
+            continue;
+        }
+        printf("  %-12s %4zu readings x %4zu: Welford mean %.2f sd %.2f%s | float sums mean %.2f sd %.2f\n",
+               s_channel_names[ch], n, windows, fixed[ch].mean_max, fixed[ch].stddev_max,
+               fixed[ch].minmax_wrong ? " MIN/MAX WRONG" : "", floats[ch].mean_max, floats[ch].stddev_max);
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void timing(void)
+{
+    sample_aggregate_t aggregate;
+    sample_summary_t summary;
+    volatile uint32_t sink = 0;
+
+    for (size_t i = 0; i < BENCH_MAX_WINDOW; i++) {
+        s_window[i] = reading(STREAM_BME280, i * BENCH_PERIOD_S);
+    }
+    memset(&aggregate, 0, sizeof(aggregate));
+    double start = now_s();
+    for (uint32_t i = 0; i < BENCH_TIMED_READINGS; i++) {
+        sample_aggregate_add(&aggregate, &s_config, &s_window[i % 60], i);
+        if (i % 60 == 59) {
+            sample_aggregate_close(&aggregate, &summary);
+            sink += summary.channels[2].stddev;
+        }
+    }
+    double elapsed = now_s() - start;
+    printf("Time: %.1f ns per reading, three channels, window closes included (host)\n",
+           elapsed * 1e9 / BENCH_TIMED_READINGS);
+}
+
+/* A day of BME280 readings with the door stream: bytes on the uplink, both ways. */
+static void uplink(void)
+{
+    sample_aggregate_t aggregate;
+    sample_filter_t filter;
+    sensor_sample_t batch[BENCH_BATCH], raw[BENCH_BATCH];
+    uint8_t buf[SAMPLE_CODEC_BATCH_SIZE(BENCH_BATCH)];
+    size_t batch_count = 0, readings = 0, filtered = 0, filtered_msgs = 0, filtered_bytes = 0, raw_bytes = 0;
+    size_t summaries = 0, summary_bytes = 0, breaches = 0, breach_bytes = 0, mismatches = 0;
+
+    memset(&aggregate, 0, sizeof(aggregate));
+    memset(&filter, 0, sizeof(filter));
+    filter.sensor = SAMPLE_SENSOR_ID(SAMPLE_SENSOR_BME280, 0);
+    for (uint32_t t = 0; t < BENCH_DAY_S; t += BENCH_PERIOD_S) {
+        sensor_sample_t s = reading(STREAM_DOOR, t);
+        sensor_sample_t f = s;
+        sample_summary_t summary;
+        raw[readings++ % BENCH_BATCH] = s;
+        if (readings % BENCH_BATCH == 0) {
+            raw_bytes += sample_codec_encode(raw, BENCH_BATCH, buf, sizeof(buf));
+        }
+
+        if (sample_aggregate_due(&aggregate, &s_config, t, &s)) {
+            sample_summary_t decoded;
+            sample_aggregate_close(&aggregate, &summary);
+            size_t len = sample_summary_encode(&summary, buf, sizeof(buf));
+            mismatches += !sample_summary_decode(buf, len, &decoded) || memcmp(&decoded.channels, &summary.channels,
+                                                                               sizeof(summary.channels)) != 0;
+            summaries++;
+            summary_bytes += len;
+        }
+        if (sample_aggregate_add(&aggregate, &s_config, &s, t)) {
+            breaches++;
+            breach_bytes += sample_codec_encode(&s, 1, buf, sizeof(buf));
+        }
+
+        // Filtering stage with the firmware's batches, flushed when full only
+        if (sample_filter_apply(&filter, &s_filter_config, &f)) {
+            filtered++;
+            batch[batch_count++] = f;
+            if (batch_count == BENCH_BATCH) {
+                filtered_bytes += sample_codec_encode(batch, batch_count, buf, sizeof(buf));
+                filtered_msgs++;
+                batch_count = 0;
+            }
+        }
+    }
+    printf("Uplink, BME280 with door openings, a day at %u s: %zu readings\n", BENCH_PERIOD_S, readings);
+    printf("  every reading, batches of %u: %zu messages, %zu bytes\n", BENCH_BATCH, readings / BENCH_BATCH,
+           raw_bytes);
+    printf("  filtering stage, batches of %u: %zu samples in %zu messages, %zu bytes\n", BENCH_BATCH, filtered,
+           filtered_msgs, filtered_bytes);
+    printf("  aggregation, %u s windows: %zu summaries, %zu bytes; %zu breaches passed on raw, %zu bytes%s\n",
+           s_config.window_s, summaries, summary_bytes, breaches, breach_bytes,
+           mismatches ? "; SUMMARIES DECODED WRONG" : "");
+}
+
+int main(int argc, char **argv)
+{
+    s_rand = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    if (s_rand == 0) {
+        s_rand = 1;
+    }
+    _Static_assert(BENCH_MAX_WINDOW <= UINT16_MAX, "window readings are counted in 16 bits");
+    printf("Largest error against the double two-pass reference, sample units:\n");
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        printf("%s\n", s_stream_names[stream]);
+        for (size_t i = 0; i < sizeof(s_window_lengths) / sizeof(s_window_lengths[0]); i++) {
+            accuracy((bench_stream_t)stream, s_window_lengths[i]);
+        }
+    }
+    printf("Memory: %zu bytes per sensor window, whatever its length; buffering %u readings takes %zu\n",
+           sizeof(sample_aggregate_t), BENCH_MAX_WINDOW, BENCH_MAX_WINDOW * sizeof(sensor_sample_t));
+    printf("        summary %u bytes at most encoded, %zu in memory\n", SAMPLE_SUMMARY_MAX_SIZE,
+           sizeof(sample_summary_t));
+    timing();
+    uplink();
+    return 0;
+}
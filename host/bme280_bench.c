@@ -0,0 +1,310 @@
+/*
+ * BME280 compensation benchmark: compensates millions of raw readings with
+ * the per-sample formulas the driver had before the pure API (reference
+ * below), with bme280_compensate_temperature/pressure/humidity one reading at
+ * a time, with bme280_compensate_fused() and with bme280_compensate_batch().
+ * Every result must match the reference bit for bit, and the datasheet's
+ * worked example must come out as printed there; the run exits with status 1
+ * otherwise. The 64-bit pressure formula is compared with the 32-bit one, and
+ * pressure compensated with the t_fine of the previous reading, as the driver
+ * did, with pressure compensated with its own.
+ *
+ * usage: bme280_bench [samples] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "i2c_bme280.h"
+
+#define BENCH_DEFAULT_SAMPLES 4000000
+#define BENCH_ROUNDS 5
+
+typedef struct
+{
+    int32_t t_fine;
+} ref_state_t;
+
+/* The driver's per-sample formulas, as they were: t_fine is a side effect. */
+static int32_t ref_temp(ref_state_t *s, const bme280_calib_t *c, int32_t adc_T)
+{
+    int32_t var1, var2, T;
+    var1 = ((((adc_T >> 3) - ((int32_t)c->dig_T1 << 1))) * ((int32_t)c->dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t)c->dig_T1)) * ((adc_T >> 4) - ((int32_t)c->dig_T1))) >> 12) * ((int32_t)c->dig_T3)) >> 14;
+
+    s->t_fine = var1 + var2;
+    T = (s->t_fine * 5 + 128) >> 8;
+    return T;
+}
+
+static uint32_t ref_press(const ref_state_t *s, const bme280_calib_t *c, int32_t adc_P)
+{
+    int32_t var1, var2;
+    uint32_t P;
+    var1 = (((int32_t)s->t_fine) >> 1) - (int32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)c->dig_P6);
+    var2 = var2 + ((var1 * ((int32_t)c->dig_P5)) << 1);
+    var2 = (var2 >> 2) + (((int32_t)c->dig_P4) << 16);
+    var1 = (((c->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)c->dig_P2) * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * ((int32_t)c->dig_P1)) >> 15);
+    if (var1 == 0) {
+        return 0;
+    }
+    P = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+    if (P < 0x80000000) {
+        P = (P << 1) / ((uint32_t)var1);
+    } else {
+        P = (P / (uint32_t)var1) * 2;
+    }
+    var1 = (((int32_t)c->dig_P9) * ((int32_t)(((P >> 3) * (P >> 3)) >> 13))) >> 12;
+    var2 = (((int32_t)(P >> 2)) * ((int32_t)c->dig_P8)) >> 13;
+    P = (uint32_t)((int32_t)P + ((var1 + var2 + c->dig_P7) >> 4));
+    return P;
+}
+
+static uint32_t ref_hum(const ref_state_t *s, const bme280_calib_t *c, int32_t adc_H)
+{
+    int32_t v_x1;
+
+    v_x1 = (s->t_fine - ((int32_t)76800));
+    v_x1 = (((((adc_H << 14) - (((int32_t)c->dig_H4) << 20) - (((int32_t)c->dig_H5) * v_x1)) +
+              ((int32_t)16384)) >> 15) *
+            (((((((v_x1 * ((int32_t)c->dig_H6)) >> 10) *
+                 (((v_x1 * ((int32_t)c->dig_H3)) >> 11) + ((int32_t)32768))) >> 10) +
+               ((int32_t)2097152)) * ((int32_t)c->dig_H2) + 8192) >> 14));
+    v_x1 = (v_x1 - (((((v_x1 >> 15) * (v_x1 >> 15)) >> 7) * ((int32_t)c->dig_H1)) >> 4));
+    v_x1 = (v_x1 < 0 ? 0 : v_x1);
+    v_x1 = (v_x1 > 419430400 ? 419430400 : v_x1);
+    return (uint32_t)(v_x1 >> 12);
+}
+
+/* Coefficients of the simulated sensor (sim_i2c.c), and of a datasheet example part. */
+static const bme280_calib_t s_calibs[] = {
+    { .dig_T1 = 28009, .dig_T2 = 25654, .dig_T3 = 50,
+      .dig_P1 = 39145, .dig_P2 = -10750, .dig_P3 = 3024, .dig_P4 = 5667, .dig_P5 = -120,
+      .dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+      .dig_H1 = 75, .dig_H2 = 362, .dig_H3 = 0, .dig_H4 = 324, .dig_H5 = 0, .dig_H6 = 30 },
+    { .dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+      .dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+      .dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+      .dig_H1 = 75, .dig_H2 = 356, .dig_H3 = 0, .dig_H4 = 340, .dig_H5 = 50, .dig_H6 = 30 },
+};
+
+/* Datasheet example (BMP280 datasheet 3.12): coefficients, raw readings and the results it prints. */
+static const bme280_calib_t s_datasheet_calib = {
+    .dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+    .dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+    .dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+};
+#define DATASHEET_ADC_T 519888
+#define DATASHEET_ADC_P 415148
+#define DATASHEET_T_FINE 128422
+#define DATASHEET_T 2508            // 25.08 degC
+#define DATASHEET_P 100653.27       // Pa, floating point formula
+#define DATASHEET_P64_TOLERANCE 0.05
+#define DATASHEET_P32_TOLERANCE 3   // the 32-bit formula resolves about 3 Pa
+
+static uint32_t s_rand;
+
+static uint32_t bench_rand(void)
+{
+    // xorshift32, reproducible across hosts
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void report(const char *name, double seconds, size_t samples)
+{
+    printf("  %-22s %8.2f ns/sample %8.1f Msamples/s\n", name, seconds * 1e9 / samples, samples / seconds / 1e6);
+}
+
+static bool check_datasheet_example(void)
+{
+    bme280_comp_t comp;
+    bme280_reading_t reading;
+    int32_t t_fine;
+
+    int32_t T = bme280_compensate_temperature(&s_datasheet_calib, DATASHEET_ADC_T, &t_fine);
+    uint32_t P64 = bme280_compensate_pressure64(&s_datasheet_calib, DATASHEET_ADC_P, t_fine);
+    uint32_t P = bme280_compensate_pressure(&s_datasheet_calib, DATASHEET_ADC_P, t_fine);
+    bme280_comp_init(&s_datasheet_calib, &comp);
+    bme280_compensate_fused(&comp, DATASHEET_ADC_T, DATASHEET_ADC_P, -1, &reading);
+
+    bool ok = t_fine == DATASHEET_T_FINE && T == DATASHEET_T &&
+              fabs(P64 / 256.0 - DATASHEET_P) <= DATASHEET_P64_TOLERANCE &&
+              fabs(P - DATASHEET_P) <= DATASHEET_P32_TOLERANCE &&
+              reading.t_fine == t_fine && reading.temperature == T && reading.pressure == P;
+    printf("datasheet example: t_fine %d T %d P %u Pa, 64-bit %u (%.2f Pa): %s\n",
+           t_fine, T, P, P64, P64 / 256.0, ok ? "matches" : "DIFFERENT");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SAMPLES;
+    s_rand = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (!count || !s_rand) {
+        fprintf(stderr, "usage: %s [samples] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    int32_t *adc_T = malloc(count * sizeof(*adc_T));
+    int32_t *adc_P = malloc(count * sizeof(*adc_P));
+    int32_t *adc_H = malloc(count * sizeof(*adc_H));
+    int32_t *ref_T = malloc(count * sizeof(*ref_T));
+    uint32_t *ref_P = malloc(count * sizeof(*ref_P));
+    uint32_t *ref_H = malloc(count * sizeof(*ref_H));
+    int32_t *out_T = malloc(count * sizeof(*out_T));
+    uint32_t *out_P = malloc(count * sizeof(*out_P));
+    uint32_t *out_H = malloc(count * sizeof(*out_H));
+    if (!adc_T || !adc_P || !adc_H || !ref_T || !ref_P || !ref_H || !out_T || !out_P || !out_H) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    // Raw values over the sensor's operating range, -40..85 degC and 300..1100 hPa, and
+    // the whole 16-bit humidity range
+    for (size_t i = 0; i < count; i++) {
+        adc_T[i] = 0x60000 + bench_rand() % 0x50000;
+        adc_P[i] = 0x30000 + bench_rand() % 0x70000;
+        adc_H[i] = bench_rand() & 0xFFFF;
+    }
+
+    unsigned failures = !check_datasheet_example();
+    for (size_t k = 0; k < sizeof(s_calibs) / sizeof(s_calibs[0]); k++) {
+        const bme280_calib_t *calib = &s_calibs[k];
+        double best_ref = 1e9, best_scalar = 1e9, best_fused = 1e9, best_batch = 1e9, best_p64 = 1e9;
+        uint64_t cycles_ref = UINT64_MAX, cycles_fused = UINT64_MAX;
+        size_t mismatches = 0;
+        uint32_t p64_diff_max = 0, stale_diff_max = 0;
+        bme280_comp_t comp;
+        uint32_t sink = 0;
+
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            ref_state_t state = { 0 };
+            uint64_t c0 = cycles();
+            double t0 = now_s();
+            for (size_t i = 0; i < count; i++) {
+                ref_T[i] = ref_temp(&state, calib, adc_T[i]);
+                ref_P[i] = ref_press(&state, calib, adc_P[i]);
+                ref_H[i] = ref_hum(&state, calib, adc_H[i]);
+            }
+            double t1 = now_s();
+            cycles_ref = cycles() - c0 < cycles_ref ? cycles() - c0 : cycles_ref;
+            for (size_t i = 0; i < count; i++) {
+                int32_t t_fine;
+                out_T[i] = bme280_compensate_temperature(calib, adc_T[i], &t_fine);
+                out_P[i] = bme280_compensate_pressure(calib, adc_P[i], t_fine);
+                out_H[i] = bme280_compensate_humidity(calib, adc_H[i], t_fine);
+            }
+            double t2 = now_s();
+            if (round == 0) {
+                mismatches += memcmp(ref_T, out_T, count * sizeof(*out_T)) != 0;
+                mismatches += memcmp(ref_P, out_P, count * sizeof(*out_P)) != 0;
+                mismatches += memcmp(ref_H, out_H, count * sizeof(*out_H)) != 0;
+            }
+            memset(out_T, 0, count * sizeof(*out_T));
+            memset(out_P, 0, count * sizeof(*out_P));
+            memset(out_H, 0, count * sizeof(*out_H));
+
+            // Derived coefficients once, as bme280_dev_setup does
+            c0 = cycles();
+            double tf0 = now_s();
+            bme280_comp_init(calib, &comp);
+            for (size_t i = 0; i < count; i++) {
+                bme280_reading_t reading;
+                bme280_compensate_fused(&comp, adc_T[i], adc_P[i], adc_H[i], &reading);
+                out_T[i] = reading.temperature;
+                out_P[i] = reading.pressure;
+                out_H[i] = reading.humidity;
+            }
+            double tf1 = now_s();
+            cycles_fused = cycles() - c0 < cycles_fused ? cycles() - c0 : cycles_fused;
+            best_fused = tf1 - tf0 < best_fused ? tf1 - tf0 : best_fused;
+            if (round == 0) {
+                mismatches += memcmp(ref_T, out_T, count * sizeof(*out_T)) != 0;
+                mismatches += memcmp(ref_P, out_P, count * sizeof(*out_P)) != 0;
+                mismatches += memcmp(ref_H, out_H, count * sizeof(*out_H)) != 0;
+                // The former driver order: pressure first, with the t_fine of the reading before
+                int32_t t_fine_prev = 0;
+                for (size_t i = 0; i < count; i++) {
+                    int32_t t_fine;
+                    uint32_t stale = bme280_compensate_pressure(calib, adc_P[i], t_fine_prev);
+                    bme280_compensate_temperature(calib, adc_T[i], &t_fine);
+                    uint32_t diff = stale > ref_P[i] ? stale - ref_P[i] : ref_P[i] - stale;
+                    if (i > 0 && diff > stale_diff_max) {
+                        stale_diff_max = diff;
+                    }
+                    t_fine_prev = t_fine;
+                }
+            }
+            double t3 = now_s();
+            bme280_compensate_batch(calib, count, adc_T, adc_P, adc_H, out_T, out_P, out_H);
+            double t4 = now_s();
+            if (round == 0) {
+                mismatches += memcmp(ref_T, out_T, count * sizeof(*out_T)) != 0;
+                mismatches += memcmp(ref_P, out_P, count * sizeof(*out_P)) != 0;
+                mismatches += memcmp(ref_H, out_H, count * sizeof(*out_H)) != 0;
+            }
+            double t5 = now_s();
+            for (size_t i = 0; i < count; i++) {
+                int32_t t_fine;
+                bme280_compensate_temperature(calib, adc_T[i], &t_fine);
+                out_P[i] = bme280_compensate_pressure64(calib, adc_P[i], t_fine);
+            }
+            double t6 = now_s();
+            for (size_t i = 0; i < count; i++) {
+                // Q24.8 to Pa, rounded, against the 32-bit formula
+                uint32_t p = (out_P[i] + 128) >> 8;
+                uint32_t diff = p > ref_P[i] ? p - ref_P[i] : ref_P[i] - p;
+                if (diff > p64_diff_max) {
+                    p64_diff_max = diff;
+                }
+                sink += out_P[i];
+            }
+
+            best_ref = t1 - t0 < best_ref ? t1 - t0 : best_ref;
+            best_scalar = t2 - t1 < best_scalar ? t2 - t1 : best_scalar;
+            best_batch = t4 - t3 < best_batch ? t4 - t3 : best_batch;
+            best_p64 = t6 - t5 < best_p64 ? t6 - t5 : best_p64;
+        }
+
+        printf("calibration %zu, %zu samples (T, P, H), best of %d:\n", k, count, BENCH_ROUNDS);
+        report("reference", best_ref, count);
+        report("pure, per sample", best_scalar, count);
+        report("fused, per sample", best_fused, count);
+        report("batch", best_batch, count);
+        report("T + 64-bit P", best_p64, count);
+        printf("  batch speedup %.2fx, 64-bit vs 32-bit pressure max difference %u Pa (%08x)\n",
+               best_ref / best_batch, p64_diff_max, sink & 0xFF);
+        if (cycles_ref) {
+            printf("  TSC cycles/sample: reference %.1f, fused %.1f\n",
+                   (double)cycles_ref / count, (double)cycles_fused / count);
+        }
+        printf("  previous reading's t_fine: pressure off by up to %u Pa on these random readings\n", stale_diff_max);
+        printf("  bit-exact: %s\n", mismatches ? "NO" : "yes");
+        failures += mismatches != 0;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,478 @@
+/*
+ * DHT bit decoding benchmark. Decodes pulse-width traces with the driver's
+ * decoder (dht_decode_pulses: absolute threshold learned from the preamble)
+ * and with the comparison the driver used before (a bit is 1 when its high
+ * pulse outlasts its own low pulse), and counts the frames each gets right,
+ * rejects on the checksum, or gets wrong with a valid checksum.
+ *
+ * Traces are generated from a noise model per scenario: sensor clock off by
+ * up to a given share, Gaussian jitter on every edge, and edges timestamped
+ * late by an interrupt latency, as the edge capture ISR sees them. Traces
+ * can also be written and read back as text, one frame per line:
+ *
+ *   preamble_low preamble_high low0 high0 ... low39 high39 [frame in hex]
+ *
+ * widths in microseconds; without the expected frame, a line only counts as
+ * right or wrong by its checksum.
+ *
+ * Then dht_convert_data is checked against the datasheet formulas, in floating
+ * point, for every pair of bytes of each reading of each sensor type, and
+ * timed against the floating point conversion. Last, dht_read_data is run on
+ * a simulated DHT22 in both decoding modes to report the time spent with
+ * interrupts disabled per read.
+ *
+ * usage: dht_bench [frames] [seed] [-w traces.txt | -r traces.txt ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "dht.h"
+#include "host_sim.h"
+
+#define BENCH_DEFAULT_FRAMES 200000
+#define BENCH_GPIO GPIO_NUM_12
+#define BENCH_READS 10
+// Low, for the host time spent polling to stay small next to the simulated read
+#define BENCH_TIME_SCALE 4
+#define BENCH_LINE_MAX 1024
+
+// Nominal waveform, datasheet
+#define WAVE_PREAMBLE_US 80
+#define WAVE_LOW_US 50
+#define WAVE_ZERO_US 26
+#define WAVE_ONE_US 70
+
+typedef struct
+{
+    const char *name;
+    double clock_skew;      //!< sensor clock off by up to this share, per frame
+    double jitter_us;       //!< standard deviation of each edge
+    double late_share;      //!< share of edges timestamped late
+    double late_max_us;     //!< by up to this
+} scenario_t;
+
+static const scenario_t s_scenarios[] = {
+    { "clean", 0, 0, 0, 0 },
+    { "clock +-20 %", 0.20, 0, 0, 0 },
+    { "jitter 4 us", 0.05, 4, 0, 0 },
+    { "jitter 7 us", 0.05, 7, 0, 0 },
+    { "ISR latency 2 % <30 us", 0.05, 1, 0.02, 30 },
+    { "ISR latency 5 % <40 us", 0.05, 2, 0.05, 40 },
+    { "all of it", 0.15, 5, 0.03, 35 },
+};
+
+typedef struct
+{
+    uint32_t right, rejected, wrong;
+} outcome_t;
+
+static uint32_t s_rand;
+static SemaphoreHandle_t s_done;
+
+static uint32_t bench_rand(void)
+{
+    // xorshift32, reproducible across hosts
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static double bench_uniform(void)
+{
+    return (bench_rand() >> 8) / 16777216.0;
+}
+
+static double bench_gauss(void)
+{
+    // Box-Muller
+    double u = bench_uniform() + 1e-12;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * bench_uniform());
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint8_t width(double from, double to)
+{
+    double us = to - from;
+    return us <= 0 ? 0 : us >= 255 ? 255 : (uint8_t)us; // truncated, as CCOUNT / MHz
+}
+
+/* A random frame with a valid checksum, sent through the noise model of the scenario. */
+static void generate(const scenario_t *sc, uint8_t frame[DHT_DATA_BYTES], dht_pulses_t *p)
+{
+    double edges[3 + DHT_DATA_BITS * 2];
+    double scale = 1 + sc->clock_skew * (2 * bench_uniform() - 1);
+    double t = 0;
+    int n = 0;
+
+    for (int i = 0; i < 4; i++) {
+        frame[i] = bench_rand();
+    }
+    frame[4] = frame[0] + frame[1] + frame[2] + frame[3];
+
+    edges[n++] = t;
+    edges[n++] = t += WAVE_PREAMBLE_US * scale;
+    edges[n++] = t += WAVE_PREAMBLE_US * scale;
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        bool one = frame[i / 8] & (0x80 >> (i % 8));
+        edges[n++] = t += WAVE_LOW_US * scale;
+        edges[n++] = t += (one ? WAVE_ONE_US : WAVE_ZERO_US) * scale;
+    }
+    for (int i = 0; i < n; i++) {
+        edges[i] += sc->jitter_us * bench_gauss();
+        if (bench_uniform() < sc->late_share) {
+            edges[i] += sc->late_max_us * bench_uniform();
+        }
+    }
+
+    p->preamble_low = width(edges[0], edges[1]);
+    p->preamble_high = width(edges[1], edges[2]);
+    p->bits = DHT_DATA_BITS;
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        p->low[i] = width(edges[2 + 2 * i], edges[3 + 2 * i]);
+        p->high[i] = width(edges[3 + 2 * i], edges[4 + 2 * i]);
+    }
+}
+
+/* The former decoder: each bit against its own low pulse, packed from an array of bools. */
+static esp_err_t decode_compare(const dht_pulses_t *p, uint8_t data[DHT_DATA_BYTES])
+{
+    bool bits[DHT_DATA_BITS];
+
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        bits[i] = p->high[i] > p->low[i];
+    }
+    memset(data, 0, DHT_DATA_BYTES);
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        data[i / 8] <<= 1;
+        data[i / 8] |= bits[i];
+    }
+    return data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF) ? ESP_OK : ESP_ERR_DHT_CHECKSUM;
+}
+
+static esp_err_t decode_threshold(const dht_pulses_t *p, uint8_t data[DHT_DATA_BYTES])
+{
+    dht_pulses_t copy = *p;     // the decoder records its threshold
+
+    return dht_decode_pulses(&copy, data);
+}
+
+static void account(outcome_t *o, esp_err_t err, const uint8_t *data, const uint8_t *expected)
+{
+    if (err != ESP_OK) {
+        o->rejected++;
+    } else if (expected && memcmp(data, expected, DHT_DATA_BYTES) != 0) {
+        o->wrong++;
+    } else {
+        o->right++;
+    }
+}
+
+static void print_outcome(const char *decoder, const outcome_t *o, uint32_t frames, double seconds)
+{
+    printf("  %-10s right %6.2f %%  rejected %6.2f %%  wrong %6.3f %%  %6.1f ns/frame\n", decoder,
+           100.0 * o->right / frames, 100.0 * o->rejected / frames, 100.0 * o->wrong / frames,
+           seconds * 1e9 / frames);
+}
+
+static void write_trace(FILE *f, const dht_pulses_t *p, const uint8_t frame[DHT_DATA_BYTES])
+{
+    fprintf(f, "%u %u", p->preamble_low, p->preamble_high);
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        fprintf(f, " %u %u", p->low[i], p->high[i]);
+    }
+    fprintf(f, " %02x%02x%02x%02x%02x\n", frame[0], frame[1], frame[2], frame[3], frame[4]);
+}
+
+static bool read_trace(const char *line, dht_pulses_t *p, uint8_t frame[DHT_DATA_BYTES], bool *has_frame)
+{
+    unsigned v[2 + DHT_DATA_BITS * 2];
+    int used, pos = 0;
+
+    for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); i++, pos += used) {
+        if (sscanf(line + pos, "%u%n", &v[i], &used) != 1 || v[i] > 255) {
+            return false;
+        }
+    }
+    p->preamble_low = v[0];
+    p->preamble_high = v[1];
+    p->bits = DHT_DATA_BITS;
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        p->low[i] = v[2 + 2 * i];
+        p->high[i] = v[3 + 2 * i];
+    }
+    unsigned b[DHT_DATA_BYTES];
+    *has_frame = sscanf(line + pos, " %2x%2x%2x%2x%2x", &b[0], &b[1], &b[2], &b[3], &b[4]) == DHT_DATA_BYTES;
+    for (int i = 0; *has_frame && i < DHT_DATA_BYTES; i++) {
+        frame[i] = b[i];
+    }
+    return true;
+}
+
+static void run_file(const char *path)
+{
+    static char line[BENCH_LINE_MAX];
+    outcome_t compare = { 0 }, threshold = { 0 };
+    uint32_t frames = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        dht_pulses_t p;
+        uint8_t frame[DHT_DATA_BYTES], data[DHT_DATA_BYTES];
+        bool has_frame;
+        if (!read_trace(line, &p, frame, &has_frame)) {
+            continue;
+        }
+        esp_err_t err = decode_compare(&p, data);
+        account(&compare, err, data, has_frame ? frame : NULL);
+        err = decode_threshold(&p, data);
+        account(&threshold, err, data, has_frame ? frame : NULL);
+        frames++;
+    }
+    fclose(f);
+    printf("%s, %u frames:\n", path, frames);
+    if (frames) {
+        print_outcome("compare", &compare, frames, 0);
+        print_outcome("threshold", &threshold, frames, 0);
+    }
+}
+
+static void run_scenario(const scenario_t *sc, uint32_t frames, FILE *out)
+{
+    dht_pulses_t *traces = malloc(frames * sizeof(*traces));
+    uint8_t (*expected)[DHT_DATA_BYTES] = malloc(frames * DHT_DATA_BYTES);
+    outcome_t compare = { 0 }, threshold = { 0 };
+    uint8_t data[DHT_DATA_BYTES];
+
+    if (!traces || !expected) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    for (uint32_t i = 0; i < frames; i++) {
+        generate(sc, expected[i], &traces[i]);
+        if (out) {
+            write_trace(out, &traces[i], expected[i]);
+        }
+    }
+
+    double t0 = now_s();
+    for (uint32_t i = 0; i < frames; i++) {
+        account(&compare, decode_compare(&traces[i], data), data, expected[i]);
+    }
+    double t1 = now_s();
+    for (uint32_t i = 0; i < frames; i++) {
+        account(&threshold, decode_threshold(&traces[i], data), data, expected[i]);
+    }
+    double t2 = now_s();
+
+    printf("%s, %u frames:\n", sc->name, frames);
+    print_outcome("compare", &compare, frames, t1 - t0);
+    print_outcome("threshold", &threshold, frames, t2 - t1);
+    free(traces);
+    free(expected);
+}
+
+/* Reads in both modes, reporting the time with interrupts disabled. */
+/* The datasheets' formulas, in floating point. */
+static double reference_value(dht_sensor_type_t type, bool temperature, uint8_t msb, uint8_t lsb)
+{
+    double value;
+
+    if (type == DHT_TYPE_DHT11) {
+        value = msb + (temperature ? lsb & 0x7F : lsb) / 10.0;
+        return temperature && (lsb & 0x80) ? -value : value;
+    }
+    value = (((msb & 0x7F) << 8) | lsb) / 10.0;
+    return temperature && (msb & 0x80) ? -value : value;
+}
+
+/* The conversion dht_read_data did before: a DHT22 temperature word taken as two's complement. */
+static int16_t former_value(dht_sensor_type_t type, uint8_t msb, uint8_t lsb)
+{
+    return type == DHT_TYPE_DHT11 ? msb * 10 + lsb : (int16_t)((msb << 8) | lsb);
+}
+
+/* The floating point conversion the driver had for DHT22 frames, unused. */
+static __attribute__((noinline)) float float_value(dht_sensor_type_t type, uint8_t msb, uint8_t lsb)
+{
+    float data;
+
+    if (type == DHT_TYPE_DHT22) {
+        data = ((msb & 0x7F) << 8) | lsb;
+        data /= 10.0;
+        if (msb & 0x80) {
+            data = -data;
+        }
+    } else {
+        data = msb;
+    }
+    return data;
+}
+
+static void run_conversion(void)
+{
+    static const char *const names[DHT_TYPE_COUNT] = { "DHT11", "DHT22", "SI7021" };
+    uint8_t data[DHT_DATA_BYTES] = { 0 };
+    int16_t humidity, temperature;
+
+    printf("conversion, every byte pair of each reading:\n");
+    for (int type = 0; type < DHT_TYPE_COUNT; type++) {
+        uint32_t wrong[2] = { 0 }, former_wrong = 0;
+        for (uint32_t pattern = 0; pattern < 0x10000; pattern++) {
+            data[0] = data[2] = pattern >> 8;
+            data[1] = data[3] = pattern & 0xFF;
+            dht_convert_data(type, data, &humidity, &temperature);
+            for (int t = 0; t < 2; t++) {
+                int16_t value = t ? temperature : humidity;
+                long expected = lround(reference_value(type, t, data[0], data[1]) * 10);
+                wrong[t] += value != expected;
+            }
+            if (former_value(type, data[2], data[3]) != lround(reference_value(type, true, data[2], data[3]) * 10)) {
+                former_wrong++;
+            }
+        }
+        printf("  %-6s of 65536: humidity %u wrong, temperature %u wrong (before: %u)\n",
+               names[type], wrong[0], wrong[1], former_wrong);
+    }
+
+    // The datasheet's DHT22 examples
+    const uint8_t example[DHT_DATA_BYTES] = { 0x02, 0x8C, 0x80, 0x65, 0x73 };
+    dht_convert_data(DHT_TYPE_DHT22, example, &humidity, &temperature);
+    printf("  DHT22 frame 028C8065: humidity %d, temperature %d tenths (datasheet: 652, -101)\n",
+           humidity, temperature);
+
+    volatile int32_t sink = 0;
+    uint64_t best_fixed = UINT64_MAX, best_float = UINT64_MAX;
+    double t_fixed = 0, t_float = 0;
+    for (int round = 0; round < 5; round++) {
+        double t0 = now_s();
+        uint64_t c0 = cycles();
+        for (uint32_t pattern = 0; pattern < 0x10000; pattern++) {
+            data[2] = pattern >> 8;
+            data[3] = pattern & 0xFF;
+            dht_convert_data(DHT_TYPE_DHT22, data, &humidity, &temperature);
+            sink += temperature;
+        }
+        uint64_t c1 = cycles();
+        double t1 = now_s();
+        for (uint32_t pattern = 0; pattern < 0x10000; pattern++) {
+            float h = float_value(DHT_TYPE_DHT22, data[0], data[1]);
+            float t = float_value(DHT_TYPE_DHT22, pattern >> 8, pattern & 0xFF);
+            sink += (int32_t)(h + t);
+        }
+        uint64_t c2 = cycles();
+        double t2 = now_s();
+        best_fixed = c1 - c0 < best_fixed ? c1 - c0 : best_fixed;
+        best_float = c2 - c1 < best_float ? c2 - c1 : best_float;
+        t_fixed += t1 - t0;
+        t_float += t2 - t1;
+    }
+    printf("  DHT22 frame, fixed point: %.2f ns, %.1f TSC cycles; floating point: %.2f ns, %.1f TSC cycles\n",
+           t_fixed * 1e9 / (5 * 0x10000), (double)best_fixed / 0x10000,
+           t_float * 1e9 / (5 * 0x10000), (double)best_float / 0x10000);
+}
+
+static void critical_task(void *arg)
+{
+    static const struct { dht_decode_mode_t mode; const char *name; } modes[] = {
+        { DHT_DECODE_POLLING, "polling" },
+        { DHT_DECODE_EDGE_CAPTURE, "edge capture" },
+    };
+
+    dht_init(BENCH_GPIO, true);
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        uint32_t critical_max = 0, critical_sum = 0, ok = 0;
+        dht_set_decode_mode(BENCH_GPIO, modes[m].mode);
+        for (int i = 0; i < BENCH_READS; i++) {
+            int16_t humidity, temperature;
+            vTaskDelay(pdMS_TO_TICKS(2000));
+            esp_err_t err = dht_read_data(DHT_TYPE_DHT22, BENCH_GPIO, &humidity, &temperature);
+            ok += err == ESP_OK;
+            uint32_t critical = dht_get_last_critical_us();
+            critical_sum += critical;
+            critical_max = critical > critical_max ? critical : critical_max;
+        }
+        const dht_pulses_t *p = dht_get_last_pulses();
+        printf("  %-13s %u/%u reads, interrupts disabled %u us per read (max %u), "
+               "preamble %u/%u us, threshold %u us\n", modes[m].name, ok, BENCH_READS,
+               critical_sum / BENCH_READS, critical_max, p->preamble_low, p->preamble_high, p->threshold);
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = BENCH_DEFAULT_FRAMES;
+    FILE *out = NULL;
+    int arg = 1;
+
+    s_rand = 1;
+    if (arg < argc && argv[arg][0] != '-') {
+        frames = strtoul(argv[arg++], NULL, 0);
+    }
+    if (arg < argc && argv[arg][0] != '-') {
+        s_rand = strtoul(argv[arg++], NULL, 0);
+    }
+    if (!frames || !s_rand) {
+        fprintf(stderr, "usage: %s [frames] [seed] [-w traces.txt | -r traces.txt ...]\n", argv[0]);
+        return 2;
+    }
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0) {
+        for (arg++; arg < argc; arg++) {
+            run_file(argv[arg]);
+        }
+        return 0;
+    }
+    if (arg + 1 < argc && strcmp(argv[arg], "-w") == 0) {
+        out = fopen(argv[arg + 1], "w");
+        if (!out) {
+            perror(argv[arg + 1]);
+            return 2;
+        }
+    }
+    for (size_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        run_scenario(&s_scenarios[i], frames, out);
+    }
+    if (out) {
+        fclose(out);
+    }
+
+    run_conversion();
+
+    printf("simulated DHT22, %d reads per mode:\n", BENCH_READS);
+    sim_clock_init(BENCH_TIME_SCALE);
+    sim_dht_attach(BENCH_GPIO, SIM_DHT22);
+    s_done = xSemaphoreCreateBinary();
+    xTaskCreate(critical_task, "bench", 4096, NULL, 6, NULL);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Fixed-point formatting benchmark: formats the readings of the published
+ * text topics (hundredths, as the node keeps them) with fixed_fmt() and with
+ * sprintf("%.2f") of the value divided by 100.0, as the firmware did before.
+ * Every value of -200.00..2000.00 must give the same text with both; the
+ * run exits with status 1 otherwise. Last, it prints the size of the code of
+ * fixed_fmt, read from the symbol table of this executable: host code, the
+ * size of the ESP8266 build differs.
+ *
+ * usage: fixed_fmt_bench [samples] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <elf.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "fixed_fmt.h"
+
+#define BENCH_DEFAULT_SAMPLES 2000000
+#define BENCH_ROUNDS 5
+// Equivalence sweep, in hundredths
+#define SWEEP_MIN -20000
+#define SWEEP_MAX 200000
+
+static uint32_t s_rand;
+
+static uint32_t bench_rand(void)
+{
+    // xorshift32, reproducible across hosts
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void report(const char *name, double seconds, uint64_t tsc, size_t samples)
+{
+    printf("  %-18s %8.2f ns/sample", name, seconds * 1e9 / samples);
+    if (tsc) {
+        printf(" %8.1f TSC cycles/sample", (double)tsc / samples);
+    }
+    printf("\n");
+}
+
+/* Size of a function symbol in this executable, 0 if it cannot be read. */
+static size_t symbol_size(const char *name)
+{
+    FILE *f = fopen("/proc/self/exe", "rb");
+    size_t size = 0;
+    Elf64_Ehdr eh;
+
+    if (!f) {
+        return 0;
+    }
+    if (fread(&eh, sizeof(eh), 1, f) != 1 || memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh.e_ident[EI_CLASS] != ELFCLASS64 || eh.e_shentsize != sizeof(Elf64_Shdr)) {
+        fclose(f);
+        return 0;
+    }
+    Elf64_Shdr *sections = calloc(eh.e_shnum, sizeof(*sections));
+    if (!sections || fseek(f, eh.e_shoff, SEEK_SET) != 0 ||
+        fread(sections, sizeof(*sections), eh.e_shnum, f) != eh.e_shnum) {
+        free(sections);
+        fclose(f);
+        return 0;
+    }
+    for (int s = 0; s < eh.e_shnum && !size; s++) {
+        if (sections[s].sh_type != SHT_SYMTAB || sections[s].sh_link >= eh.e_shnum) {
+            continue;
+        }
+        const Elf64_Shdr *strtab = &sections[sections[s].sh_link];
+        Elf64_Sym *syms = malloc(sections[s].sh_size);
+        char *names = malloc(strtab->sh_size);
+        if (syms && names &&
+            fseek(f, sections[s].sh_offset, SEEK_SET) == 0 && fread(syms, sections[s].sh_size, 1, f) == 1 &&
+            fseek(f, strtab->sh_offset, SEEK_SET) == 0 && fread(names, strtab->sh_size, 1, f) == 1) {
+            for (size_t i = 0; i < sections[s].sh_size / sizeof(*syms); i++) {
+                if (ELF64_ST_TYPE(syms[i].st_info) == STT_FUNC && syms[i].st_name < strtab->sh_size &&
+                    strcmp(names + syms[i].st_name, name) == 0) {
+                    size = syms[i].st_size;
+                    break;
+                }
+            }
+        }
+        free(syms);
+        free(names);
+    }
+    free(sections);
+    fclose(f);
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SAMPLES;
+    s_rand = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (!count || !s_rand) {
+        fprintf(stderr, "usage: %s [samples] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    unsigned failures = 0;
+    char expected[32];
+    char text[FIXED_FMT_MAX_LEN];
+    size_t mismatches = 0;
+
+    for (int32_t v = SWEEP_MIN; v <= SWEEP_MAX; v++) {
+        snprintf(expected, sizeof(expected), "%.2f", v / 100.0);
+        size_t len = fixed_fmt(text, v, 2);
+        if (len != strlen(expected) || strcmp(text, expected) != 0) {
+            if (mismatches++ < 5) {
+                printf("  %d: fixed_fmt \"%s\", sprintf \"%s\"\n", v, text, expected);
+            }
+        }
+    }
+    printf("sweep %.2f..%.2f: %zu mismatches, same text: %s\n",
+           SWEEP_MIN / 100.0, SWEEP_MAX / 100.0, mismatches, mismatches ? "NO" : "yes");
+    failures += mismatches != 0;
+
+    // Readings as published: temperature -40..85 degC, humidity 0..100 %RH, pressure 300..1100 hPa
+    int32_t *values = malloc(count * sizeof(*values));
+    if (!values) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (size_t i = 0; i < count; i++) {
+        switch (i % 3) {
+        case 0:
+            values[i] = -4000 + (int32_t)(bench_rand() % 12501);
+            break;
+        case 1:
+            values[i] = (int32_t)(bench_rand() % 10001);
+            break;
+        default:
+            values[i] = 30000 + (int32_t)(bench_rand() % 80001);
+            break;
+        }
+    }
+
+    double best_printf = 1e9, best_fixed = 1e9;
+    uint64_t cycles_printf = UINT64_MAX, cycles_fixed = UINT64_MAX;
+    size_t sink = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t c0 = cycles();
+        double t0 = now_s();
+        for (size_t i = 0; i < count; i++) {
+            sink += sprintf(expected, "%.2f", values[i] / 100.0);
+        }
+        double t1 = now_s();
+        uint64_t c1 = cycles();
+        for (size_t i = 0; i < count; i++) {
+            sink += fixed_fmt(text, values[i], 2);
+        }
+        double t2 = now_s();
+        uint64_t c2 = cycles();
+
+        best_printf = t1 - t0 < best_printf ? t1 - t0 : best_printf;
+        best_fixed = t2 - t1 < best_fixed ? t2 - t1 : best_fixed;
+        cycles_printf = c1 - c0 < cycles_printf ? c1 - c0 : cycles_printf;
+        cycles_fixed = c2 - c1 < cycles_fixed ? c2 - c1 : cycles_fixed;
+    }
+    printf("%zu readings, best of %d (%zu characters):\n", count, BENCH_ROUNDS, sink / BENCH_ROUNDS);
+    report("sprintf(\"%.2f\")", best_printf, cycles_printf, count);
+    report("fixed_fmt", best_fixed, cycles_fixed, count);
+    printf("  speedup %.1fx\n", best_printf / best_fixed);
+
+    size_t text_size = symbol_size("fixed_fmt");
+    if (text_size) {
+        printf("fixed_fmt: %zu bytes of host code\n", text_size);
+    } else {
+        printf("fixed_fmt: code size unknown, no symbol table\n");
+    }
+    free(values);
+    return failures ? 1 : 0;
+}
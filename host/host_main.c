@@ -0,0 +1,40 @@
+/*
+ * Host entry point: attaches the simulated peripherals the firmware expects,
+ * runs app_main() and reports the simulation counters after the run.
+ *
+ * usage: node_sensor_host [simulated_seconds] [time_scale]
+ *   simulated_seconds  length of the run (default 60), deep sleeps included
+ *   time_scale         simulated seconds per host second (default 1)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_sim.h"
+
+#define HOST_DHT_GPIO GPIO_NUM_5
+#define HOST_BME280_ADDRESS 0x76
+#define HOST_BME280_CHIP_ID 0x60
+
+int main(int argc, char **argv)
+{
+    double run_seconds = argc > 1 ? atof(argv[1]) : 60.0;
+    double time_scale = argc > 2 ? atof(argv[2]) : 1.0;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    uint64_t run_end_us = (uint64_t)(run_seconds * 1e6);
+
+    sim_clock_init(time_scale);
+    if (!sim_boot(argv, run_end_us)) {
+        sim_stats()->boots = 1;
+    }
+    sim_dht_attach(HOST_DHT_GPIO, SIM_DHT11);
+    sim_bme280_attach(HOST_BME280_ADDRESS, HOST_BME280_CHIP_ID);
+
+    app_main();
+
+    uint64_t now = sim_time_us();
+    if (now < run_end_us) {
+        sim_sleep_us(run_end_us - now);
+    }
+    sim_report();
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * BME280 forced read bus benchmark: reads a simulated BME280 and BMP280 with
+ * the driver (a prebuilt ctrl_meas trigger, then one burst of status and data
+ * from 0xF3) and with the per-register sequence it had before, rebuilt below:
+ * ctrl_meas write, status read until the conversion is done, then a data read
+ * from 0xF7, each in a command link of its own. Both wait the same measurement
+ * time. Reports I2C transactions, command link allocations, bytes and bus time
+ * per sample from the simulator's counters (sim_i2c.c, 100 kHz SCL), and
+ * checks that the burst returns the data registers of the same conversion; the
+ * run exits with status 1 otherwise or if a read fails.
+ *
+ * usage: i2c_read_bench [samples]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "i2c_bme280.h"
+#include "host_sim.h"
+
+#define BENCH_DEFAULT_SAMPLES 50
+#define BENCH_TIME_SCALE 4
+#define BENCH_SCL_GPIO 14
+#define BENCH_SDA_GPIO 4
+
+typedef struct
+{
+    const char *name;
+    uint8_t address;
+    uint8_t chip_id;
+} bench_sensor_t;
+
+static const bench_sensor_t s_sensors[] = {
+    { "BME280", 0x76, BME280_CHIP_ID },
+    { "BMP280", 0x77, BMP280_CHIP_ID },
+};
+
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t cmd_links;
+    uint32_t bytes;
+    uint64_t bus_us;
+} bench_counters_t;
+
+static uint32_t s_samples = BENCH_DEFAULT_SAMPLES;
+static unsigned s_failures;
+static SemaphoreHandle_t s_done;
+
+static void counters_take(bench_counters_t *c)
+{
+    const sim_stats_t *stats = sim_stats();
+    c->transactions = stats->i2c_transactions;
+    c->cmd_links = stats->i2c_cmd_links;
+    c->bytes = stats->i2c_bytes;
+    c->bus_us = stats->i2c_bus_us;
+}
+
+static void counters_report(const char *name, const bench_counters_t *start, uint32_t samples)
+{
+    bench_counters_t end;
+    counters_take(&end);
+    printf("  %-15s %5.2f transactions %5.2f cmd links %6.2f bytes %7.1f us bus time\n", name,
+           (double)(end.transactions - start->transactions) / samples,
+           (double)(end.cmd_links - start->cmd_links) / samples,
+           (double)(end.bytes - start->bytes) / samples,
+           (double)(end.bus_us - start->bus_us) / samples);
+}
+
+/* The driver's former register access: a command link per transaction. */
+static bool old_write(const bme280_dev_t *dev, uint8_t reg, uint8_t value)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev->config.address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_write(cmd, &value, 1, true);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    return err == ESP_OK;
+}
+
+static bool old_read(const bme280_dev_t *dev, uint8_t reg, uint8_t *data, size_t len)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev->config.address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (dev->config.address << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, data, len, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+    return err == ESP_OK;
+}
+
+/* The former forced read, with the driver's wait: ready tick, then a tick per poll. */
+static bool old_forced_read(const bme280_dev_t *dev, uint8_t *data, size_t len)
+{
+    const bme280_config_t *config = &dev->config;
+    uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    uint8_t status;
+
+    if (!old_write(dev, BME280_REG_CTRL_MEAS, (config->osrs_t << 5) | (config->osrs_p << 2) | BME280_MODE_FORCED)) {
+        return false;
+    }
+    vTaskDelay((bme280_dev_get_measurement_time_us(dev) + tick_us - 1) / tick_us);
+    for (;;) {
+        if (!old_read(dev, BME280_REG_STATUS, &status, 1)) {
+            return false;
+        }
+        if (!(status & BME280_STATUS_MEASURING)) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return old_read(dev, BME280_REG_DATA, data, len);
+}
+
+static void bench_sensor(const bench_sensor_t *sensor)
+{
+    static bme280_dev_t dev; // the prebuilt command links point into it
+    bme280_config_t config = bme280_config_default;
+    bench_counters_t start;
+    uint8_t data[8];
+    size_t data_len = sensor->chip_id == BMP280_CHIP_ID ? 6 : 8;
+    uint32_t ok = 0, mismatches = 0;
+
+    config.address = sensor->address;
+    config.gpio_scl = BENCH_SCL_GPIO;
+    config.gpio_sda = BENCH_SDA_GPIO;
+    counters_take(&start);
+    if (!bme280_dev_init(&dev, config)) {
+        printf("%s: init failed\n", sensor->name);
+        s_failures++;
+        return;
+    }
+    printf("%s, init once, then per sample over %u samples:\n", sensor->name, s_samples);
+    counters_report("init", &start, 1);
+
+    counters_take(&start);
+    for (uint32_t i = 0; i < s_samples; i++) {
+        ok += old_forced_read(&dev, data, data_len);
+    }
+    counters_report("per register", &start, s_samples);
+
+    counters_take(&start);
+    for (uint32_t i = 0; i < s_samples; i++) {
+        ok += bme280_dev_start_forced_read(&dev, NULL, NULL) && bme280_dev_wait_forced_read(&dev) == BME280_READ_DONE;
+    }
+    counters_report("burst", &start, s_samples);
+
+    // The same conversion both ways: data registers, then the burst without a new trigger
+    for (uint32_t i = 0; i < s_samples; i++) {
+        if (!old_forced_read(&dev, data, data_len) || !bme280_dev_read_sensor_data(&dev)) {
+            continue;
+        }
+        ok++;
+        mismatches += memcmp(data, &dev.burst[BME280_REG_DATA - BME280_BURST_START], data_len) != 0;
+    }
+    printf("  %u/%u reads, same data registers: %s\n", ok, 3 * s_samples, mismatches ? "NO" : "yes");
+    s_failures += ok != 3 * s_samples || mismatches;
+    bme280_dev_dispose(&dev);
+}
+
+static void bench_task(void *arg)
+{
+    for (size_t i = 0; i < sizeof(s_sensors) / sizeof(s_sensors[0]); i++) {
+        bench_sensor(&s_sensors[i]);
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    s_samples = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SAMPLES;
+    if (!s_samples) {
+        fprintf(stderr, "usage: %s [samples]\n", argv[0]);
+        return 2;
+    }
+
+    sim_clock_init(BENCH_TIME_SCALE);
+    for (size_t i = 0; i < sizeof(s_sensors) / sizeof(s_sensors[0]); i++) {
+        sim_bme280_attach(s_sensors[i].address, s_sensors[i].chip_id);
+    }
+    s_done = xSemaphoreCreateBinary();
+    xTaskCreate(bench_task, "bench", 4096, NULL, 6, NULL);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    return s_failures ? 1 : 0;
+}
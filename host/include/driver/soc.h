@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CPU cycle counter derived from the simulated clock at the configured CPU frequency. */
+uint32_t sim_ccount(void);
+
+static inline uint32_t soc_get_ccount(void)
+{
+    return sim_ccount();
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+// Own section, so the deep sleep stand-in can save it and restore it on the next boot
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef struct {
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+typedef struct {
+    int if_index;
+    tcpip_adapter_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+    IP_EVENT_AP_STAIPASSIGNED,
+    IP_EVENT_GOT_IP6,
+} ip_event_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+#define ip4_addr1(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[0])
+#define ip4_addr2(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[1])
+#define ip4_addr3(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[2])
+#define ip4_addr4(ipaddr) (((const uint8_t *)(&(ipaddr)->addr))[3])
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) ip4_addr1(ipaddr), ip4_addr2(ipaddr), ip4_addr3(ipaddr), ip4_addr4(ipaddr)
+
+esp_err_t esp_netif_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_deep_sleep(uint64_t time_in_us) __attribute__((noreturn));
+int esp_deep_sleep_set_rf_option(uint8_t option);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES    15
+#define configMINIMAL_STACK_SIZE 768
+
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000))
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+#define errQUEUE_FULL           ((BaseType_t)0)
+
+/*
+ * On the host a critical section is a process-wide recursive lock: it keeps
+ * other simulated tasks out of the section but does not stop them elsewhere.
+ */
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+
+#define taskENTER_CRITICAL()    vPortEnterCritical()
+#define taskEXIT_CRITICAL()     vPortExitCritical()
+#define portENTER_CRITICAL()    vPortEnterCritical()
+#define portEXIT_CRITICAL()     vPortExitCritical()
+#define portYIELD_FROM_ISR()
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Host simulation of the node hardware.
+ *
+ * The stand-ins behind the ESP8266 RTOS SDK headers in this directory share
+ * one simulated clock:
+ *  - busy waits (os_delay_us, bit-banged I2C) advance it without consuming
+ *    host time, so bit-banging loops run at full host speed;
+ *  - blocking waits (vTaskDelay, queue timeouts) sleep for the wall-clock time
+ *    divided by the time scale, so a long run can be compressed.
+ *
+ * Peripherals are driven by scripts: DHT sensors replay a generated waveform
+ * on their GPIO (polled, or as edge interrupts), BME280 sensors answer from a
+ * register map.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Simulated DHT sensor model
+ */
+typedef enum
+{
+    SIM_DHT11 = 0,
+    SIM_DHT22,
+    SIM_SI7021
+} sim_dht_model_t;
+
+/**
+ * Reading a simulated sensor reports at a given simulated time.
+ * Temperatures are in 0.01 degC, humidity in 0.01 %RH, pressure in Pa.
+ */
+typedef struct
+{
+    int32_t temperature;
+    uint32_t humidity;
+    uint32_t pressure;
+} sim_environment_t;
+
+typedef void (*sim_environment_fn_t)(uint64_t time_us, sim_environment_t *env);
+
+typedef struct
+{
+    uint32_t dht_reads;             // start pulses answered by a simulated DHT
+    uint32_t dht_level_polls;       // gpio_get_level() calls on a DHT pin
+    uint32_t dht_faults;            // responses spoiled by HOST_DHT_FAULTS
+    uint32_t gpio_interrupts;       // edge interrupts delivered to handlers
+    uint64_t critical_us;           // simulated time spent inside taskENTER_CRITICAL()
+    uint32_t i2c_transactions;      // i2c_master_cmd_begin() calls
+    uint32_t i2c_cmd_links;         // i2c_cmd_link_create() calls
+    uint32_t i2c_bytes;             // bytes clocked on the bus, address bytes included
+    uint64_t i2c_bus_us;            // bus time at the simulated SCL rate
+    uint32_t mqtt_publishes;        // esp_mqtt_client_publish() calls
+    uint32_t mqtt_payload_bytes;    // application payload bytes
+    uint32_t mqtt_wire_bytes;       // MQTT + TCP/IP bytes, acknowledgements included
+    uint32_t mqtt_disconnects;      // scripted broker outages
+    uint32_t flash_reads;           // esp_partition_read() calls
+    uint32_t flash_writes;          // esp_partition_write() calls
+    uint32_t flash_bytes_written;
+    uint32_t flash_erases;          // sectors erased
+    uint32_t wifi_scans;            // connections that scanned every channel
+    uint32_t wifi_direct_connects;  // connections to a configured BSSID and channel
+    uint32_t wifi_rf_off;           // connections tried on a wake with the radio off (RF option 4)
+    uint32_t sntp_syncs;            // system time set by the simulated SNTP server
+    uint32_t boots;                 // power on included
+    uint32_t deep_sleeps;
+    uint64_t asleep_us;
+    uint32_t boot_publishes;        // boots that published
+    uint64_t boot_to_publish_us;    // sum over those boots of boot to first publish
+    uint64_t boot_to_publish_max_us;
+} sim_stats_t;
+
+/* Clock */
+void sim_clock_init(double time_scale);
+double sim_time_scale(void);
+uint64_t sim_time_us(void);
+void sim_sleep_us(uint64_t us);
+void sim_busy_wait_us(uint64_t us);
+uint64_t sim_busy_time_us(void);
+uint32_t sim_ccount(void);
+
+/*
+ * Interrupt handlers replayed by a peripheral model observe the time of the
+ * event they are servicing through soc_get_ccount() and the GPIO levels.
+ */
+void sim_isr_enter(uint64_t event_time_us);
+void sim_isr_exit(void);
+bool sim_in_isr(uint64_t *event_time_us);
+
+/* Environment driving every simulated sensor */
+void sim_set_environment(sim_environment_fn_t fn);
+void sim_get_environment(sim_environment_t *env);
+
+/* Peripherals */
+void sim_dht_attach(gpio_num_t pin, sim_dht_model_t model);
+bool sim_bme280_attach(uint8_t address, uint8_t chip_id);
+
+/*
+ * Boot: after a deep sleep, restores RTC memory, the counters and the clock
+ * saved by esp_deep_sleep(). Returns true on such a wake-up.
+ */
+bool sim_boot(char **argv, uint64_t run_end_us);
+uint64_t sim_boot_time_us(void);
+// False on a wake after esp_deep_sleep_set_rf_option(4): Wi-Fi never connects
+bool sim_rf_enabled(void);
+
+/* Statistics */
+sim_stats_t *sim_stats(void);
+void sim_report(void);
+
+/* Implemented by the firmware (main/main.c) */
+void app_main(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNTP_OPMODE_POLL 0
+
+/* Host build: answered by the simulated network (sim_network.c), which sets the system time. */
+void sntp_setoperatingmode(uint8_t operating_mode);
+void sntp_setservername(uint8_t idx, const char *server);
+void sntp_init(void);
+void sntp_stop(void);
+uint8_t sntp_enabled(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+/* Host build: main/ only needs the include to resolve. */
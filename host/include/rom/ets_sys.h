@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Busy waits advance the simulated clock instead of burning host time. */
+void os_delay_us(uint16_t us);
+void ets_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host build stand-in for the generated sdkconfig.h.
+ * Only the options referenced by main/ are mirrored from ../../sdkconfig.
+ */
+#pragma once
+
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ 80
+#define CONFIG_ESP_MAIN_TASK_STACK_SIZE 3584
+#define CONFIG_MQTT_CUSTOM_OUTBOX 1
@@ -0,0 +1,112 @@
+/*
+ * Builds and reads the settings messages of main/node_config.h: encodes
+ * name=value arguments, "defaults" for NODE_CONFIG_KEY_DEFAULTS, into the hex
+ * of a message for the configuration topic; with -d, prints the settings in
+ * the hex of a report from the configuration state topic.
+ *
+ * usage: node_config_tool [defaults] name=value ...
+ *        node_config_tool -d hex
+ *        node_config_tool -l      list the settings and their keys
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "node_config.h"
+
+#define TOOL_KEY_MAX 255
+
+static int list_keys(void)
+{
+    printf("%3d defaults\n", NODE_CONFIG_KEY_DEFAULTS);
+    for (int key = 1; key <= TOOL_KEY_MAX; key++) {
+        const char *name = node_config_key_name(key);
+        if (name) {
+            printf("%3d %s\n", key, name);
+        }
+    }
+    return 0;
+}
+
+static int decode(const char *hex)
+{
+    uint8_t buf[NODE_CONFIG_MAX_SIZE * 2];
+    size_t len = 0;
+    unsigned byte;
+    node_config_t config = { 0 };
+
+    while (len < sizeof(buf) && sscanf(hex, "%2x", &byte) == 1) {
+        buf[len++] = (uint8_t)byte;
+        hex += 2;
+    }
+    esp_err_t err = node_config_decode(buf, len, &config, &config);
+    if (err != ESP_OK) {
+        fprintf(stderr, "malformed report (0x%x)\n", err);
+        return 1;
+    }
+    for (int key = 1; key <= TOOL_KEY_MAX; key++) {
+        uint32_t value;
+        if (node_config_get_value(&config, key, &value)) {
+            printf("%s=%u\n", node_config_key_name(key), value);
+        }
+    }
+    if (node_config_validate(&config) != ESP_OK) {
+        printf("(out of range)\n");
+    }
+    return 0;
+}
+
+/* Key of a setting name: 0 for defaults, -1 for none. */
+static int find_key(const char *name, size_t len)
+{
+    if (len == strlen("defaults") && strncmp(name, "defaults", len) == 0) {
+        return NODE_CONFIG_KEY_DEFAULTS;
+    }
+    for (int key = 1; key <= TOOL_KEY_MAX; key++) {
+        const char *key_name = node_config_key_name(key);
+        if (key_name && strlen(key_name) == len && strncmp(key_name, name, len) == 0) {
+            return key;
+        }
+    }
+    return -1;
+}
+
+static int encode(int argc, char **argv)
+{
+    node_config_t config = { 0 };
+
+    printf("%02x", NODE_CONFIG_VERSION);
+    for (int i = 0; i < argc; i++) {
+        const char *eq = strchr(argv[i], '=');
+        int key = find_key(argv[i], eq ? (size_t)(eq - argv[i]) : strlen(argv[i]));
+        if (key == NODE_CONFIG_KEY_DEFAULTS && !eq) {
+            printf("%02x", key);
+            continue;
+        }
+        uint32_t value = eq ? strtoul(eq + 1, NULL, 0) : 0;
+        if (key <= 0 || !eq || !node_config_set_value(&config, key, value)) {
+            fprintf(stderr, "\nbad setting: %s\n", argv[i]);
+            return 1;
+        }
+        printf("%02x", key);
+        for (size_t b = 0; b < node_config_key_size(key); b++) {
+            printf("%02x", (value >> (8 * b)) & 0xFF);
+        }
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-l") == 0) {
+        return list_keys();
+    }
+    if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+        return decode(argv[2]);
+    }
+    if (argc > 1) {
+        return encode(argc - 1, argv + 1);
+    }
+    fprintf(stderr, "usage: %s [defaults] name=value ... | -d hex | -l\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,205 @@
+/*
+ * Adaptive sampling benchmark: samples a generated day of indoor conditions
+ * (still night, HVAC cycling by day, door openings) with fixed periods and
+ * with sample_rate.c, and reports for each:
+ *  - readings, and the energy they cost on the deep-sleep duty cycle (one
+ *    wake per reading, BENCH_WAKE_MJ);
+ *  - messages, and their airtime, once the readings went through the
+ *    firmware's filtering stage (sample_filter.c, settings of main.c);
+ *  - the reconstruction error: readings joined by straight lines against
+ *    the true values, every second.
+ *
+ * usage: rate_bench [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sample_filter.h"
+#include "sample_rate.h"
+
+#define BENCH_DAY_S 86400
+#define BENCH_DOORS 12
+// A non-publishing duty cycle wake: 60 ms awake at 70 mA, 3.3 V (host simulation of main.c)
+#define BENCH_WAKE_MJ (0.060 * 70.0 * 3.3)
+// One QoS 1 publish of a single sample at 1 Mbit/s 802.11b: data frame, ACK, PUBACK, ACK
+#define BENCH_MESSAGE_AIRTIME_MS 1.6
+
+typedef struct
+{
+    const char *name;
+    double quantum[SAMPLE_RATE_CHANNELS];   // resolution, sample units
+    double noise[SAMPLE_RATE_CHANNELS];     // RMS
+    uint8_t flags;
+    sample_rate_config_t rate;              // adaptive policy, min_period_ms also the fixed period
+} bench_sensor_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t period_ms;                     // fixed period, 0 for the sensor's adaptive policy
+} bench_policy_t;
+
+static const bench_sensor_t s_sensors[] = {
+    { "DHT11", { 100, 100, 0 }, { 30, 50, 0 }, SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY,
+      { .min_period_ms = 5000, .max_period_ms = 60000, .change = { 100, 200, 0 } } },
+    { "BME280", { 1, 1, 1 }, { 0.5, 2.0, 2.5 }, SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY | SAMPLE_HAS_PRESSURE,
+      { .min_period_ms = 5000, .max_period_ms = 30000, .change = { 20, 100, 20 } } },
+};
+
+static const bench_policy_t s_policies[] = {
+    { "fixed 10 s", 10000 },
+    { "fixed 5 s", 5000 },
+    { "fixed 30 s", 30000 },
+    { "adaptive", 0 },
+};
+
+static const sample_filter_config_t s_filter_config = {
+    .ewma_shift = 2, .deadband = { 20, 100, 20 }, .heartbeat_s = 600,
+};
+
+static const uint8_t s_channel_flags[SAMPLE_RATE_CHANNELS] = {
+    SAMPLE_HAS_TEMPERATURE, SAMPLE_HAS_HUMIDITY, SAMPLE_HAS_PRESSURE,
+};
+static const char *const s_channel_names[SAMPLE_RATE_CHANNELS] = { "temperature", "humidity", "pressure" };
+
+static double s_truth[SAMPLE_RATE_CHANNELS][BENCH_DAY_S + 1];
+static uint32_t s_rand;
+
+static double bench_uniform(void)
+{
+    // xorshift32, reproducible across hosts
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return (s_rand + 0.5) / 4294967296.0;
+}
+
+static double bench_gauss(double sigma)
+{
+    return sigma * sqrt(-2.0 * log(bench_uniform())) * cos(2.0 * M_PI * bench_uniform());
+}
+
+/* Quiet night, HVAC cycling from 7:00 to 22:00, doors opened at random during the day. */
+static void generate_day(void)
+{
+    double doors[BENCH_DOORS];
+    for (int i = 0; i < BENCH_DOORS; i++) {
+        doors[i] = (7.0 + 15.0 * bench_uniform()) * 3600.0;
+    }
+    for (uint32_t t = 0; t <= BENCH_DAY_S; t++) {
+        double hour = t / 3600.0;
+        double day = sin(2.0 * M_PI * (t / (double)BENCH_DAY_S - 0.3));
+        double temperature = 2250.0 + 150.0 * day;
+        double humidity = 5200.0 - 500.0 * day;
+        double pressure = 101300.0 + 150.0 * sin(2.0 * M_PI * t / (2.5 * BENCH_DAY_S));
+
+        if (hour >= 7.0 && hour < 22.0) {
+            // 20 min cycles: heating ramps up 0.6 degC, then the room cools down
+            double phase = fmod(t, 1200.0) / 1200.0;
+            double cycle = phase < 0.4 ? phase / 0.4 : 1.0 - (phase - 0.4) / 0.6;
+            temperature += 60.0 * cycle - 30.0;
+            humidity -= 150.0 * cycle - 75.0;
+        }
+        for (int i = 0; i < BENCH_DOORS; i++) {
+            // Falls in ~20 s while open for a minute, recovers over ~5 min
+            double dt = t - doors[i];
+            if (dt >= 0.0) {
+                double open = dt < 60.0 ? 1.0 - exp(-dt / 20.0) : (1.0 - exp(-3.0)) * exp(-(dt - 60.0) / 300.0);
+                temperature -= 200.0 * open;
+                humidity += 600.0 * open;
+                pressure += 8.0 * open; // the draft
+            }
+        }
+        s_truth[0][t] = temperature;
+        s_truth[1][t] = humidity;
+        s_truth[2][t] = pressure;
+    }
+}
+
+static int32_t sense(const bench_sensor_t *sensor, int ch, uint32_t t)
+{
+    double value = s_truth[ch][t] + bench_gauss(sensor->noise[ch]);
+    return (int32_t)(lround(value / sensor->quantum[ch]) * sensor->quantum[ch]);
+}
+
+static void run(const bench_sensor_t *sensor, const bench_policy_t *policy, uint32_t seed, double baseline_mj)
+{
+    static uint32_t times[BENCH_DAY_S + 1];
+    static int32_t values[SAMPLE_RATE_CHANNELS][BENCH_DAY_S + 1];
+    sample_filter_t filter;
+    sample_rate_t rate;
+    size_t readings = 0, messages = 0;
+    uint64_t t_ms = 0;
+
+    s_rand = seed;
+    memset(&filter, 0, sizeof(filter));
+    sample_rate_init(&rate, &sensor->rate);
+    while (t_ms / 1000 <= BENCH_DAY_S) {
+        uint32_t t = (uint32_t)(t_ms / 1000);
+        sensor_sample_t sample = { .timestamp = t, .flags = sensor->flags };
+        sample.temperature = (int16_t)sense(sensor, 0, t);
+        sample.humidity = (uint16_t)sense(sensor, 1, t);
+        sample.pressure = (uint32_t)(sensor->flags & SAMPLE_HAS_PRESSURE ? sense(sensor, 2, t) : 0);
+
+        times[readings] = t;
+        values[0][readings] = sample.temperature;
+        values[1][readings] = sample.humidity;
+        values[2][readings] = (int32_t)sample.pressure;
+        readings++;
+
+        uint32_t period_ms = policy->period_ms ? policy->period_ms : sample_rate_update(&rate, &sensor->rate, &sample);
+        messages += sample_filter_apply(&filter, &s_filter_config, &sample);
+        t_ms += period_ms;
+    }
+
+    double energy_mj = readings * BENCH_WAKE_MJ;
+    printf("  %-18s %6zu readings %8.0f J", policy->name, readings, energy_mj / 1000.0);
+    if (baseline_mj > 0.0) {
+        printf(" (%+5.0f %%)", 100.0 * (energy_mj - baseline_mj) / baseline_mj);
+    }
+    printf(", %5zu messages %5.2f s airtime\n", messages, messages * BENCH_MESSAGE_AIRTIME_MS / 1000.0);
+
+    for (int ch = 0; ch < SAMPLE_RATE_CHANNELS; ch++) {
+        if (!(sensor->flags & s_channel_flags[ch])) {
+            continue;
+        }
+        double sum2 = 0.0, max = 0.0;
+        size_t i = 0, n = 0;
+        for (uint32_t t = times[0]; t <= times[readings - 1]; t++) {
+            while (i + 1 < readings - 1 && times[i + 1] <= t) {
+                i++;
+            }
+            double span = (double)times[i + 1] - times[i];
+            double v = values[ch][i] + (double)(values[ch][i + 1] - values[ch][i]) * (t - times[i]) / span;
+            double e = fabs(v - s_truth[ch][t]);
+            sum2 += e * e;
+            max = e > max ? e : max;
+            n++;
+        }
+        printf("    %-12s reconstruction error RMS %6.1f, max %6.1f\n", s_channel_names[ch], sqrt(sum2 / n), max);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    if (!seed) {
+        fprintf(stderr, "usage: %s [seed]\n", argv[0]);
+        return 2;
+    }
+    s_rand = seed;
+    generate_day();
+
+    printf("One day, %d door openings, errors in sample units (0.01 degC, 0.01 %%RH, Pa)\n", BENCH_DOORS);
+    for (size_t k = 0; k < sizeof(s_sensors) / sizeof(s_sensors[0]); k++) {
+        const bench_sensor_t *sensor = &s_sensors[k];
+        double baseline_mj = (BENCH_DAY_S / (s_policies[0].period_ms / 1000) + 1) * BENCH_WAKE_MJ;
+        printf("%s, adaptive between %u and %u s:\n", sensor->name, sensor->rate.min_period_ms / 1000,
+               sensor->rate.max_period_ms / 1000);
+        for (size_t p = 0; p < sizeof(s_policies) / sizeof(s_policies[0]); p++) {
+            run(sensor, &s_policies[p], seed + 1, p ? baseline_mj : 0.0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Decodes the sample batches (sample_codec.h) and window summaries
+ * (sample_aggregate.h) of a simulation run with HOST_MQTT_DUMP set, as the
+ * backend would: reads its output, prints each sample and summary with its
+ * time, Unix (UTC) or node clock and boot, and totals the payload bytes of
+ * the batches against what the same samples take in version 1 batches.
+ * Other lines are ignored. Summaries are read on the summary topic, batches
+ * on the given topics or by default the samples and history topics.
+ *
+ * usage: HOST_MQTT_DUMP=1 node_sensor_host 3600 100 | sample_dump [topic ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample_codec.h"
+#include "sample_aggregate.h"
+
+#define DUMP_LINE_MAX 4096
+
+static const char *const s_default_topics[] = {
+    "mestrado/iot/aluno/yan/amostras",
+    "mestrado/iot/aluno/yan/historico",
+};
+static const char *const s_summary_topic = "mestrado/iot/aluno/yan/resumo";
+
+static size_t parse_hex(const char *hex, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    unsigned byte;
+
+    while (len < size && sscanf(hex, "%2x", &byte) == 1) {
+        buf[len++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return len;
+}
+
+/* Topic of a dump line, or NULL for another line or topic. */
+static const char *match_topic(const char *line, const char *const *topics, int count)
+{
+    if (strncmp(line, "mqtt> ", 6) != 0) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(topics[i]);
+        if (strncmp(line + 6, topics[i], len) == 0 && line[6 + len] == ' ') {
+            return topics[i];
+        }
+    }
+    return NULL;
+}
+
+static size_t v1_size(const sensor_sample_t *s)
+{
+    return 1 + 4 + ((s->flags & SAMPLE_HAS_TEMPERATURE) ? 2 : 0) + ((s->flags & SAMPLE_HAS_HUMIDITY) ? 2 : 0) +
+           ((s->flags & SAMPLE_HAS_PRESSURE) ? 4 : 0);
+}
+
+static void format_time(char *when, size_t size, uint32_t timestamp, uint8_t flags, uint16_t boot)
+{
+    if (flags & SAMPLE_TIME_SYNCED) {
+        time_t t = timestamp;
+        strftime(when, size, "%Y-%m-%d %H:%M:%S", gmtime(&t));
+    } else {
+        snprintf(when, size, "boot %u +%us", boot, timestamp);
+    }
+}
+
+static void print_sample(const sensor_sample_t *s)
+{
+    char when[32];
+
+    format_time(when, sizeof(when), s->timestamp, s->flags, s->boot);
+    printf("  %-19s sensor %u", when, s->sensor);
+    if (s->flags & SAMPLE_HAS_TEMPERATURE) {
+        printf(" T %d", s->temperature);
+    }
+    if (s->flags & SAMPLE_HAS_HUMIDITY) {
+        printf(" H %u", s->humidity);
+    }
+    if (s->flags & SAMPLE_HAS_PRESSURE) {
+        printf(" P %u", s->pressure);
+    }
+    printf("\n");
+}
+
+static void print_summary(const sample_summary_t *s)
+{
+    static const char *const names[SAMPLE_AGGREGATE_CHANNELS] = { "T", "H", "P" };
+    char when[32];
+
+    format_time(when, sizeof(when), s->timestamp, s->flags, s->boot);
+    printf("  %-19s sensor %u, %u readings over %us:", when, s->sensor, s->count, s->span_s);
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        const sample_summary_channel_t *c = &s->channels[ch];
+        if (s->flags & (1 << ch)) {
+            printf(" %s %d..%d mean %d sd %u", names[ch], c->min, c->max, c->mean, c->stddev);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *const *topics = argc > 1 ? (const char *const *)&argv[1] : s_default_topics;
+    int topic_count = argc > 1 ? argc - 1 : (int)(sizeof(s_default_topics) / sizeof(s_default_topics[0]));
+    static char line[DUMP_LINE_MAX];
+    uint8_t buf[SAMPLE_CODEC_BATCH_SIZE(SAMPLE_CODEC_MAX_SAMPLES)];
+    sensor_sample_t samples[SAMPLE_CODEC_MAX_SAMPLES];
+    size_t batches = 0, total = 0, synced = 0, bytes = 0, v1_bytes = 0;
+    size_t summaries = 0, summary_bytes = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        const char *topic = match_topic(line, topics, topic_count);
+        const char *summary_topic = match_topic(line, &s_summary_topic, 1);
+        if (!topic && !summary_topic) {
+            continue;
+        }
+        size_t len = parse_hex(line + 7 + strlen(topic ? topic : summary_topic), buf, sizeof(buf));
+        if (!topic) {
+            sample_summary_t summary;
+            if (!sample_summary_decode(buf, len, &summary)) {
+                printf("malformed summary, %zu bytes\n", len);
+                continue;
+            }
+            printf("%s: summary, %zu bytes\n", summary_topic, len);
+            print_summary(&summary);
+            summaries++;
+            summary_bytes += len;
+            continue;
+        }
+        size_t count = sample_codec_decode(buf, len, samples, SAMPLE_CODEC_MAX_SAMPLES);
+        if (count == 0) {
+            printf("malformed batch, %zu bytes\n", len);
+            continue;
+        }
+        printf("%s: %zu samples, %zu bytes (version %u)\n", topic, count, len, buf[0]);
+        v1_bytes += SAMPLE_CODEC_HEADER_SIZE - 4;
+        for (size_t i = 0; i < count; i++) {
+            print_sample(&samples[i]);
+            synced += (samples[i].flags & SAMPLE_TIME_SYNCED) != 0;
+            v1_bytes += v1_size(&samples[i]);
+        }
+        batches++;
+        total += count;
+        bytes += len;
+    }
+    printf("%zu batches, %zu samples (%zu in Unix time), %zu bytes, %zu in version 1\n",
+           batches, total, synced, bytes, v1_bytes);
+    printf("%zu summaries, %zu bytes\n", summaries, summary_bytes);
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Sensor scheduler benchmark: aggregate samples per second of five sensors
+ * (DHT11, DHT22, SI7021, BME280, BMP280) each on its shortest period, with
+ * the sensors.c scheduler against one blocking read after the other.
+ *
+ * usage: sensor_bench [simulated_seconds] [time_scale]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs_flash.h"
+#include "sensors.h"
+#include "host_sim.h"
+
+#define BENCH_SCL_GPIO 14
+#define BENCH_SDA_GPIO 4
+
+typedef struct
+{
+    const char *name;
+    sensor_config_t config;
+} bench_sensor_t;
+
+static bench_sensor_t s_sensors[5];
+static size_t s_sensor_count;
+static uint32_t s_samples;
+static volatile bool s_stop;
+static SemaphoreHandle_t s_done;
+
+static void bench_add_dht(const char *name, dht_sensor_type_t model, gpio_num_t gpio, sim_dht_model_t sim_model)
+{
+    bench_sensor_t *b = &s_sensors[s_sensor_count++];
+    b->name = name;
+    b->config = (sensor_config_t){ .type = SAMPLE_SENSOR_DHT, .dht = { .model = model, .gpio = gpio } };
+    sim_dht_attach(gpio, sim_model);
+}
+
+static void bench_add_bme280(const char *name, uint8_t address, uint8_t chip_id)
+{
+    bench_sensor_t *b = &s_sensors[s_sensor_count++];
+    b->name = name;
+    b->config = (sensor_config_t){ .type = SAMPLE_SENSOR_BME280, .bme280 = bme280_config_default };
+    b->config.bme280.address = address;
+    b->config.bme280.gpio_scl = BENCH_SCL_GPIO;
+    b->config.bme280.gpio_sda = BENCH_SDA_GPIO;
+    sim_bme280_attach(address, chip_id);
+}
+
+static void count_sample(sensor_sample_t *sample, void *arg)
+{
+    s_samples++;
+}
+
+/* sensors_run on every period, as the firmware's sampler task does. */
+static void scheduler_task(void *arg)
+{
+    while (!s_stop) {
+        vTaskDelay(sensors_run(count_sample, NULL));
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+/* Baseline: the same periods, each sensor read to completion before the next one. */
+static void sequential_task(void *arg)
+{
+    static bme280_dev_t devs[5];
+    TickType_t next_due[5];
+
+    for (size_t i = 0; i < s_sensor_count; i++) {
+        const sensor_config_t *c = &s_sensors[i].config;
+        if (c->type == SAMPLE_SENSOR_BME280) {
+            bme280_dev_init(&devs[i], c->bme280);
+        } else {
+            dht_init(c->dht.gpio, true);
+            dht_set_decode_mode(c->dht.gpio, DHT_DECODE_EDGE_CAPTURE);
+        }
+        next_due[i] = xTaskGetTickCount() + pdMS_TO_TICKS(sensors_get_min_period_ms(c));
+    }
+    while (!s_stop) {
+        bool idle = true;
+        for (size_t i = 0; i < s_sensor_count; i++) {
+            const sensor_config_t *c = &s_sensors[i].config;
+            if ((int32_t)(xTaskGetTickCount() - next_due[i]) < 0) {
+                continue;
+            }
+            idle = false;
+            next_due[i] = xTaskGetTickCount() + pdMS_TO_TICKS(sensors_get_min_period_ms(c));
+            if (c->type == SAMPLE_SENSOR_BME280) {
+                if (bme280_dev_start_forced_read(&devs[i], NULL, NULL) &&
+                    bme280_dev_wait_forced_read(&devs[i]) == BME280_READ_DONE) {
+                    s_samples++;
+                }
+            } else {
+                int16_t humidity, temperature;
+                if (dht_read_data(c->dht.model, c->dht.gpio, &humidity, &temperature) == ESP_OK) {
+                    s_samples++;
+                }
+            }
+        }
+        if (idle) {
+            vTaskDelay(1);
+        }
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static double bench_run(TaskFunction_t task, double seconds)
+{
+    s_samples = 0;
+    s_stop = false;
+    uint64_t start = sim_time_us();
+    xTaskCreate(task, "bench", 4096, NULL, 6, NULL);
+    sim_sleep_us((uint64_t)(seconds * 1e6));
+    s_stop = true;
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    return s_samples / ((sim_time_us() - start) / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    double run_seconds = argc > 1 ? atof(argv[1]) : 60.0;
+    double time_scale = argc > 2 ? atof(argv[2]) : 1.0;
+
+    sim_clock_init(time_scale);
+    nvs_flash_init();
+    s_done = xSemaphoreCreateBinary();
+    bench_add_dht("DHT11", DHT_TYPE_DHT11, GPIO_NUM_5, SIM_DHT11);
+    bench_add_dht("DHT22", DHT_TYPE_DHT22, GPIO_NUM_12, SIM_DHT22);
+    bench_add_dht("SI7021", DHT_TYPE_SI7021, GPIO_NUM_13, SIM_SI7021);
+    bench_add_bme280("BME280", 0x76, 0x60);
+    bench_add_bme280("BMP280", 0x77, 0x58);
+
+    for (size_t i = 0; i < s_sensor_count; i++) {
+        sensors_add(&s_sensors[i].config); // period 0: each sensor's minimum
+        printf("%-7s min period %u ms\n", s_sensors[i].name, sensors_get_min_period_ms(&s_sensors[i].config));
+    }
+    sensors_init(true);
+    double scheduled = bench_run(scheduler_task, run_seconds);
+    for (size_t i = 0; i < sensors_count(); i++) {
+        const sensor_stats_t *stats = sensors_get_stats(i);
+        printf("%-7s samples=%u errors=%u missed=%u late_max=%u ms\n", s_sensors[i].name, stats->samples,
+               stats->errors, stats->missed, stats->late_max_ms);
+    }
+    double sequential = bench_run(sequential_task, run_seconds);
+
+    printf("\nscheduler:  %.2f samples/s\n", scheduled);
+    printf("sequential: %.2f samples/s\n", sequential);
+    return 0;
+}
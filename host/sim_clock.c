@@ -0,0 +1,162 @@
+/*
+ * Simulated clock, busy waits and the default environment script.
+ */
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "host_sim.h"
+#include "rom/ets_sys.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+static struct timespec s_start;
+static double s_time_scale = 1.0;
+static atomic_uint_fast64_t s_busy_us;
+static sim_environment_fn_t s_environment_fn;
+static sim_stats_t s_stats;
+static __thread bool s_in_isr;
+static __thread uint64_t s_isr_time_us;
+
+static uint64_t real_elapsed_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - s_start.tv_sec) * 1000000ULL +
+           (uint64_t)((now.tv_nsec - s_start.tv_nsec) / 1000);
+}
+
+/* Slow indoor drift: a few degrees and %RH over an hour, pressure wobble. */
+static void default_environment(uint64_t time_us, sim_environment_t *env)
+{
+    double t = (double)time_us / 1e6;
+    env->temperature = (int32_t)lround(2400.0 + 250.0 * sin(t * 2.0 * M_PI / 3600.0));
+    env->humidity = (uint32_t)lround(5500.0 - 600.0 * sin(t * 2.0 * M_PI / 2700.0));
+    env->pressure = (uint32_t)lround(100650.0 + 40.0 * sin(t * 2.0 * M_PI / 900.0));
+}
+
+void sim_clock_init(double time_scale)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+    s_time_scale = time_scale > 0 ? time_scale : 1.0;
+    atomic_store(&s_busy_us, 0);
+    if (!s_environment_fn) {
+        s_environment_fn = default_environment;
+    }
+}
+
+double sim_time_scale(void)
+{
+    return s_time_scale;
+}
+
+uint64_t sim_time_us(void)
+{
+    return (uint64_t)((double)real_elapsed_us() * s_time_scale) + atomic_load(&s_busy_us);
+}
+
+void sim_sleep_us(uint64_t us)
+{
+    uint64_t target = sim_time_us() + us;
+    for (;;) {
+        uint64_t now = sim_time_us();
+        if (now >= target) {
+            return;
+        }
+        uint64_t real_us = (uint64_t)((double)(target - now) / s_time_scale) + 1;
+        struct timespec ts = { .tv_sec = real_us / 1000000, .tv_nsec = (real_us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void sim_busy_wait_us(uint64_t us)
+{
+    atomic_fetch_add(&s_busy_us, us);
+}
+
+uint64_t sim_busy_time_us(void)
+{
+    return atomic_load(&s_busy_us);
+}
+
+uint32_t sim_ccount(void)
+{
+    uint64_t us = s_in_isr ? s_isr_time_us : sim_time_us();
+    return (uint32_t)(us * CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ);
+}
+
+void sim_isr_enter(uint64_t event_time_us)
+{
+    s_in_isr = true;
+    s_isr_time_us = event_time_us;
+}
+
+void sim_isr_exit(void)
+{
+    s_in_isr = false;
+}
+
+bool sim_in_isr(uint64_t *event_time_us)
+{
+    if (s_in_isr && event_time_us) {
+        *event_time_us = s_isr_time_us;
+    }
+    return s_in_isr;
+}
+
+void os_delay_us(uint16_t us)
+{
+    sim_busy_wait_us(us);
+}
+
+void ets_delay_us(uint32_t us)
+{
+    sim_busy_wait_us(us);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)(sim_time_us() - sim_boot_time_us());
+}
+
+void sim_set_environment(sim_environment_fn_t fn)
+{
+    s_environment_fn = fn ? fn : default_environment;
+}
+
+void sim_get_environment(sim_environment_t *env)
+{
+    s_environment_fn(sim_time_us(), env);
+}
+
+sim_stats_t *sim_stats(void)
+{
+    return &s_stats;
+}
+
+void sim_report(void)
+{
+    const sim_stats_t *s = &s_stats;
+    double seconds = (double)sim_time_us() / 1e6;
+
+    printf("\n=== host simulation report (%.1f s simulated) ===\n", seconds);
+    printf("dht:  reads=%u level_polls=%u gpio_interrupts=%u critical_us=%llu faults=%u\n",
+           s->dht_reads, s->dht_level_polls, s->gpio_interrupts, (unsigned long long)s->critical_us,
+           s->dht_faults);
+    printf("i2c:  transactions=%u cmd_links=%u bytes=%u bus_us=%llu\n",
+           s->i2c_transactions, s->i2c_cmd_links, s->i2c_bytes, (unsigned long long)s->i2c_bus_us);
+    printf("mqtt: publishes=%u payload_bytes=%u wire_bytes=%u\n",
+           s->mqtt_publishes, s->mqtt_payload_bytes, s->mqtt_wire_bytes);
+    printf("mqtt: disconnects=%u\n", s->mqtt_disconnects);
+    printf("flash: reads=%u writes=%u bytes_written=%u sector_erases=%u\n",
+           s->flash_reads, s->flash_writes, s->flash_bytes_written, s->flash_erases);
+    printf("wifi: scans=%u direct_connects=%u rf_off=%u\n", s->wifi_scans, s->wifi_direct_connects,
+           s->wifi_rf_off);
+    printf("sntp: syncs=%u\n", s->sntp_syncs);
+    printf("boot: boots=%u deep_sleeps=%u awake_s=%.1f asleep_s=%.1f\n", s->boots, s->deep_sleeps,
+           seconds - (double)s->asleep_us / 1e6, (double)s->asleep_us / 1e6);
+    if (s->boot_publishes) {
+        printf("boot: boot_to_publish_ms avg=%.1f max=%.1f over %u boots\n",
+               (double)s->boot_to_publish_us / s->boot_publishes / 1e3, (double)s->boot_to_publish_max_us / 1e3,
+               s->boot_publishes);
+    }
+}
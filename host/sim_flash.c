@@ -0,0 +1,181 @@
+/*
+ * SPI flash partition stand-in backed by a file.
+ *
+ * The partitions of ../partitions.csv live in a 2 MB image file, created
+ * erased (0xFF) on first use and kept across runs, so a rerun is a reboot
+ * with the flash contents of the previous one. NOR semantics are enforced:
+ * a write can only clear bits (the result is old & new), only whole sectors
+ * can be erased, and writes must be word aligned as on the ESP8266.
+ *
+ * HOST_FLASH_IMAGE      image file path (default host_flash.bin)
+ * HOST_FLASH_CUT_AFTER  power cut: the Nth write or erase is only half done,
+ *                       then the process exits on the spot
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+#include "host_sim.h"
+
+#define SIM_FLASH_SIZE (2 * 1024 * 1024)
+#define SIM_FLASH_DEFAULT_IMAGE "host_flash.bin"
+// Typical sector erase and page program times of the 2 MB parts on ESP8266 modules
+#define SIM_FLASH_ERASE_US 45000
+#define SIM_FLASH_WRITE_US_PER_BYTE 3
+
+static const esp_partition_t s_partitions[] = {
+    { ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x6000, "nvs", false },
+    { ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_PHY, 0xf000, 0x1000, "phy_init", false },
+    { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, 0x10000, 0xF0000, "factory", false },
+    { ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x100000, 0x40000, "samples", false },
+};
+
+static uint8_t *s_flash;
+static uint32_t s_cut_after;
+static pthread_mutex_t s_flash_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool flash_open(void)
+{
+    if (s_flash) {
+        return true;
+    }
+    const char *path = getenv("HOST_FLASH_IMAGE");
+    if (!path) {
+        path = SIM_FLASH_DEFAULT_IMAGE;
+    }
+    const char *cut = getenv("HOST_FLASH_CUT_AFTER");
+    s_cut_after = cut ? (uint32_t)strtoul(cut, NULL, 0) : 0;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size != SIM_FLASH_SIZE) {
+        static uint8_t erased[SPI_FLASH_SEC_SIZE];
+        memset(erased, 0xFF, sizeof(erased));
+        if (ftruncate(fd, 0) != 0) {
+            perror(path);
+            close(fd);
+            return false;
+        }
+        for (uint32_t addr = 0; addr < SIM_FLASH_SIZE; addr += sizeof(erased)) {
+            if (pwrite(fd, erased, sizeof(erased), addr) != sizeof(erased)) {
+                perror(path);
+                close(fd);
+                return false;
+            }
+        }
+    }
+    s_flash = mmap(NULL, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s_flash == MAP_FAILED) {
+        s_flash = NULL;
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+/* True when the write or erase just counted is the one interrupted by the power cut. */
+static bool flash_power_cut_now(void)
+{
+    sim_stats_t *stats = sim_stats();
+    return s_cut_after && stats->flash_writes + stats->flash_erases == s_cut_after;
+}
+
+static void flash_power_cut(void)
+{
+    msync(s_flash, SIM_FLASH_SIZE, MS_SYNC);
+    fprintf(stderr, "\n*** simulated power cut after %u flash operations ***\n", s_cut_after);
+    _exit(3);
+}
+
+static bool flash_range_valid(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition && offset <= partition->size && size <= partition->size - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < sizeof(s_partitions) / sizeof(s_partitions[0]); i++) {
+        const esp_partition_t *p = &s_partitions[i];
+        if (p->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (!label || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!dst || !flash_range_valid(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!flash_open()) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&s_flash_lock);
+    memcpy(dst, s_flash + partition->address + src_offset, size);
+    sim_stats()->flash_reads++;
+    pthread_mutex_unlock(&s_flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!src || !flash_range_valid(partition, dst_offset, size) || (dst_offset | size) % 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!flash_open()) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&s_flash_lock);
+    sim_stats_t *stats = sim_stats();
+    stats->flash_writes++;
+    stats->flash_bytes_written += size;
+    bool cut = flash_power_cut_now();
+    if (cut) {
+        size /= 2;
+    }
+    uint8_t *dst = s_flash + partition->address + dst_offset;
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < size; i++) {
+        dst[i] &= bytes[i];
+    }
+    if (cut) {
+        flash_power_cut();
+    }
+    pthread_mutex_unlock(&s_flash_lock);
+    sim_busy_wait_us(size * SIM_FLASH_WRITE_US_PER_BYTE);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t start_addr, size_t size)
+{
+    if (!flash_range_valid(partition, start_addr, size) || (start_addr | size) % SPI_FLASH_SEC_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!flash_open()) {
+        return ESP_FAIL;
+    }
+    pthread_mutex_lock(&s_flash_lock);
+    sim_stats_t *stats = sim_stats();
+    stats->flash_erases += size / SPI_FLASH_SEC_SIZE;
+    bool cut = flash_power_cut_now();
+    memset(s_flash + partition->address + start_addr, 0xFF, cut ? size / 2 : size);
+    if (cut) {
+        flash_power_cut();
+    }
+    pthread_mutex_unlock(&s_flash_lock);
+    sim_busy_wait_us((uint64_t)(size / SPI_FLASH_SEC_SIZE) * SIM_FLASH_ERASE_US);
+    return ESP_OK;
+}
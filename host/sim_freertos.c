@@ -0,0 +1,376 @@
+/*
+ * FreeRTOS stand-in: tasks are pthreads, queues/semaphores/event groups are
+ * mutex + condition variable pairs, ticks are derived from the simulated clock.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "host_sim.h"
+
+#define SIM_TICK_US (1000000ULL / configTICK_RATE_HZ)
+
+struct sim_task
+{
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t priority;
+    uint32_t stack_depth;
+};
+
+struct sim_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *storage;
+};
+
+struct sim_event_group
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+static pthread_mutex_t s_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread int s_critical_depth;
+static __thread uint64_t s_critical_since;
+static __thread struct sim_task *s_current_task;
+
+void vPortEnterCritical(void)
+{
+    pthread_mutex_lock(&s_critical);
+    if (s_critical_depth++ == 0) {
+        s_critical_since = sim_time_us();
+    }
+}
+
+void vPortExitCritical(void)
+{
+    if (--s_critical_depth == 0) {
+        sim_stats()->critical_us += sim_time_us() - s_critical_since;
+    }
+    pthread_mutex_unlock(&s_critical);
+}
+
+/* Absolute host deadline for a wait of the given number of simulated ticks. */
+static void deadline_after_ticks(TickType_t ticks, struct timespec *deadline)
+{
+    uint64_t real_us = (uint64_t)((double)ticks * SIM_TICK_US / sim_time_scale());
+
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += real_us / 1000000;
+    deadline->tv_nsec += (long)(real_us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Waits on cond; returns false once the simulated timeout has elapsed. */
+static bool wait_for_change(pthread_cond_t *cond, pthread_mutex_t *lock,
+                            TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == 0) {
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static void *task_trampoline(void *param)
+{
+    struct sim_task *task = param;
+    s_current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *const pcName, const uint32_t usStackDepth,
+                       void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pxCreatedTask)
+{
+    struct sim_task *task = calloc(1, sizeof(*task));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = pxTaskCode;
+    task->arg = pvParameters;
+    task->priority = uxPriority;
+    task->stack_depth = usStackDepth;
+    strncpy(task->name, pcName ? pcName : "", sizeof(task->name) - 1);
+
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (pxCreatedTask) {
+        *pxCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL || xTaskToDelete == s_current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(xTaskToDelete->thread);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current_task;
+}
+
+/* Stack use is not simulated: the whole configured stack reads as never used. */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    struct sim_task *task = xTask ? xTask : s_current_task;
+    return task ? task->stack_depth : 0;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)((sim_time_us() - sim_boot_time_us()) / SIM_TICK_US);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+    sim_sleep_us((uint64_t)xTicksToDelay * SIM_TICK_US);
+}
+
+void vTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement)
+{
+    TickType_t wake = *pxPreviousWakeTime + xTimeIncrement;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0) {
+        vTaskDelay(wake - now);
+    }
+    *pxPreviousWakeTime = wake;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    if (!q) {
+        return NULL;
+    }
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    if (uxItemSize) {
+        q->storage = calloc(uxQueueLength, uxItemSize);
+        if (!q->storage) {
+            free(q);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    pthread_mutex_destroy(&xQueue->lock);
+    pthread_cond_destroy(&xQueue->changed);
+    free(xQueue->storage);
+    free(xQueue);
+}
+
+static void queue_push_locked(QueueHandle_t q, const void *item)
+{
+    if (item && q->item_size) { // semaphores give no item
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->storage + tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    deadline_after_ticks(xTicksToWait == portMAX_DELAY ? 0 : xTicksToWait, &deadline);
+
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == xQueue->length) {
+        if (!wait_for_change(&xQueue->changed, &xQueue->lock, xTicksToWait, &deadline)) {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    queue_push_locked(xQueue, pvItemToQueue);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken) {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xQueueSend(xQueue, pvItemToQueue, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void *pvItemToQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->count = 0;
+    queue_push_locked(xQueue, pvItemToQueue);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    deadline_after_ticks(xTicksToWait == portMAX_DELAY ? 0 : xTicksToWait, &deadline);
+
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0) {
+        if (!wait_for_change(&xQueue->changed, &xQueue->lock, xTicksToWait, &deadline)) {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_EMPTY;
+        }
+    }
+    if (xQueue->item_size && pvBuffer) {
+        memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->item_size, xQueue->item_size);
+    }
+    xQueue->head = (xQueue->head + 1) % xQueue->length;
+    xQueue->count--;
+    pthread_cond_broadcast(&xQueue->changed);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    xQueue->count = 0;
+    xQueue->head = 0;
+    pthread_cond_broadcast(&xQueue->changed);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex) {
+        xSemaphoreGive(mutex);
+    }
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return xQueueReceive(xSemaphore, NULL, xBlockTime);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return xQueueSend(xSemaphore, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    return xQueueSendFromISR(xSemaphore, NULL, pxHigherPriorityTaskWoken);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct sim_event_group *group = calloc(1, sizeof(*group));
+    if (!group) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->changed, NULL);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToSet)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    xEventGroup->bits |= uxBitsToSet;
+    EventBits_t bits = xEventGroup->bits;
+    pthread_cond_broadcast(&xEventGroup->changed);
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToClear)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t xEventGroup)
+{
+    pthread_mutex_lock(&xEventGroup->lock);
+    EventBits_t bits = xEventGroup->bits;
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, const EventBits_t uxBitsToWaitFor,
+                                const BaseType_t xClearOnExit, const BaseType_t xWaitForAllBits,
+                                TickType_t xTicksToWait)
+{
+    struct timespec deadline;
+    deadline_after_ticks(xTicksToWait == portMAX_DELAY ? 0 : xTicksToWait, &deadline);
+
+    pthread_mutex_lock(&xEventGroup->lock);
+    for (;;) {
+        EventBits_t matched = xEventGroup->bits & uxBitsToWaitFor;
+        bool satisfied = xWaitForAllBits ? matched == uxBitsToWaitFor : matched != 0;
+        if (satisfied) {
+            break;
+        }
+        if (!wait_for_change(&xEventGroup->changed, &xEventGroup->lock, xTicksToWait, &deadline)) {
+            break;
+        }
+    }
+    EventBits_t bits = xEventGroup->bits;
+    if (xClearOnExit && (bits & uxBitsToWaitFor)) {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    pthread_mutex_unlock(&xEventGroup->lock);
+    return bits;
+}
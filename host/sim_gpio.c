@@ -0,0 +1,337 @@
+/*
+ * GPIO stand-in with a DHT sensor model.
+ *
+ * A simulated DHT answers a start pulse (line held low for long enough, then
+ * released) with the datasheet waveform: ~30 us release, 80 us low, 80 us
+ * high, 40 bits of 50 us low + 26/70 us high, then 50 us low. Levels are
+ * evaluated against the busy-wait clock, which is what the bit-banging
+ * decoder advances while it polls, so host scheduling noise cannot skew it.
+ *
+ * With an edge interrupt enabled on the pin, the whole response is instead
+ * replayed into the handler when the line is released, each call observing
+ * its edge's timestamp through soc_get_ccount() and gpio_get_level().
+ *
+ * HOST_DHT_FAULTS=<percent> spoils that share of the responses, in turn: no
+ * response, a frame cut short (the line released mid-frame) and a flipped
+ * data bit.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "driver/gpio.h"
+#include "host_sim.h"
+
+#define DHT_RELEASE_US 30
+#define DHT_PREAMBLE_US 80
+#define DHT_BIT_LOW_US 50
+#define DHT_BIT_ZERO_US 26
+#define DHT_BIT_ONE_US 70
+#define DHT_FRAME_BITS 40
+// Simulated time after which a response is over even if nothing busy-waited through its end.
+// Well above the frame, as polling stretches it in simulated time, and below the read interval.
+#define DHT_RESPONSE_MAX_US 500000
+
+typedef struct
+{
+    bool configured;
+    gpio_mode_t mode;
+    uint32_t out_level;
+    uint64_t low_since;
+
+    bool dht_attached;
+    sim_dht_model_t dht_model;
+    bool responding;
+    uint64_t response_start;    // busy-wait clock at release
+    uint64_t response_time;     // simulated time at release
+    uint8_t frame[5];
+    int frame_bits;             // bits sent before the line is released, DHT_FRAME_BITS if not cut
+
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr;
+    void *isr_arg;
+} sim_pin_t;
+
+typedef enum
+{
+    DHT_FAULT_SILENT,
+    DHT_FAULT_CUT,
+    DHT_FAULT_BIT_FLIP,
+    DHT_FAULT_KINDS,
+} dht_fault_t;
+
+static sim_pin_t s_pins[GPIO_NUM_MAX];
+static bool s_isr_service_installed;
+static int s_fault_percent = -1;    // -1 until HOST_DHT_FAULTS is read
+static uint32_t s_fault_rand;
+static uint32_t s_fault_next;
+
+static uint32_t fault_rand(void)
+{
+    // xorshift32
+    s_fault_rand ^= s_fault_rand << 13;
+    s_fault_rand ^= s_fault_rand >> 17;
+    s_fault_rand ^= s_fault_rand << 5;
+    return s_fault_rand;
+}
+
+/* Spoils the response just built, if it draws a fault. Returns false for no response. */
+static bool dht_inject_fault(sim_pin_t *p)
+{
+    if (s_fault_percent < 0) {
+        const char *faults = getenv("HOST_DHT_FAULTS");
+        s_fault_percent = faults ? atoi(faults) : 0;
+        // Seeded from the clock, which resumes across deep sleeps: each wake draws differently
+        s_fault_rand = (uint32_t)(sim_time_us() / 1000) * 2654435761u | 1;
+    }
+    p->frame_bits = DHT_FRAME_BITS;
+    if (s_fault_percent <= 0 || (int)(fault_rand() % 100) >= s_fault_percent) {
+        return true;
+    }
+    sim_stats()->dht_faults++;
+    switch (s_fault_next++ % DHT_FAULT_KINDS) {
+        case DHT_FAULT_SILENT:
+            return false;
+        case DHT_FAULT_CUT:
+            p->frame_bits = 1 + fault_rand() % (DHT_FRAME_BITS - 1);
+            return true;
+        default:
+            p->frame[fault_rand() % 4] ^= 1 << (fault_rand() % 8);
+            return true;
+    }
+}
+
+static uint32_t dht_min_start_us(sim_dht_model_t model)
+{
+    switch (model) {
+        case SIM_DHT11:
+            return 18000;
+        case SIM_DHT22:
+            return 1000;
+        default:
+            return 400;
+    }
+}
+
+static void dht_build_frame(sim_pin_t *p)
+{
+    sim_environment_t env;
+    sim_get_environment(&env);
+
+    int32_t temp10 = env.temperature / 10;
+    uint32_t hum10 = env.humidity / 10;
+
+    if (p->dht_model == SIM_DHT11) {
+        p->frame[0] = hum10 / 10;
+        p->frame[1] = 0;
+        // Negative temperatures flagged in bit 7 of the tenths byte
+        uint32_t t = temp10 < 0 ? -temp10 : temp10;
+        p->frame[2] = t / 10;
+        p->frame[3] = (t % 10) | (temp10 < 0 ? 0x80 : 0);
+    } else {
+        uint16_t t = temp10 < 0 ? (uint16_t)(0x8000 | -temp10) : (uint16_t)temp10;
+        p->frame[0] = hum10 >> 8;
+        p->frame[1] = hum10 & 0xFF;
+        p->frame[2] = t >> 8;
+        p->frame[3] = t & 0xFF;
+    }
+    p->frame[4] = (p->frame[0] + p->frame[1] + p->frame[2] + p->frame[3]) & 0xFF;
+}
+
+/* Line level driven by the sensor, t microseconds after the host released it. */
+static int dht_level_at(const sim_pin_t *p, uint64_t t)
+{
+    if (t < DHT_RELEASE_US) {
+        return 1;
+    }
+    t -= DHT_RELEASE_US;
+    if (t < DHT_PREAMBLE_US) {
+        return 0;
+    }
+    t -= DHT_PREAMBLE_US;
+    if (t < DHT_PREAMBLE_US) {
+        return 1;
+    }
+    t -= DHT_PREAMBLE_US;
+
+    for (int i = 0; i < DHT_FRAME_BITS; i++) {
+        bool one = p->frame[i / 8] & (0x80 >> (i % 8));
+        uint32_t high = one ? DHT_BIT_ONE_US : DHT_BIT_ZERO_US;
+        if (i == p->frame_bits) {
+            return 1;
+        }
+        if (t < DHT_BIT_LOW_US) {
+            return 0;
+        }
+        t -= DHT_BIT_LOW_US;
+        if (t < high) {
+            return 1;
+        }
+        t -= high;
+    }
+    return t < DHT_BIT_LOW_US ? 0 : 1;
+}
+
+/* Busy-clock time of every edge of the response, starting with the release. */
+static int dht_edge_times(const sim_pin_t *p, uint64_t times[], int max)
+{
+    uint64_t t = 0;
+    int n = 0;
+    uint32_t durations[3 + DHT_FRAME_BITS * 2 + 1];
+    int segments = 0;
+
+    durations[segments++] = DHT_RELEASE_US;
+    durations[segments++] = DHT_PREAMBLE_US;
+    durations[segments++] = DHT_PREAMBLE_US;
+    for (int i = 0; i < p->frame_bits; i++) {
+        bool one = p->frame[i / 8] & (0x80 >> (i % 8));
+        durations[segments++] = DHT_BIT_LOW_US;
+        durations[segments++] = one ? DHT_BIT_ONE_US : DHT_BIT_ZERO_US;
+    }
+    if (p->frame_bits < DHT_FRAME_BITS) {
+        // Cut short: the line stays high after the last bit sent, no falling edge
+        segments--;
+    } else {
+        durations[segments++] = DHT_BIT_LOW_US;
+    }
+
+    times[n++] = p->response_start;
+    for (int i = 0; i < segments && n < max; i++) {
+        t += durations[i];
+        times[n++] = p->response_start + t;
+    }
+    return n;
+}
+
+static void dht_replay_edges(gpio_num_t pin)
+{
+    sim_pin_t *p = &s_pins[pin];
+    uint64_t times[DHT_FRAME_BITS * 2 + 8];
+    int count = dht_edge_times(p, times, sizeof(times) / sizeof(times[0]));
+
+    for (int i = 0; i < count; i++) {
+        sim_isr_enter(times[i]);
+        sim_stats()->gpio_interrupts++;
+        p->isr(p->isr_arg);
+        sim_isr_exit();
+    }
+}
+
+void sim_dht_attach(gpio_num_t pin, sim_dht_model_t model)
+{
+    s_pins[pin].dht_attached = true;
+    s_pins[pin].dht_model = model;
+    s_pins[pin].out_level = 1;
+}
+
+esp_err_t gpio_config(const gpio_config_t *gpio_cfg)
+{
+    if (!gpio_cfg || gpio_cfg->pin_bit_mask == 0 || gpio_cfg->pin_bit_mask >= (1UL << GPIO_NUM_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (gpio_cfg->pin_bit_mask & (1UL << pin)) {
+            s_pins[pin].configured = true;
+            s_pins[pin].mode = gpio_cfg->mode;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_pin_t *p = &s_pins[gpio_num];
+    uint64_t now = sim_time_us();
+
+    if (!level) {
+        if (p->out_level) {
+            p->low_since = now;
+        }
+        p->responding = false;
+    } else if (!p->out_level && p->dht_attached &&
+               now - p->low_since >= dht_min_start_us(p->dht_model)) {
+        dht_build_frame(p);
+        p->responding = dht_inject_fault(p);
+        p->response_start = sim_busy_time_us();
+        p->response_time = now;
+        sim_stats()->dht_reads++;
+    }
+    bool released = level && !p->out_level;
+    p->out_level = level ? 1 : 0;
+    if (released && p->responding && p->isr && p->intr_type == GPIO_INTR_ANYEDGE) {
+        dht_replay_edges(gpio_num);
+        // Replayed without advancing the busy clock: the line reads idle from now on
+        p->responding = false;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num >= GPIO_NUM_MAX) {
+        return 0;
+    }
+    sim_pin_t *p = &s_pins[gpio_num];
+    if (!p->out_level) {
+        return 0;
+    }
+    if (!p->dht_attached) {
+        return 1;
+    }
+    uint64_t now;
+    if (!sim_in_isr(&now)) {
+        now = sim_busy_time_us();
+        sim_stats()->dht_level_polls++;
+    }
+    if (!p->responding || sim_time_us() - p->response_time >= DHT_RESPONSE_MAX_US) {
+        return 1;
+    }
+    return dht_level_at(p, now - p->response_start);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (gpio_num >= GPIO_NUM_MAX || intr_type >= GPIO_INTR_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int no_use)
+{
+    if (s_isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_isr_service_installed = true;
+    return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    s_isr_service_installed = false;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!s_isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (gpio_num >= GPIO_NUM_MAX || !isr_handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].isr = isr_handler;
+    s_pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].isr = NULL;
+    s_pins[gpio_num].isr_arg = NULL;
+    return ESP_OK;
+}
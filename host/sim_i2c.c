@@ -0,0 +1,444 @@
+/*
+ * I2C master stand-in with a BME280/BMP280 register-map model.
+ *
+ * Command links are recorded and executed against the simulated devices when
+ * i2c_master_cmd_begin() is called. The ESP8266 I2C master is bit-banged by
+ * the CPU, so each transaction advances the busy-wait clock by its bus time
+ * at SIM_I2C_BIT_US per bit (100 kHz SCL).
+ *
+ * Raw ADC values are produced by inverting the datasheet floating-point
+ * compensation formulas for the current simulated environment, so the
+ * driver's integer compensation should land within rounding of it.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2c.h"
+#include "host_sim.h"
+
+#define SIM_I2C_BIT_US 10
+#define SIM_I2C_MAX_DEVICES 4
+
+#define REG_CALIB_00 0x88
+#define REG_CALIB_H1 0xA1
+#define REG_CHIP_ID 0xD0
+#define REG_CALIB_26 0xE1
+#define REG_CTRL_HUM 0xF2
+#define REG_STATUS 0xF3
+#define REG_CTRL_MEAS 0xF4
+#define REG_CONFIG 0xF5
+#define REG_DATA 0xF7
+#define REG_DATA_END 0xFE
+
+#define STATUS_MEASURING 0x08
+
+typedef enum
+{
+    OP_START,
+    OP_WRITE,
+    OP_READ,
+    OP_STOP
+} op_type_t;
+
+typedef struct
+{
+    op_type_t type;
+    uint8_t byte;   // OP_WRITE
+    uint8_t *dest;  // OP_READ
+} op_t;
+
+typedef struct
+{
+    op_t *ops;
+    size_t count;
+    size_t capacity;
+} cmd_link_t;
+
+typedef struct
+{
+    uint16_t T1;
+    int16_t T2, T3;
+    uint16_t P1;
+    int16_t P2, P3, P4, P5, P6, P7, P8, P9;
+    uint8_t H1;
+    int16_t H2;
+    uint8_t H3;
+    int16_t H4, H5;
+    int8_t H6;
+} sim_calib_t;
+
+typedef struct
+{
+    bool present;
+    uint8_t address;
+    uint8_t regs[256];
+    uint8_t reg_ptr;
+    uint64_t measure_end;
+    bool measurement_pending;
+} sim_bme280_t;
+
+static const sim_calib_t s_calib = {
+    .T1 = 28009, .T2 = 25654, .T3 = 50,
+    .P1 = 39145, .P2 = -10750, .P3 = 3024, .P4 = 5667, .P5 = -120,
+    .P6 = -7, .P7 = 15500, .P8 = -14600, .P9 = 6000,
+    .H1 = 75, .H2 = 362, .H3 = 0, .H4 = 324, .H5 = 0, .H6 = 30,
+};
+
+static sim_bme280_t s_devices[SIM_I2C_MAX_DEVICES];
+static bool s_driver_installed;
+
+static double comp_t_fine(double adc_T)
+{
+    const sim_calib_t *c = &s_calib;
+    double var1 = (adc_T / 16384.0 - c->T1 / 1024.0) * c->T2;
+    double var2 = (adc_T / 131072.0 - c->T1 / 8192.0) * (adc_T / 131072.0 - c->T1 / 8192.0) * c->T3;
+    return var1 + var2;
+}
+
+static double comp_pressure(double adc_P, double t_fine)
+{
+    const sim_calib_t *c = &s_calib;
+    double var1 = t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * c->P6 / 32768.0;
+    var2 = var2 + var1 * c->P5 * 2.0;
+    var2 = var2 / 4.0 + c->P4 * 65536.0;
+    var1 = (c->P3 * var1 * var1 / 524288.0 + c->P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * c->P1;
+    double p = 1048576.0 - adc_P;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = c->P9 * p * p / 2147483648.0;
+    var2 = p * c->P8 / 32768.0;
+    return p + (var1 + var2 + c->P7) / 16.0;
+}
+
+static double comp_humidity(double adc_H, double t_fine)
+{
+    const sim_calib_t *c = &s_calib;
+    double h = t_fine - 76800.0;
+    h = (adc_H - (c->H4 * 64.0 + c->H5 / 16384.0 * h)) *
+        (c->H2 / 65536.0 * (1.0 + c->H6 / 67108864.0 * h * (1.0 + c->H3 / 67108864.0 * h)));
+    return h * (1.0 - c->H1 * h / 524288.0);
+}
+
+/* Smallest raw value whose compensated output reaches target (f monotonic). */
+static uint32_t invert(double (*f)(double, double), double arg, double target, uint32_t max, bool increasing)
+{
+    uint32_t lo = 0, hi = max;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        double v = f((double)mid, arg);
+        if (increasing ? v < target : v > target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static double comp_t_fine_arg(double adc_T, double unused)
+{
+    (void)unused;
+    return comp_t_fine(adc_T);
+}
+
+static void bme280_latch_measurement(sim_bme280_t *dev)
+{
+    sim_environment_t env;
+    sim_get_environment(&env);
+
+    // T = t_fine / 5120 degC, so 0.01 degC maps to t_fine * 100 / 5120.
+    double t_fine = env.temperature * 5120.0 / 100.0;
+    uint32_t adc_T = invert(comp_t_fine_arg, 0, t_fine, (1u << 20) - 1, true);
+    t_fine = comp_t_fine(adc_T);
+    uint32_t adc_P = invert(comp_pressure, t_fine, env.pressure, (1u << 20) - 1, false);
+    uint32_t adc_H = invert(comp_humidity, t_fine, env.humidity / 100.0, 0xFFFF, true);
+
+    uint8_t *r = dev->regs;
+    r[0xF7] = adc_P >> 12;
+    r[0xF8] = (adc_P >> 4) & 0xFF;
+    r[0xF9] = (adc_P & 0x0F) << 4;
+    r[0xFA] = adc_T >> 12;
+    r[0xFB] = (adc_T >> 4) & 0xFF;
+    r[0xFC] = (adc_T & 0x0F) << 4;
+    r[0xFD] = adc_H >> 8;
+    r[0xFE] = adc_H & 0xFF;
+}
+
+static uint32_t oversampling_count(uint8_t osrs)
+{
+    return osrs == 0 ? 0 : 1u << (osrs > 5 ? 4 : osrs - 1);
+}
+
+/* Datasheet appendix B maximum measurement time. */
+static uint32_t bme280_measure_time_us(const sim_bme280_t *dev)
+{
+    uint8_t ctrl_meas = dev->regs[REG_CTRL_MEAS];
+    uint32_t t = oversampling_count(ctrl_meas >> 5);
+    uint32_t p = oversampling_count((ctrl_meas >> 2) & 0x07);
+    uint32_t h = oversampling_count(dev->regs[REG_CTRL_HUM] & 0x07);
+    uint32_t us = 1250 + 2300 * t;
+    if (p) {
+        us += 2300 * p + 575;
+    }
+    if (h) {
+        us += 2300 * h + 575;
+    }
+    return us;
+}
+
+static void bme280_update(sim_bme280_t *dev)
+{
+    if (dev->measurement_pending && sim_time_us() >= dev->measure_end) {
+        bme280_latch_measurement(dev);
+        dev->measurement_pending = false;
+        dev->regs[REG_STATUS] &= ~STATUS_MEASURING;
+        if ((dev->regs[REG_CTRL_MEAS] & 0x03) != 0x03) {
+            dev->regs[REG_CTRL_MEAS] &= ~0x03; // forced mode returns to sleep
+        }
+    }
+}
+
+static void bme280_write_reg(sim_bme280_t *dev, uint8_t reg, uint8_t value)
+{
+    if (reg == REG_CTRL_MEAS || reg == REG_CTRL_HUM || reg == REG_CONFIG) {
+        dev->regs[reg] = value;
+    }
+    if (reg == REG_CTRL_MEAS && (value & 0x03) != 0) {
+        dev->measure_end = sim_time_us() + bme280_measure_time_us(dev);
+        dev->measurement_pending = true;
+        dev->regs[REG_STATUS] |= STATUS_MEASURING;
+    }
+}
+
+static uint8_t bme280_read_reg(sim_bme280_t *dev, uint8_t reg)
+{
+    if (reg >= REG_STATUS && reg <= REG_DATA_END) {
+        bme280_update(dev);
+        if (reg >= REG_DATA && (dev->regs[REG_CTRL_MEAS] & 0x03) == 0x03 && !dev->measurement_pending) {
+            bme280_latch_measurement(dev); // normal mode: data follows the environment
+        }
+    }
+    return dev->regs[reg];
+}
+
+static void put16(uint8_t *r, int reg, uint16_t v)
+{
+    r[reg] = v & 0xFF;
+    r[reg + 1] = v >> 8;
+}
+
+bool sim_bme280_attach(uint8_t address, uint8_t chip_id)
+{
+    for (int i = 0; i < SIM_I2C_MAX_DEVICES; i++) {
+        sim_bme280_t *dev = &s_devices[i];
+        if (dev->present) {
+            continue;
+        }
+        memset(dev, 0, sizeof(*dev));
+        dev->present = true;
+        dev->address = address;
+
+        uint8_t *r = dev->regs;
+        const sim_calib_t *c = &s_calib;
+        r[REG_CHIP_ID] = chip_id;
+        put16(r, 0x88, c->T1);
+        put16(r, 0x8A, c->T2);
+        put16(r, 0x8C, c->T3);
+        put16(r, 0x8E, c->P1);
+        put16(r, 0x90, c->P2);
+        put16(r, 0x92, c->P3);
+        put16(r, 0x94, c->P4);
+        put16(r, 0x96, c->P5);
+        put16(r, 0x98, c->P6);
+        put16(r, 0x9A, c->P7);
+        put16(r, 0x9C, c->P8);
+        put16(r, 0x9E, c->P9);
+        r[REG_CALIB_H1] = c->H1;
+        put16(r, REG_CALIB_26, c->H2);
+        r[0xE3] = c->H3;
+        r[0xE4] = c->H4 >> 4;
+        r[0xE5] = (c->H4 & 0x0F) | ((c->H5 & 0x0F) << 4);
+        r[0xE6] = c->H5 >> 4;
+        r[0xE7] = c->H6;
+        bme280_latch_measurement(dev);
+        return true;
+    }
+    return false;
+}
+
+static sim_bme280_t *find_device(uint8_t address)
+{
+    for (int i = 0; i < SIM_I2C_MAX_DEVICES; i++) {
+        if (s_devices[i].present && s_devices[i].address == address) {
+            return &s_devices[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode)
+{
+    if (i2c_num >= I2C_NUM_MAX || mode != I2C_MODE_MASTER) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_driver_installed) {
+        return ESP_FAIL;
+    }
+    s_driver_installed = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    if (i2c_num >= I2C_NUM_MAX || !s_driver_installed) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_driver_installed = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    return (i2c_num < I2C_NUM_MAX && i2c_conf) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    sim_stats()->i2c_cmd_links++;
+    return calloc(1, sizeof(cmd_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    cmd_link_t *cmd = cmd_handle;
+    if (cmd) {
+        free(cmd->ops);
+        free(cmd);
+    }
+}
+
+static esp_err_t push_op(i2c_cmd_handle_t cmd_handle, op_t op)
+{
+    cmd_link_t *cmd = cmd_handle;
+    if (!cmd) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cmd->count == cmd->capacity) {
+        size_t capacity = cmd->capacity ? cmd->capacity * 2 : 16;
+        op_t *ops = realloc(cmd->ops, capacity * sizeof(op_t));
+        if (!ops) {
+            return ESP_ERR_NO_MEM;
+        }
+        cmd->ops = ops;
+        cmd->capacity = capacity;
+    }
+    cmd->ops[cmd->count++] = op;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return push_op(cmd_handle, (op_t){ .type = OP_START });
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return push_op(cmd_handle, (op_t){ .type = OP_STOP });
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    return push_op(cmd_handle, (op_t){ .type = OP_WRITE, .byte = data });
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, bool ack_en)
+{
+    for (size_t i = 0; i < data_len; i++) {
+        esp_err_t err = push_op(cmd_handle, (op_t){ .type = OP_WRITE, .byte = data[i] });
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return push_op(cmd_handle, (op_t){ .type = OP_READ, .dest = data });
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    for (size_t i = 0; i < data_len; i++) {
+        esp_err_t err = push_op(cmd_handle, (op_t){ .type = OP_READ, .dest = &data[i] });
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    cmd_link_t *cmd = cmd_handle;
+    if (i2c_num >= I2C_NUM_MAX || !s_driver_installed || !cmd) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim_stats_t *stats = sim_stats();
+    sim_bme280_t *dev = NULL;
+    bool expect_address = false;
+    bool expect_reg = false;
+    uint32_t bits = 0;
+    esp_err_t err = ESP_OK;
+
+    stats->i2c_transactions++;
+    for (size_t i = 0; i < cmd->count && err == ESP_OK; i++) {
+        const op_t *op = &cmd->ops[i];
+        switch (op->type) {
+            case OP_START:
+                bits += 1;
+                expect_address = true;
+                break;
+            case OP_STOP:
+                bits += 1;
+                break;
+            case OP_WRITE:
+                bits += 9;
+                stats->i2c_bytes++;
+                if (expect_address) {
+                    expect_address = false;
+                    dev = find_device(op->byte >> 1);
+                    expect_reg = (op->byte & 1) == I2C_MASTER_WRITE;
+                    if (!dev) {
+                        err = ESP_FAIL; // address NACK
+                    }
+                } else if (!dev) {
+                    err = ESP_FAIL;
+                } else if (expect_reg) {
+                    dev->reg_ptr = op->byte;
+                    expect_reg = false;
+                } else {
+                    // BME280 writes are (register, value) pairs, no auto-increment.
+                    bme280_write_reg(dev, dev->reg_ptr, op->byte);
+                    expect_reg = true;
+                }
+                break;
+            case OP_READ:
+                bits += 9;
+                stats->i2c_bytes++;
+                if (!dev) {
+                    err = ESP_FAIL;
+                } else {
+                    *op->dest = bme280_read_reg(dev, dev->reg_ptr++);
+                }
+                break;
+        }
+    }
+
+    uint64_t bus_us = (uint64_t)bits * SIM_I2C_BIT_US;
+    stats->i2c_bus_us += bus_us;
+    sim_busy_wait_us(bus_us);
+    return err;
+}
@@ -0,0 +1,808 @@
+/*
+ * Event loop, Wi-Fi and MQTT client stand-ins.
+ *
+ * Wi-Fi connects in the background and posts IP_EVENT_STA_GOT_IP: a station
+ * configured with the access point's BSSID and channel associates directly,
+ * otherwise every channel is scanned first. A configured BSSID or channel
+ * the access point is not on gives WIFI_EVENT_STA_DISCONNECTED with
+ * WIFI_REASON_NO_AP_FOUND after probing that channel.
+ *
+ * The MQTT client connects once the station has an address and accounts
+ * every publish as it would appear on the wire: MQTT fixed header, topic,
+ * packet identifier and payload, one TCP/IP segment per packet, plus the
+ * PUBACK segment for QoS 1, which is delivered as MQTT_EVENT_PUBLISHED one
+ * round trip later. The first publish after each boot is timed from the boot.
+ * Unacknowledged QoS 1 messages are kept in the outbox, as esp-mqtt does:
+ * the firmware's pool with CONFIG_MQTT_CUSTOM_OUTBOX, otherwise a heap copy
+ * of each like the library's own outbox. Their PUBACK comes once the broker
+ * is reachable again, or never if it stays away OUTBOX_EXPIRED_TIMEOUT_MS.
+ *
+ * HOST_MQTT_OUTAGE=start:end  broker unreachable from start to end simulated
+ *                             seconds: DISCONNECTED at start, CONNECTED at end
+ * HOST_WIFI_AP_MOVE=seconds   the access point moves to another channel then
+ * HOST_MQTT_PUBLISH_STALL=ms  every publish call blocks that long, as with a
+ *                             congested link and a full TCP send buffer
+ * HOST_MQTT_ACK_DELAY=ms      PUBACKs come that long after the publish instead of
+ *                             one round trip, as from a slow broker
+ * HOST_MQTT_RECEIVE=seconds:topic:hex[,...]
+ *                             messages the broker sends at those simulated seconds
+ *                             on a subscribed topic, payloads in hex. The last one
+ *                             already due when the topic is subscribed is sent
+ *                             right after the SUBACK, as a retained message is
+ * HOST_SNTP=unix[:seconds]|off
+ *                             Unix time at simulated time 0 (default 1767225600,
+ *                             2026-01-01), the server answering from those
+ *                             simulated seconds on; or no SNTP server
+ *
+ * SNTP answers one round trip after sntp_init, once the station has an
+ * address, and sets the system time: time(), wrapped in the simulated
+ * firmware, then reads HOST_SNTP plus the simulated time instead of the
+ * seconds since boot. Like the chip, the system time is lost in deep sleep.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "mqtt_client.h"
+#include "mqtt_outbox.h"
+#include "lwip/apps/sntp.h"
+#include "sdkconfig.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "host_sim.h"
+
+#define SIM_MAX_EVENT_HANDLERS 16
+#define SIM_TCPIP_OVERHEAD 40
+#define SIM_PUBACK_BYTES 4
+#define SIM_MQTT_CONNECT_DELAY_MS 200 // TCP handshake, CONNECT and CONNACK
+#define SIM_MQTT_RTT_MS 40
+// esp-mqtt
+#define MQTT_MSG_TYPE_PUBLISH 3
+#define OUTBOX_EXPIRED_TIMEOUT_MS (30 * 1000)
+#define SIM_WIFI_CHANNELS 13
+#define SIM_WIFI_SCAN_MS_PER_CHANNEL 120
+#define SIM_WIFI_ASSOC_MS 100 // authentication, association and 4-way handshake
+#define SIM_WIFI_DHCP_MS 250
+#define SIM_WIFI_AP_CHANNEL 6
+#define SIM_WIFI_AP_MOVED_CHANNEL 11
+#define SIM_MQTT_SUBSCRIPTIONS 4
+#define SIM_MQTT_TOPIC_MAX 128
+#define SIM_MQTT_RECEIVE_MAX 256 // payload bytes of a HOST_MQTT_RECEIVE message
+#define SIM_SNTP_RTT_MS 40
+#define SIM_SNTP_DEFAULT_EPOCH 1767225600ULL
+
+esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t IP_EVENT = "IP_EVENT";
+static esp_event_base_t MQTT_EVENTS = "MQTT_EVENTS";
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_entry_t;
+
+struct esp_mqtt_client
+{
+    esp_mqtt_client_config_t config;
+    esp_event_handler_t handler;
+    void *handler_arg;
+    bool connected;
+    int next_msg_id;
+    QueueHandle_t acks;
+    outbox_handle_t outbox;
+    pthread_mutex_t lock;
+    char subscriptions[SIM_MQTT_SUBSCRIPTIONS][SIM_MQTT_TOPIC_MAX];
+    int subscription_count;
+};
+
+typedef struct
+{
+    esp_mqtt_client_handle_t client;
+    char topic[SIM_MQTT_TOPIC_MAX];
+    bool resubscribed;          //!< the later messages are already on their way
+} mqtt_receive_t;
+
+typedef struct
+{
+    int msg_id;
+    uint64_t sent_us;
+} mqtt_ack_t;
+
+static handler_entry_t s_handlers[SIM_MAX_EVENT_HANDLERS];
+static pthread_mutex_t s_handlers_lock = PTHREAD_MUTEX_INITIALIZER;
+static const uint8_t s_ap_bssid[6] = { 0x02, 0x00, 0x5E, 0x10, 0x20, 0x30 };
+static wifi_sta_config_t s_sta_config;
+static volatile bool s_wifi_has_ip;
+static bool s_published_since_boot;
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    pthread_mutex_lock(&s_handlers_lock);
+    for (int i = 0; i < SIM_MAX_EVENT_HANDLERS; i++) {
+        if (!s_handlers[i].handler) {
+            s_handlers[i] = (handler_entry_t){ event_base, event_id, event_handler, event_handler_arg };
+            pthread_mutex_unlock(&s_handlers_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_handlers_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler)
+{
+    pthread_mutex_lock(&s_handlers_lock);
+    for (int i = 0; i < SIM_MAX_EVENT_HANDLERS; i++) {
+        if (s_handlers[i].handler == event_handler && s_handlers[i].base == event_base &&
+            s_handlers[i].id == event_id) {
+            memset(&s_handlers[i], 0, sizeof(s_handlers[i]));
+        }
+    }
+    pthread_mutex_unlock(&s_handlers_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
+                         void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    handler_entry_t matched[SIM_MAX_EVENT_HANDLERS];
+    int count = 0;
+
+    pthread_mutex_lock(&s_handlers_lock);
+    for (int i = 0; i < SIM_MAX_EVENT_HANDLERS; i++) {
+        const handler_entry_t *h = &s_handlers[i];
+        if (h->handler && (h->base == ESP_EVENT_ANY_BASE || h->base == event_base) &&
+            (h->id == ESP_EVENT_ANY_ID || h->id == event_id)) {
+            matched[count++] = *h;
+        }
+    }
+    pthread_mutex_unlock(&s_handlers_lock);
+
+    for (int i = 0; i < count; i++) {
+        matched[i].handler(matched[i].arg, event_base, event_id, event_data);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    if (!conf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_sta_config = conf->sta;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol_bitmap)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    s_wifi_has_ip = false;
+    return ESP_OK;
+}
+
+static uint8_t wifi_ap_channel(void)
+{
+    const char *move = getenv("HOST_WIFI_AP_MOVE");
+    if (move && sim_time_us() >= (uint64_t)(atof(move) * 1e6)) {
+        return SIM_WIFI_AP_MOVED_CHANNEL;
+    }
+    return SIM_WIFI_AP_CHANNEL;
+}
+
+static void wifi_connect_task(void *arg)
+{
+    wifi_sta_config_t config = s_sta_config;
+
+    if (!sim_rf_enabled()) {
+        // Radio off for this wake: no association, no event, the firmware times out
+        sim_stats()->wifi_rf_off++;
+        vTaskDelete(NULL);
+        return;
+    }
+    if (config.bssid_set && config.channel) {
+        if (config.channel != wifi_ap_channel() || memcmp(config.bssid, s_ap_bssid, sizeof(s_ap_bssid)) != 0) {
+            vTaskDelay(pdMS_TO_TICKS(SIM_WIFI_SCAN_MS_PER_CHANNEL));
+            system_event_sta_disconnected_t event = { .reason = WIFI_REASON_NO_AP_FOUND };
+            memcpy(event.bssid, config.bssid, sizeof(event.bssid));
+            esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), 0);
+            vTaskDelete(NULL);
+            return;
+        }
+        sim_stats()->wifi_direct_connects++;
+    } else {
+        vTaskDelay(pdMS_TO_TICKS(SIM_WIFI_CHANNELS * SIM_WIFI_SCAN_MS_PER_CHANNEL));
+        sim_stats()->wifi_scans++;
+    }
+    vTaskDelay(pdMS_TO_TICKS(SIM_WIFI_ASSOC_MS + SIM_WIFI_DHCP_MS));
+
+    ip_event_got_ip_t event = { 0 };
+    event.ip_info.ip.addr = 0x0204A8C0; // 192.168.4.2
+    event.ip_info.netmask.addr = 0x00FFFFFF;
+    event.ip_info.gw.addr = 0x0104A8C0;
+    s_wifi_has_ip = true;
+    esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    return xTaskCreate(wifi_connect_task, "wifi_connect", 2048, NULL, 5, NULL) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    s_wifi_has_ip = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!s_wifi_has_ip) {
+        return ESP_FAIL;
+    }
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->bssid, s_ap_bssid, sizeof(s_ap_bssid));
+    strcpy((char *)ap_info->ssid, "host-sim");
+    ap_info->primary = wifi_ap_channel();
+    ap_info->rssi = -55;
+    return ESP_OK;
+}
+
+#ifndef CONFIG_MQTT_CUSTOM_OUTBOX
+/* esp-mqtt's own outbox, only what the client stand-in uses: a heap entry and copy per message. */
+struct outbox_item
+{
+    struct outbox_item *next;
+    uint8_t *buffer;
+    int msg_id;
+    int msg_type;
+    int tick;
+};
+
+struct outbox_list_t
+{
+    struct outbox_item *head;
+};
+
+outbox_handle_t outbox_init(void)
+{
+    return calloc(1, sizeof(struct outbox_list_t));
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, int tick)
+{
+    struct outbox_item *item = calloc(1, sizeof(*item));
+    if (!item) {
+        return NULL;
+    }
+    item->buffer = malloc(message->len + message->remaining_len);
+    if (!item->buffer) {
+        free(item);
+        return NULL;
+    }
+    memcpy(item->buffer, message->data, message->len);
+    memcpy(item->buffer + message->len, message->remaining_data, message->remaining_len);
+    item->msg_id = message->msg_id;
+    item->msg_type = message->msg_type;
+    item->tick = tick;
+    item->next = outbox->head;
+    outbox->head = item;
+    return item;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+    return ESP_OK;
+}
+
+static int outbox_remove(outbox_handle_t outbox, bool (*match)(struct outbox_item *, int, int), int a, int b)
+{
+    int removed = 0;
+    for (struct outbox_item **p = &outbox->head; *p;) {
+        struct outbox_item *item = *p;
+        if (match(item, a, b)) {
+            *p = item->next;
+            free(item->buffer);
+            free(item);
+            removed++;
+        } else {
+            p = &item->next;
+        }
+    }
+    return removed;
+}
+
+static bool outbox_match_id(struct outbox_item *item, int msg_id, int msg_type)
+{
+    return item->msg_id == msg_id && item->msg_type == msg_type;
+}
+
+static bool outbox_match_expired(struct outbox_item *item, int current_tick, int timeout)
+{
+    return current_tick - item->tick > timeout;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
+{
+    return outbox_remove(outbox, outbox_match_id, msg_id, msg_type) ? ESP_OK : ESP_FAIL;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, int current_tick, int timeout)
+{
+    return outbox_remove(outbox, outbox_match_expired, current_tick, timeout);
+}
+#endif
+
+static int mqtt_tick_ms(void)
+{
+    return (int)((sim_time_us() - sim_boot_time_us()) / 1000);
+}
+
+static void mqtt_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_t *event)
+{
+    event->client = client;
+    event->user_context = client->config.user_context;
+    if (client->handler) {
+        client->handler(client->handler_arg, MQTT_EVENTS, event->event_id, event);
+    }
+}
+
+static void mqtt_set_connected(esp_mqtt_client_handle_t client, bool connected)
+{
+    pthread_mutex_lock(&client->lock);
+    client->connected = connected;
+    pthread_mutex_unlock(&client->lock);
+
+    esp_mqtt_event_t event = { .event_id = connected ? MQTT_EVENT_CONNECTED : MQTT_EVENT_DISCONNECTED };
+    mqtt_dispatch(client, &event);
+}
+
+static void mqtt_sleep_until(double seconds)
+{
+    uint64_t at = (uint64_t)(seconds * 1e6);
+    uint64_t now = sim_time_us();
+    if (at > now) {
+        sim_sleep_us(at - now);
+    }
+}
+
+static void mqtt_connect_task(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+    const char *outage = getenv("HOST_MQTT_OUTAGE");
+    double start, end;
+    bool scripted = outage && sscanf(outage, "%lf:%lf", &start, &end) == 2 && end > start;
+
+    while (!s_wifi_has_ip) {
+        vTaskDelay(1);
+    }
+    vTaskDelay(pdMS_TO_TICKS(SIM_MQTT_CONNECT_DELAY_MS));
+    double now = sim_time_us() / 1e6;
+    if (scripted && now >= start && now < end) {
+        // Connecting during the outage, e.g. after a deep sleep: wait for the broker
+        mqtt_sleep_until(end);
+    }
+    mqtt_set_connected(client, true);
+
+    if (scripted && now < start) {
+        mqtt_sleep_until(start);
+        sim_stats()->mqtt_disconnects++;
+        mqtt_set_connected(client, false);
+        mqtt_sleep_until(end);
+        mqtt_set_connected(client, true);
+    }
+    vTaskDelete(NULL);
+}
+
+/*
+ * Delivers MQTT_EVENT_PUBLISHED for QoS 1 messages, one round trip (or HOST_MQTT_ACK_DELAY) after
+ * they were sent, or after the reconnection that resends them; drops them from the outbox once acknowledged or
+ * expired.
+ */
+static void mqtt_ack_task(void *arg)
+{
+    esp_mqtt_client_handle_t client = arg;
+    const char *delay = getenv("HOST_MQTT_ACK_DELAY");
+    uint64_t ack_us = (delay ? strtoull(delay, NULL, 0) : SIM_MQTT_RTT_MS) * 1000;
+    mqtt_ack_t ack;
+
+    while (xQueueReceive(client->acks, &ack, portMAX_DELAY) == pdTRUE) {
+        uint64_t expires_us = ack.sent_us + OUTBOX_EXPIRED_TIMEOUT_MS * 1000ULL;
+        mqtt_sleep_until((ack.sent_us + ack_us) / 1e6);
+        while (1) {
+            pthread_mutex_lock(&client->lock);
+            bool connected = client->connected;
+            pthread_mutex_unlock(&client->lock);
+            if (connected || sim_time_us() >= expires_us) {
+                break;
+            }
+            vTaskDelay(1);
+        }
+
+        pthread_mutex_lock(&client->lock);
+        bool acked = client->connected && outbox_delete(client->outbox, ack.msg_id, MQTT_MSG_TYPE_PUBLISH) == ESP_OK;
+        outbox_delete_expired(client->outbox, mqtt_tick_ms(), OUTBOX_EXPIRED_TIMEOUT_MS);
+        pthread_mutex_unlock(&client->lock);
+        if (acked) {
+            esp_mqtt_event_t event = { .event_id = MQTT_EVENT_PUBLISHED, .msg_id = ack.msg_id };
+            mqtt_dispatch(client, &event);
+        }
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    client->config = *config;
+    client->next_msg_id = 1;
+    client->acks = xQueueCreate(32, sizeof(mqtt_ack_t));
+    client->outbox = outbox_init();
+    pthread_mutex_init(&client->lock, NULL);
+    if (!client->acks || !client->outbox || xTaskCreate(mqtt_ack_task, "mqtt_ack", 2048, client, 5, NULL) != pdPASS) {
+        free(client);
+        return NULL;
+    }
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return xTaskCreate(mqtt_connect_task, "mqtt_task", 6144, client, 5, NULL) == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    pthread_mutex_lock(&client->lock);
+    client->connected = false;
+    pthread_mutex_unlock(&client->lock);
+    return ESP_OK;
+}
+
+/* Next HOST_MQTT_RECEIVE entry from *cursor: false at the end of the list. */
+static bool mqtt_receive_next(const char **cursor, double *at, char *topic, uint8_t *payload, int *len)
+{
+    const char *p = *cursor;
+    char *end;
+
+    while (*p) {
+        const char *entry = p;
+        p += strcspn(p, ",");
+        *cursor = *p ? p + 1 : p;
+        *at = strtod(entry, &end);
+        const char *t = end + 1;
+        const char *hex = *end == ':' ? memchr(t, ':', p - t) : NULL;
+        if (!hex || hex - t >= SIM_MQTT_TOPIC_MAX) {
+            fprintf(stderr, "HOST_MQTT_RECEIVE: malformed entry\n");
+            p = *cursor;
+            continue;
+        }
+        memcpy(topic, t, hex - t);
+        topic[hex - t] = '\0';
+        *len = 0;
+        for (hex++; hex + 1 < p && *len < SIM_MQTT_RECEIVE_MAX; hex += 2) {
+            unsigned byte;
+            if (sscanf(hex, "%2x", &byte) != 1) {
+                break;
+            }
+            payload[(*len)++] = byte;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void mqtt_receive_dispatch(esp_mqtt_client_handle_t client, char *topic, uint8_t *payload, int len)
+{
+    pthread_mutex_lock(&client->lock);
+    bool connected = client->connected;
+    pthread_mutex_unlock(&client->lock);
+    if (!connected) {
+        return;
+    }
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DATA, .topic = topic, .topic_len = (int)strlen(topic),
+        .data = (char *)payload, .data_len = len, .total_data_len = len,
+    };
+    mqtt_dispatch(client, &event);
+}
+
+/* The HOST_MQTT_RECEIVE messages of one subscription, from the MQTT task as esp-mqtt does. */
+static void mqtt_receive_task(void *arg)
+{
+    mqtt_receive_t *receive = arg;
+    const char *script = getenv("HOST_MQTT_RECEIVE");
+    const char *cursor = script ? script : "";
+    char topic[SIM_MQTT_TOPIC_MAX];
+    uint8_t payload[SIM_MQTT_RECEIVE_MAX], retained[SIM_MQTT_RECEIVE_MAX];
+    int len, retained_len = -1;
+    double at;
+
+    vTaskDelay(pdMS_TO_TICKS(SIM_MQTT_RTT_MS));
+    double now = sim_time_us() / 1e6;
+    while (mqtt_receive_next(&cursor, &at, topic, payload, &len)) {
+        if (strcmp(topic, receive->topic) != 0) {
+            continue;
+        }
+        if (at <= now) {
+            memcpy(retained, payload, len);
+            retained_len = len;
+            continue;
+        }
+        if (retained_len >= 0) {
+            mqtt_receive_dispatch(receive->client, receive->topic, retained, retained_len);
+            retained_len = -1;
+        }
+        if (receive->resubscribed) {
+            break;
+        }
+        mqtt_sleep_until(at);
+        mqtt_receive_dispatch(receive->client, receive->topic, payload, len);
+    }
+    if (retained_len >= 0) {
+        mqtt_receive_dispatch(receive->client, receive->topic, retained, retained_len);
+    }
+    free(receive);
+    vTaskDelete(NULL);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    mqtt_receive_t *receive = calloc(1, sizeof(*receive));
+    if (!receive || strlen(topic) >= SIM_MQTT_TOPIC_MAX) {
+        free(receive);
+        return -1;
+    }
+    receive->client = client;
+    strcpy(receive->topic, topic);
+
+    pthread_mutex_lock(&client->lock);
+    if (!client->connected) {
+        pthread_mutex_unlock(&client->lock);
+        free(receive);
+        return -1;
+    }
+    int msg_id = client->next_msg_id++;
+    for (int i = 0; i < client->subscription_count; i++) {
+        receive->resubscribed |= strcmp(client->subscriptions[i], topic) == 0;
+    }
+    if (!receive->resubscribed && client->subscription_count < SIM_MQTT_SUBSCRIPTIONS) {
+        strcpy(client->subscriptions[client->subscription_count++], topic);
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_SUBSCRIBED, .msg_id = msg_id };
+    mqtt_dispatch(client, &event);
+    if (xTaskCreate(mqtt_receive_task, "mqtt_receive", 2048, receive, 5, NULL) != pdPASS) {
+        free(receive);
+    }
+    return msg_id;
+}
+
+static uint32_t mqtt_remaining_length_bytes(uint32_t remaining)
+{
+    uint32_t bytes = 1;
+    while (remaining >= 128) {
+        remaining /= 128;
+        bytes++;
+    }
+    return bytes;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain)
+{
+    if (!client || !topic) {
+        return -1;
+    }
+    if (len <= 0) {
+        len = data ? (int)strlen(data) : 0;
+    }
+    const char *stall = getenv("HOST_MQTT_PUBLISH_STALL");
+    if (stall) {
+        sim_sleep_us(strtoull(stall, NULL, 0) * 1000);
+    }
+
+    pthread_mutex_lock(&client->lock);
+    if (!client->connected) {
+        pthread_mutex_unlock(&client->lock);
+        return -1;
+    }
+    int msg_id = qos > 0 ? client->next_msg_id++ : 0;
+
+    uint32_t remaining = 2 + strlen(topic) + (qos > 0 ? 2 : 0) + len;
+    uint32_t wire = 1 + mqtt_remaining_length_bytes(remaining) + remaining + SIM_TCPIP_OVERHEAD;
+    if (qos > 0) {
+        wire += SIM_PUBACK_BYTES + SIM_TCPIP_OVERHEAD;
+
+        // Kept until the PUBACK as encoded, the payload after the header part
+        uint8_t header[1 + 4 + 2 + 256 + 2];
+        size_t topic_len = strlen(topic) < 256 ? strlen(topic) : 256;
+        size_t n = 0;
+        header[n++] = 0x32; // PUBLISH, QoS 1
+        uint32_t r = remaining;
+        do {
+            header[n++] = (r % 128) | (r >= 128 ? 0x80 : 0);
+            r /= 128;
+        } while (r > 0);
+        header[n++] = topic_len >> 8;
+        header[n++] = topic_len & 0xFF;
+        memcpy(&header[n], topic, topic_len);
+        n += topic_len;
+        header[n++] = msg_id >> 8;
+        header[n++] = msg_id & 0xFF;
+        outbox_message_t message = {
+            .data = header, .len = (int)n, .msg_id = msg_id, .msg_qos = qos, .msg_type = MQTT_MSG_TYPE_PUBLISH,
+            .remaining_data = (uint8_t *)data, .remaining_len = len,
+        };
+        outbox_enqueue(client->outbox, &message, mqtt_tick_ms());
+        outbox_set_pending(client->outbox, msg_id, TRANSMITTED);
+    }
+
+    if (getenv("HOST_MQTT_DUMP")) {
+        printf("mqtt> %s ", topic);
+        for (int i = 0; i < len; i++) {
+            printf("%02x", (uint8_t)data[i]);
+        }
+        printf("\n");
+    }
+
+    sim_stats_t *stats = sim_stats();
+    stats->mqtt_publishes++;
+    stats->mqtt_payload_bytes += len;
+    stats->mqtt_wire_bytes += wire;
+    if (!s_published_since_boot) {
+        uint64_t latency = sim_time_us() - sim_boot_time_us();
+        s_published_since_boot = true;
+        stats->boot_publishes++;
+        stats->boot_to_publish_us += latency;
+        if (latency > stats->boot_to_publish_max_us) {
+            stats->boot_to_publish_max_us = latency;
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    if (qos > 0) {
+        mqtt_ack_t ack = { msg_id, sim_time_us() };
+        xQueueSend(client->acks, &ack, 0);
+    }
+    return msg_id;
+}
+
+static volatile bool s_sntp_enabled;
+static volatile bool s_sntp_synced;
+
+/* Unix time at simulated time 0, 0 without a server; from when the server answers. */
+static uint64_t sntp_epoch(double *from)
+{
+    const char *sntp = getenv("HOST_SNTP");
+    char *end;
+
+    *from = 0;
+    if (!sntp) {
+        return SIM_SNTP_DEFAULT_EPOCH;
+    }
+    if (strcmp(sntp, "off") == 0) {
+        return 0;
+    }
+    uint64_t epoch = strtoull(sntp, &end, 0);
+    if (*end == ':') {
+        *from = atof(end + 1);
+    }
+    return epoch;
+}
+
+static void sntp_task(void *arg)
+{
+    double from;
+    uint64_t epoch = sntp_epoch(&from);
+
+    while (s_sntp_enabled && (!s_wifi_has_ip || sim_time_us() < from * 1e6)) {
+        vTaskDelay(1);
+    }
+    vTaskDelay(pdMS_TO_TICKS(SIM_SNTP_RTT_MS));
+    if (s_sntp_enabled && epoch) {
+        s_sntp_synced = true;
+        sim_stats()->sntp_syncs++;
+    }
+    vTaskDelete(NULL);
+}
+
+void sntp_setoperatingmode(uint8_t operating_mode)
+{
+}
+
+void sntp_setservername(uint8_t idx, const char *server)
+{
+}
+
+void sntp_init(void)
+{
+    if (!s_sntp_enabled) {
+        s_sntp_enabled = true;
+        xTaskCreate(sntp_task, "sntp", 2048, NULL, 5, NULL);
+    }
+}
+
+void sntp_stop(void)
+{
+    s_sntp_enabled = false;
+}
+
+uint8_t sntp_enabled(void)
+{
+    return s_sntp_enabled;
+}
+
+time_t __wrap_time(time_t *t);
+
+time_t __wrap_time(time_t *t)
+{
+    uint64_t now_us = sim_time_us();
+    double from;
+    time_t now = s_sntp_synced ? (time_t)(sntp_epoch(&from) + now_us / 1000000)
+                               : (time_t)((now_us - sim_boot_time_us()) / 1000000);
+
+    if (t) {
+        *t = now;
+    }
+    return now;
+}
@@ -0,0 +1,289 @@
+/*
+ * NVS stand-in on the "nvs" partition of the simulated flash.
+ *
+ * Every set or erase appends one record (namespace, key, type, value) to the
+ * partition, so NVS writes show in the flash counters and persist with the
+ * flash image; the last record of a key wins. A full partition is erased and
+ * rewritten with the live entries. The on-flash format is not the SDK's.
+ */
+#include <stdbool.h>
+#include <string.h>
+#include "nvs.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#define SIM_NVS_MAGIC 0x5256534E // "NSVR"
+#define SIM_NVS_NAME_LEN 16      // 15 characters and the terminator, as on the SDK
+#define SIM_NVS_MAX_VALUE 256
+#define SIM_NVS_MAX_ENTRIES 64
+#define SIM_NVS_MAX_HANDLES 8
+
+typedef enum
+{
+    SIM_NVS_ERASED = 0,
+    SIM_NVS_U32,
+    SIM_NVS_BLOB
+} sim_nvs_type_t;
+
+typedef struct
+{
+    uint32_t magic;
+    char ns[SIM_NVS_NAME_LEN];
+    char key[SIM_NVS_NAME_LEN];
+    uint16_t type;
+    uint16_t length;
+} sim_nvs_record_t;
+
+typedef struct
+{
+    char ns[SIM_NVS_NAME_LEN];
+    char key[SIM_NVS_NAME_LEN];
+    sim_nvs_type_t type;
+    uint16_t length;
+    uint8_t value[SIM_NVS_MAX_VALUE];
+} sim_nvs_entry_t;
+
+typedef struct
+{
+    bool open;
+    nvs_open_mode mode;
+    char ns[SIM_NVS_NAME_LEN];
+} sim_nvs_handle_t;
+
+static const esp_partition_t *s_partition;
+static size_t s_write_offset;
+static sim_nvs_entry_t s_entries[SIM_NVS_MAX_ENTRIES];
+static sim_nvs_handle_t s_handles[SIM_NVS_MAX_HANDLES];
+
+static size_t record_size(uint16_t length)
+{
+    return sizeof(sim_nvs_record_t) + ((length + 3u) & ~3u);
+}
+
+static sim_nvs_entry_t *entry_find(const char *ns, const char *key, bool create)
+{
+    sim_nvs_entry_t *free_entry = NULL;
+    for (int i = 0; i < SIM_NVS_MAX_ENTRIES; i++) {
+        sim_nvs_entry_t *e = &s_entries[i];
+        if (e->type == SIM_NVS_ERASED) {
+            if (!free_entry) {
+                free_entry = e;
+            }
+        } else if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    if (create && free_entry) {
+        strcpy(free_entry->ns, ns);
+        strcpy(free_entry->key, key);
+    }
+    return create ? free_entry : NULL;
+}
+
+static esp_err_t record_append(const char *ns, const char *key, sim_nvs_type_t type, const void *value,
+                               uint16_t length)
+{
+    uint8_t buf[sizeof(sim_nvs_record_t) + SIM_NVS_MAX_VALUE];
+    sim_nvs_record_t *record = (sim_nvs_record_t *)buf;
+    size_t size = record_size(length);
+
+    memset(buf, 0xFF, sizeof(buf));
+    record->magic = SIM_NVS_MAGIC;
+    memset(record->ns, 0, SIM_NVS_NAME_LEN);
+    memset(record->key, 0, SIM_NVS_NAME_LEN);
+    strcpy(record->ns, ns);
+    strcpy(record->key, key);
+    record->type = type;
+    record->length = length;
+    if (length) {
+        memcpy(buf + sizeof(*record), value, length);
+    }
+
+    if (s_write_offset + size > s_partition->size) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    esp_err_t err = esp_partition_write(s_partition, s_write_offset, buf, size);
+    if (err == ESP_OK) {
+        s_write_offset += size;
+    }
+    return err;
+}
+
+/* Erase the partition and write the live entries back. */
+static esp_err_t compact(void)
+{
+    esp_err_t err = esp_partition_erase_range(s_partition, 0, s_partition->size);
+    s_write_offset = 0;
+    for (int i = 0; i < SIM_NVS_MAX_ENTRIES && err == ESP_OK; i++) {
+        const sim_nvs_entry_t *e = &s_entries[i];
+        if (e->type != SIM_NVS_ERASED) {
+            err = record_append(e->ns, e->key, e->type, e->value, e->length);
+        }
+    }
+    return err;
+}
+
+static esp_err_t entry_store(nvs_handle handle, const char *key, sim_nvs_type_t type, const void *value,
+                             size_t length)
+{
+    if (handle >= SIM_NVS_MAX_HANDLES || !s_handles[handle].open) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (s_handles[handle].mode != NVS_READWRITE) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (!key || strlen(key) >= SIM_NVS_NAME_LEN) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    if (length > SIM_NVS_MAX_VALUE) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    const char *ns = s_handles[handle].ns;
+    sim_nvs_entry_t *e = entry_find(ns, key, type != SIM_NVS_ERASED);
+    if (!e) {
+        return type == SIM_NVS_ERASED ? ESP_ERR_NVS_NOT_FOUND : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    if (e->type == type && e->length == length && (length == 0 || memcmp(e->value, value, length) == 0)) {
+        return ESP_OK; // unchanged, nothing written
+    }
+
+    esp_err_t err = record_append(ns, key, type, value, length);
+    e->type = type;
+    e->length = length;
+    if (length) {
+        memcpy(e->value, value, length);
+    }
+    if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE) {
+        err = compact();
+    }
+    return err;
+}
+
+static const sim_nvs_entry_t *entry_load(nvs_handle handle, const char *key, sim_nvs_type_t type,
+                                         esp_err_t *err)
+{
+    if (handle >= SIM_NVS_MAX_HANDLES || !s_handles[handle].open) {
+        *err = ESP_ERR_NVS_INVALID_HANDLE;
+        return NULL;
+    }
+    const sim_nvs_entry_t *e = key ? entry_find(s_handles[handle].ns, key, false) : NULL;
+    *err = !e ? ESP_ERR_NVS_NOT_FOUND : e->type != type ? ESP_ERR_NVS_TYPE_MISMATCH : ESP_OK;
+    return *err == ESP_OK ? e : NULL;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    sim_nvs_record_t record;
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+    if (!s_partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(s_entries, 0, sizeof(s_entries));
+    s_write_offset = 0;
+    while (s_write_offset + sizeof(record) <= s_partition->size) {
+        esp_err_t err = esp_partition_read(s_partition, s_write_offset, &record, sizeof(record));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (record.magic != SIM_NVS_MAGIC || record.length > SIM_NVS_MAX_VALUE ||
+            record.ns[SIM_NVS_NAME_LEN - 1] || record.key[SIM_NVS_NAME_LEN - 1]) {
+            break;
+        }
+        sim_nvs_entry_t *e = entry_find(record.ns, record.key, record.type != SIM_NVS_ERASED);
+        if (e) {
+            e->type = record.type;
+            e->length = record.length;
+            esp_partition_read(s_partition, s_write_offset + sizeof(record), e->value, record.length);
+        }
+        s_write_offset += record_size(record.length);
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+    if (!s_partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(s_entries, 0, sizeof(s_entries));
+    s_write_offset = 0;
+    return esp_partition_erase_range(s_partition, 0, s_partition->size);
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle)
+{
+    if (!s_partition) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (!name || strlen(name) >= SIM_NVS_NAME_LEN) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    for (nvs_handle h = 0; h < SIM_NVS_MAX_HANDLES; h++) {
+        if (!s_handles[h].open) {
+            s_handles[h].open = true;
+            s_handles[h].mode = open_mode;
+            strcpy(s_handles[h].ns, name);
+            *out_handle = h;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_set_u32(nvs_handle handle, const char *key, uint32_t value)
+{
+    return entry_store(handle, key, SIM_NVS_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle handle, const char *key, uint32_t *out_value)
+{
+    esp_err_t err;
+    const sim_nvs_entry_t *e = entry_load(handle, key, SIM_NVS_U32, &err);
+    if (e) {
+        memcpy(out_value, e->value, sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length)
+{
+    return entry_store(handle, key, SIM_NVS_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t err;
+    const sim_nvs_entry_t *e = entry_load(handle, key, SIM_NVS_BLOB, &err);
+    if (!e) {
+        return err;
+    }
+    if (!out_value) {
+        *length = e->length;
+        return ESP_OK;
+    }
+    if (*length < e->length) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    *length = e->length;
+    memcpy(out_value, e->value, e->length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key)
+{
+    return entry_store(handle, key, SIM_NVS_ERASED, NULL, 0);
+}
+
+esp_err_t nvs_commit(nvs_handle handle)
+{
+    return handle < SIM_NVS_MAX_HANDLES && s_handles[handle].open ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+void nvs_close(nvs_handle handle)
+{
+    if (handle < SIM_NVS_MAX_HANDLES) {
+        s_handles[handle].open = false;
+    }
+}
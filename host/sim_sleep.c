@@ -0,0 +1,149 @@
+/*
+ * Boot, reset reason and deep sleep stand-ins.
+ *
+ * esp_deep_sleep() saves the RTC_DATA_ATTR variables (section rtc_data), the
+ * wake-up time and the simulation counters to an image file, then executes
+ * the program again: the next boot starts with every other variable reset, as
+ * on the chip, and with the clock resuming at the wake-up time. The run ends
+ * at the first sleep that would wake up after the requested run length.
+ * The RF option set before the sleep applies to the wake: with option 4 the
+ * radio stays off, and Wi-Fi never connects.
+ *
+ * HOST_RTC_IMAGE  RTC memory image file (default host_rtc.bin)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "host_sim.h"
+
+#define SIM_RTC_MAGIC 0x53525443
+#define SIM_RTC_DEFAULT_IMAGE "host_rtc.bin"
+#define SIM_WAKE_ENV "HOST_SIM_DEEP_SLEEP_WAKE"
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t rtc_size;
+    uint64_t wake_time_us;
+    uint8_t rf_option;
+    sim_stats_t stats;
+} sim_rtc_image_t;
+
+// Bounds of the rtc_data section, provided by the linker when the section exists
+extern uint8_t __start_rtc_data[] __attribute__((weak));
+extern uint8_t __stop_rtc_data[] __attribute__((weak));
+
+static char **s_argv;
+static uint64_t s_run_end_us;
+static uint64_t s_boot_time_us;
+static esp_reset_reason_t s_reset_reason = ESP_RST_POWERON;
+static uint8_t s_rf_option;         // for the next wake
+static bool s_rf_enabled = true;    // on this one
+
+static const char *rtc_image_path(void)
+{
+    const char *path = getenv("HOST_RTC_IMAGE");
+    return path ? path : SIM_RTC_DEFAULT_IMAGE;
+}
+
+static size_t rtc_size(void)
+{
+    return __start_rtc_data ? (size_t)(__stop_rtc_data - __start_rtc_data) : 0;
+}
+
+bool sim_boot(char **argv, uint64_t run_end_us)
+{
+    sim_rtc_image_t image;
+
+    s_argv = argv;
+    s_run_end_us = run_end_us;
+    if (!getenv(SIM_WAKE_ENV)) {
+        return false;
+    }
+    unsetenv(SIM_WAKE_ENV);
+
+    FILE *f = fopen(rtc_image_path(), "rb");
+    if (!f) {
+        perror(rtc_image_path());
+        return false;
+    }
+    bool ok = fread(&image, sizeof(image), 1, f) == 1 && image.magic == SIM_RTC_MAGIC &&
+              image.rtc_size == rtc_size() && (rtc_size() == 0 || fread(__start_rtc_data, rtc_size(), 1, f) == 1);
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "%s: not an RTC image of this build\n", rtc_image_path());
+        return false;
+    }
+
+    *sim_stats() = image.stats;
+    sim_stats()->boots++;
+    sim_busy_wait_us(image.wake_time_us);
+    s_boot_time_us = image.wake_time_us;
+    s_reset_reason = ESP_RST_DEEPSLEEP;
+    s_rf_enabled = image.rf_option != 4;
+    return true;
+}
+
+uint64_t sim_boot_time_us(void)
+{
+    return s_boot_time_us;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return s_reset_reason;
+}
+
+bool sim_rf_enabled(void)
+{
+    return s_rf_enabled;
+}
+
+int esp_deep_sleep_set_rf_option(uint8_t option)
+{
+    if (option > 4 || option == 3) {
+        return -1;
+    }
+    s_rf_option = option;
+    return 0;
+}
+
+void esp_deep_sleep(uint64_t time_in_us)
+{
+    sim_stats_t *stats = sim_stats();
+    uint64_t now = sim_time_us();
+    uint64_t wake = now + time_in_us;
+
+    stats->deep_sleeps++;
+    if (wake >= s_run_end_us) {
+        uint64_t rest = s_run_end_us > now ? s_run_end_us - now : 0;
+        stats->asleep_us += rest;
+        sim_busy_wait_us(rest);
+        sim_report();
+        exit(0);
+    }
+    stats->asleep_us += time_in_us;
+
+    sim_rtc_image_t image = {
+        .magic = SIM_RTC_MAGIC,
+        .rtc_size = rtc_size(),
+        .wake_time_us = wake,
+        .rf_option = s_rf_option,
+        .stats = *stats,
+    };
+    FILE *f = fopen(rtc_image_path(), "wb");
+    if (!f || fwrite(&image, sizeof(image), 1, f) != 1 ||
+        (image.rtc_size && fwrite(__start_rtc_data, image.rtc_size, 1, f) != 1) || fclose(f) != 0) {
+        perror(rtc_image_path());
+        exit(1);
+    }
+
+    fflush(NULL);
+    setenv(SIM_WAKE_ENV, "1", 1);
+    execv("/proc/self/exe", s_argv);
+    perror("execv");
+    exit(1);
+}
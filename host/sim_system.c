@@ -0,0 +1,57 @@
+/*
+ * Logging and heap stand-ins.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include "esp_system.h"
+#include "esp_log.h"
+#include "host_sim.h"
+
+#define SIM_HEAP_SIZE 50000
+
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    // Per-tag levels are not modelled; only the wildcard sets the threshold.
+    if (tag && tag[0] == '*' && tag[1] == '\0') {
+        s_log_level = level;
+    }
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)((sim_time_us() - sim_boot_time_us()) / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > s_log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SIM_HEAP_SIZE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return SIM_HEAP_SIZE;
+}
+
+const char *esp_get_idf_version(void)
+{
+    return "host-sim";
+}
+
+void esp_restart(void)
+{
+    sim_report();
+    exit(0);
+}
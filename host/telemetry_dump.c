@@ -0,0 +1,87 @@
+/*
+ * Decodes the diagnostics reports (telemetry.h) of a simulation run with
+ * HOST_MQTT_DUMP set: reads its output, prints one line per report and the
+ * change of each counter since the previous one. Other lines are ignored.
+ *
+ * usage: HOST_MQTT_DUMP=1 node_sensor_host 3600 100 | telemetry_dump [topic]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "telemetry.h"
+
+#define DUMP_DEFAULT_TOPIC "mestrado/iot/aluno/yan/diagnostico"
+#define DUMP_LINE_MAX 4096
+
+static const char *const s_task_names[] = { "sampler", "publisher", "mqtt" };
+
+static size_t parse_hex(const char *hex, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    unsigned byte;
+
+    while (len < size && sscanf(hex, "%2x", &byte) == 1) {
+        buf[len++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return len;
+}
+
+static void print_report(const telemetry_t *t, const telemetry_t *prev)
+{
+    printf("t=%us heap %u (min %u)", t->uptime_s, t->free_heap, t->min_free_heap);
+    for (size_t i = 0; i < t->task_count; i++) {
+        const telemetry_task_t *task = &t->tasks[i];
+        const char *name = task->id < sizeof(s_task_names) / sizeof(s_task_names[0]) ? s_task_names[task->id] : "?";
+        uint32_t busy = task->busy_us;
+        for (size_t j = 0; prev && j < prev->task_count; j++) {
+            if (prev->tasks[j].id == task->id) {
+                busy -= prev->tasks[j].busy_us; // wraps like the counter
+            }
+        }
+        printf(", %s stack %u free busy +%u us", name, task->stack_free, busy);
+    }
+    printf("\n  dht critical %u us, i2c %u us, late %u ms, run %u ms, queue %u ms\n",
+           t->dht_critical_max_us, t->i2c_max_us, t->late_max_ms, t->run_max_ms, t->queue_max_ms);
+    printf("  samples +%u errors +%u filtered +%u dropped +%u, publish latency:",
+           t->samples - (prev ? prev->samples : 0), t->errors - (prev ? prev->errors : 0),
+           t->filtered - (prev ? prev->filtered : 0), t->dropped - (prev ? prev->dropped : 0));
+    uint32_t bound = TELEMETRY_LATENCY_BASE_US;
+    for (size_t i = 0; i < TELEMETRY_LATENCY_BUCKETS; i++, bound <<= 2) {
+        if (t->publish_latency[i]) {
+            if (i < TELEMETRY_LATENCY_BUCKETS - 1) {
+                printf(" <%uus:%u", bound, t->publish_latency[i]);
+            } else {
+                printf(" more:%u", t->publish_latency[i]);
+            }
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *topic = argc > 1 ? argv[1] : DUMP_DEFAULT_TOPIC;
+    static char line[DUMP_LINE_MAX];
+    uint8_t buf[TELEMETRY_MAX_SIZE];
+    telemetry_t reports[2];
+    size_t count = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        char *p = line;
+        size_t topic_len = strlen(topic);
+        if (strncmp(p, "mqtt> ", 6) != 0 || strncmp(p + 6, topic, topic_len) != 0 || p[6 + topic_len] != ' ') {
+            continue;
+        }
+        size_t len = parse_hex(p + 7 + topic_len, buf, sizeof(buf));
+        telemetry_t *t = &reports[count % 2];
+        if (!telemetry_decode(buf, len, t)) {
+            printf("malformed report, %zu bytes\n", len);
+            continue;
+        }
+        print_report(t, count ? &reports[(count + 1) % 2] : NULL);
+        count++;
+    }
+    printf("%zu reports\n", count);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Converts trace dumps (main/trace.h) into Chrome trace JSON, for
+ * chrome://tracing or ui.perfetto.dev, and prints the time spent per event
+ * on stderr.
+ *
+ * Dumps are read from stdin as the firmware emits them: "trace> <hex>" lines
+ * from the console, or "mqtt> <topic> <hex>" lines of a HOST_MQTT_DUMP run.
+ * Successive dumps continue one timeline. CCOUNT wraps every 2^32 cycles:
+ * consecutive entries more than 2^32 cycles apart (53 s at 80 MHz) are
+ * placed one wrap too early.
+ *
+ * usage: trace_to_chrome [topic] < console.log > trace.json
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+#define CONVERT_DEFAULT_TOPIC "mestrado/iot/aluno/yan/trace"
+#define CONVERT_LINE_MAX (TRACE_DUMP_MAX_SIZE * 2 + 256)
+#define CONVERT_TRACKS_MAX 8
+// An entry may carry an earlier CCOUNT than the one before it: an ISR recorded in between
+#define CONVERT_REORDER_CYCLES 80000
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    uint64_t begin;
+    int open;
+} event_stats_t;
+
+static const char *s_tracks[CONVERT_TRACKS_MAX];
+static size_t s_track_count;
+static event_stats_t s_stats[TRACE_EVENT_COUNT];
+static bool s_first_event = true;
+
+static size_t parse_hex(const char *hex, uint8_t *buf, size_t size)
+{
+    size_t len = 0;
+    unsigned byte;
+
+    while (len < size && sscanf(hex, "%2x", &byte) == 1) {
+        buf[len++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return len;
+}
+
+static int track_id(const char *track)
+{
+    for (size_t i = 0; i < s_track_count; i++) {
+        if (strcmp(s_tracks[i], track) == 0) {
+            return (int)i + 1;
+        }
+    }
+    if (s_track_count == CONVERT_TRACKS_MAX) {
+        return CONVERT_TRACKS_MAX;
+    }
+    s_tracks[s_track_count++] = track;
+    return (int)s_track_count;
+}
+
+static void emit(const char *name, char phase, double ts_us, int tid)
+{
+    printf("%s\n    {\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d%s}",
+           s_first_event ? "" : ",", name, phase, ts_us, tid, phase == 'I' ? ", \"s\": \"t\"" : "");
+    s_first_event = false;
+}
+
+static void account(uint8_t event, uint8_t phase, uint64_t cycles)
+{
+    event_stats_t *st = &s_stats[event];
+
+    if (phase == 'B') {
+        st->begin = cycles;
+        st->open = 1;
+    } else if (phase == 'E' && st->open) {
+        uint64_t d = cycles - st->begin;
+        st->count++;
+        st->total_cycles += d;
+        st->max_cycles = d > st->max_cycles ? d : st->max_cycles;
+        st->open = 0;
+    } else if (phase == 'I') {
+        st->count++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *topic = argc > 1 ? argv[1] : CONVERT_DEFAULT_TOPIC;
+    size_t topic_len = strlen(topic);
+    static char line[CONVERT_LINE_MAX];
+    static uint8_t dump[TRACE_DUMP_MAX_SIZE];
+    uint64_t cycles = 0;
+    uint32_t last_ccount = 0;
+    bool started = false;
+    unsigned mhz = 80, dumps = 0, entries = 0, lost = 0;
+
+    printf("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    while (fgets(line, sizeof(line), stdin)) {
+        const char *hex;
+        if (strncmp(line, "trace> ", 7) == 0) {
+            hex = line + 7;
+        } else if (strncmp(line, "mqtt> ", 6) == 0 && strncmp(line + 6, topic, topic_len) == 0 &&
+                   line[6 + topic_len] == ' ') {
+            hex = line + 7 + topic_len;
+        } else {
+            continue;
+        }
+        size_t len = parse_hex(hex, dump, sizeof(dump));
+        if (len < TRACE_DUMP_HEADER_SIZE || dump[0] != TRACE_DUMP_VERSION) {
+            fprintf(stderr, "skipping malformed dump, %zu bytes\n", len);
+            continue;
+        }
+        size_t count = dump[2] | (dump[3] << 8);
+        uint32_t dump_lost = dump[4] | (dump[5] << 8) | ((uint32_t)dump[6] << 16) | ((uint32_t)dump[7] << 24);
+        if (len != TRACE_DUMP_HEADER_SIZE + count * TRACE_DUMP_ENTRY_SIZE) {
+            fprintf(stderr, "skipping truncated dump, %zu bytes\n", len);
+            continue;
+        }
+        mhz = dump[1] ? dump[1] : mhz;
+        dumps++;
+        lost += dump_lost;
+        if (dump_lost && started) {
+            emit("entries lost", 'I', (double)cycles / mhz, track_id("trace"));
+        }
+
+        const uint8_t *p = dump + TRACE_DUMP_HEADER_SIZE;
+        for (size_t i = 0; i < count; i++, p += TRACE_DUMP_ENTRY_SIZE) {
+            uint32_t ccount = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+            uint8_t event = p[4];
+            uint8_t phase = p[5];
+            const char *name = trace_event_name(event);
+            if (!name) {
+                continue;
+            }
+            uint32_t delta = ccount - last_ccount;
+            if (!started) {
+                started = true;
+            } else if ((int32_t)delta < 0 && (int32_t)delta > -CONVERT_REORDER_CYCLES) {
+                cycles -= (uint32_t)-(int32_t)delta;
+            } else {
+                cycles += delta;
+            }
+            last_ccount = ccount;
+            entries++;
+            emit(name, phase == 'B' || phase == 'E' ? phase : 'I', (double)cycles / mhz,
+                 track_id(trace_event_track(event)));
+            account(event, phase, cycles);
+        }
+    }
+    for (size_t i = 0; i < s_track_count; i++) {
+        printf("%s\n    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+               s_first_event ? "" : ",", i + 1, s_tracks[i]);
+        s_first_event = false;
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%u dumps, %u entries, %u lost, %.3f s\n", dumps, entries, lost, (double)cycles / mhz / 1e6);
+    fprintf(stderr, "%-18s %8s %12s %10s %10s\n", "event", "count", "total us", "avg us", "max us");
+    for (int e = 0; e < TRACE_EVENT_COUNT; e++) {
+        const event_stats_t *st = &s_stats[e];
+        if (st->count) {
+            fprintf(stderr, "%-18s %8u %12.0f %10.1f %10.1f\n", trace_event_name(e), st->count,
+                    (double)st->total_cycles / mhz, (double)st->total_cycles / mhz / st->count,
+                    (double)st->max_cycles / mhz);
+        }
+    }
+    return entries ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "alloc_guard.h"
+
+#if ALLOC_GUARD_ENABLED
+#include <stdlib.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+static const char *TAG = "ALLOC";
+
+static alloc_guard_t *s_regions[ALLOC_GUARD_REGIONS];
+static uint32_t s_total;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static void alloc_count(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    __atomic_fetch_add(&s_total, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < ALLOC_GUARD_REGIONS; i++) {
+        alloc_guard_t *guard = __atomic_load_n(&s_regions[i], __ATOMIC_ACQUIRE);
+        // Only the region's own task writes its count
+        if (guard && guard->task == task) {
+            guard->allocs++;
+        }
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    alloc_count();
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count();
+    return __real_realloc(ptr, size);
+}
+
+void alloc_guard_begin(alloc_guard_t *guard)
+{
+    guard->allocs = 0;
+    guard->task = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL();
+    for (int i = 0; i < ALLOC_GUARD_REGIONS; i++) {
+        if (!s_regions[i]) {
+            __atomic_store_n(&s_regions[i], guard, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+void alloc_guard_end(alloc_guard_t *guard)
+{
+    taskENTER_CRITICAL();
+    for (int i = 0; i < ALLOC_GUARD_REGIONS; i++) {
+        if (s_regions[i] == guard) {
+            __atomic_store_n(&s_regions[i], NULL, __ATOMIC_RELEASE);
+        }
+    }
+    taskEXIT_CRITICAL();
+    guard->task = NULL;
+
+    // The first pass sets up lazily initialized state
+    if (guard->passes++ > 0 && guard->allocs > 0) {
+        guard->violations += guard->allocs;
+        ESP_LOGE(TAG, "%u heap allocations in %s, pass %u", guard->allocs, guard->name, guard->passes);
+#if ALLOC_GUARD_ENABLED >= 2
+        abort();
+#endif
+    }
+}
+
+uint32_t alloc_guard_total(void)
+{
+    return __atomic_load_n(&s_total, __ATOMIC_RELAXED);
+}
+#else
+void alloc_guard_begin(alloc_guard_t *guard)
+{
+}
+
+void alloc_guard_end(alloc_guard_t *guard)
+{
+}
+
+uint32_t alloc_guard_total(void)
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Steady-state heap check. Built with ALLOC_GUARD_ENABLED and linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (main/CMakeLists.txt: ALLOC_GUARD), every
+ * allocation of the image goes through a counter, the SDK's C library calls included.
+ * ALLOC_GUARD_BEGIN/ALLOC_GUARD_END around a loop body count the allocations the calling
+ * task makes in between; from the second pass on, any is reported as a violation, and with
+ * ALLOC_GUARD_ENABLED=2 aborts. Otherwise the macros compile to nothing.
+ */
+#ifndef ALLOC_GUARD_ENABLED
+#define ALLOC_GUARD_ENABLED 0
+#endif
+
+// Regions open at the same time, one per guarded task
+#define ALLOC_GUARD_REGIONS 4
+
+typedef struct
+{
+    const char *name;
+    void *task;                 //!< task in the region, NULL outside
+    uint32_t passes;
+    uint32_t allocs;            //!< in the current pass
+    uint32_t violations;        //!< allocations after the first pass
+} alloc_guard_t;
+
+#define ALLOC_GUARD_INIT(region_name) { .name = (region_name) }
+
+#if ALLOC_GUARD_ENABLED
+#define ALLOC_GUARD_BEGIN(guard) alloc_guard_begin(guard)
+#define ALLOC_GUARD_END(guard) alloc_guard_end(guard)
+#else
+#define ALLOC_GUARD_BEGIN(guard) ((void)(guard))
+#define ALLOC_GUARD_END(guard) ((void)(guard))
+#endif
+
+/**
+  * @brief  Start counting the allocations of the calling task; use the macros.
+  */
+void alloc_guard_begin(alloc_guard_t *guard);
+
+/**
+  * @brief  Stop counting and report the allocations of the pass; use the macros.
+  */
+void alloc_guard_end(alloc_guard_t *guard);
+
+/**
+  * @brief  Allocations since boot, 0 without ALLOC_GUARD_ENABLED.
+  */
+uint32_t alloc_guard_total(void);
+
+#ifdef __cplusplus
+}
+#endif
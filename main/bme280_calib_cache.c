@@ -0,0 +1,100 @@
+#include "bme280_calib_cache.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <nvs.h>
+#include <esp_attr.h>
+#include <esp_log.h>
+#include "crc.h"
+
+#define BME280_CALIB_CACHE_VERSION 1
+
+static const char *TAG = "BME280_CACHE";
+
+// Copies kept in RTC memory across deep sleep, in front of NVS. Not cleared on power on:
+// an entry is only trusted with a matching CRC. Counted in the RTC budget as BME280_CALIB_CACHE_RTC_SIZE.
+static RTC_DATA_ATTR bme280_calib_entry_t rtc_entries[BME280_CALIB_CACHE_RTC_SLOTS];
+
+_Static_assert(sizeof(rtc_entries) == BME280_CALIB_CACHE_RTC_SIZE, "RTC copies not counted in the RTC budget");
+
+static void entry_key(char key[16], uint8_t chip_id, uint8_t address)
+{
+    snprintf(key, 16, "cal_%02x_%02x", chip_id, address);
+}
+
+static uint16_t entry_crc(const bme280_calib_entry_t *entry)
+{
+    return crc16_ccitt(0xFFFF, entry, offsetof(bme280_calib_entry_t, crc));
+}
+
+static bool entry_valid(const bme280_calib_entry_t *entry, uint8_t chip_id, uint8_t address)
+{
+    return entry->version == BME280_CALIB_CACHE_VERSION && entry->chip_id == chip_id &&
+           entry->address == address && entry->crc == entry_crc(entry);
+}
+
+static bme280_calib_entry_t *rtc_entry(uint8_t address)
+{
+    return &rtc_entries[address & (BME280_CALIB_CACHE_RTC_SLOTS - 1)];
+}
+
+bool bme280_calib_cache_load(uint8_t chip_id, uint8_t address, bme280_calib_t *calib)
+{
+    bme280_calib_entry_t *rtc = rtc_entry(address);
+    if (entry_valid(rtc, chip_id, address)) {
+        *calib = rtc->calib;
+        return true;
+    }
+
+    bme280_calib_entry_t entry;
+    size_t length = sizeof(entry);
+    char key[16];
+    nvs_handle handle;
+
+    if (nvs_open(BME280_CALIB_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    entry_key(key, chip_id, address);
+    esp_err_t err = nvs_get_blob(handle, key, &entry, &length);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        return false;
+    }
+
+    if (length != sizeof(entry) || !entry_valid(&entry, chip_id, address)) {
+        ESP_LOGW(TAG, "Discarding invalid cached calibration %s", key);
+        return false;
+    }
+    memcpy(rtc, &entry, sizeof(entry)); // not an assignment: the CRC covers padding bytes
+    *calib = entry.calib;
+    return true;
+}
+
+bool bme280_calib_cache_store(uint8_t chip_id, uint8_t address, const bme280_calib_t *calib)
+{
+    bme280_calib_entry_t entry;
+    char key[16];
+    nvs_handle handle;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.version = BME280_CALIB_CACHE_VERSION;
+    entry.chip_id = chip_id;
+    entry.address = address;
+    entry.calib = *calib;
+    entry.crc = entry_crc(&entry);
+    memcpy(rtc_entry(address), &entry, sizeof(entry));
+
+    esp_err_t err = nvs_open(BME280_CALIB_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        entry_key(key, chip_id, address);
+        err = nvs_set_blob(handle, key, &entry, sizeof(entry));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Could not cache calibration (0x%x)", err);
+    }
+    return err == ESP_OK;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_bme280.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NVS namespace of the cache; nvs_flash_init must have been called
+#define BME280_CALIB_CACHE_NAMESPACE "bme280"
+#define BME280_CALIB_CACHE_RTC_SLOTS 2   // copies kept in RTC memory, one per I2C address
+
+/**
+ * Stored entry, in NVS and in RTC memory
+ */
+typedef struct
+{
+    uint8_t version;
+    uint8_t chip_id;
+    uint8_t address;
+    uint8_t reserved;
+    bme280_calib_t calib;
+    uint16_t crc;       //!< over the fields above, padding included
+} bme280_calib_entry_t;
+
+// RTC memory taken by the copies, part of the RTC budget checked in rtc_state.c
+#define BME280_CALIB_CACHE_RTC_SIZE (BME280_CALIB_CACHE_RTC_SLOTS * sizeof(bme280_calib_entry_t))
+
+/**
+  * @brief  Load the trimming coefficients stored for a sensor by bme280_calib_cache_store.
+  *         Entries are keyed by chip ID and I2C address, so each sensor of a node has its
+  *         own. A copy kept in RTC memory is used first, so a wake from deep sleep does not
+  *         read NVS either. A sensor replaced by another one of the same model at the same address
+  *         would get the coefficients of the old one: erase the NVS namespace then.
+  *
+  * @param  chip_id chip ID read from the sensor (bme280_dev_t.chip_id)
+  * @param  address I2C address of the sensor
+  * @param  calib output, untouched on failure
+  *
+  * @return true if a valid entry was found, false if missing, of another format or corrupted
+  */
+bool bme280_calib_cache_load(uint8_t chip_id, uint8_t address, bme280_calib_t *calib);
+
+/**
+  * @brief  Store the trimming coefficients of a sensor, read from it over I2C.
+  *
+  * @param  chip_id chip ID read from the sensor
+  * @param  address I2C address of the sensor
+  * @param  calib coefficients to store
+  *
+  * @return true on success
+  */
+bool bme280_calib_cache_store(uint8_t chip_id, uint8_t address, const bme280_calib_t *calib);
+
+#ifdef __cplusplus
+}
+#endif
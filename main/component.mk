@@ -3,3 +3,5 @@
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
 
+# outbox_pool.c implements esp-mqtt's private outbox interface (CONFIG_MQTT_CUSTOM_OUTBOX)
+CFLAGS += -I$(IDF_PATH)/components/mqtt/esp-mqtt/lib/include
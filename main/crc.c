@@ -0,0 +1,14 @@
+#include "crc.h"
+
+uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  * @brief  CRC-16/CCITT-FALSE (polynomial 0x1021, MSB first), bitwise, no table.
+  *         Pass 0xFFFF as crc to start; pass a previous result to continue over more data.
+  *
+  * @param  crc initial value
+  * @param  data bytes to checksum
+  * @param  len number of bytes
+  *
+  * @return updated CRC
+  */
+uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
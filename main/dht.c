@@ -1,12 +1,27 @@
 #include "dht.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <string.h>
+#include <esp_attr.h>
 #include <driver/gpio.h>
+#include <driver/soc.h> // soc_get_ccount
 #include <rom/ets_sys.h> // os_delay_us
+#include "trace.h"
 
 #define DHT_TIMER_INTERVAL 2
-#define DHT_DATA_BITS 40
+// Bit threshold bounds, in microseconds: a 0 is at most ~30 us high, a 1 at least ~65 us
+#define DHT_THRESHOLD_MIN 16
+#define DHT_THRESHOLD_MAX 60
+
+// Our release edge, phases B/C/D, 2 edges per bit and the final release.
+#define DHT_MAX_EDGES (1 + 3 + DHT_DATA_BITS * 2 + 1)
+// Edge index at which the last data bit has been fully captured (release edge included).
+#define DHT_COMPLETE_EDGES (1 + 3 + DHT_DATA_BITS * 2)
+// The response lasts ~5 ms; allow a tick of scheduling slack on top.
+#define DHT_CAPTURE_TIMEOUT_TICKS (pdMS_TO_TICKS(10) + 1)
+// Idle line wait before the start signal: a response still in progress ends within ~5 ms.
+#define DHT_BUS_IDLE_TICKS (pdMS_TO_TICKS(10) + 1)
 
 #ifdef DEBUG_DHT
 #define debug(fmt, ...) printf("%s" fmt "\n", "dht: ", ## __VA_ARGS__);
@@ -14,6 +29,20 @@
 #define debug(fmt, ...) /* (do nothing) */
 #endif
 
+typedef struct
+{
+    uint32_t ccount;
+    uint8_t level;
+} dht_edge_t;
+
+static uint32_t dht_edge_capture_pins;
+static SemaphoreHandle_t dht_capture_done;
+static dht_edge_t dht_edges[DHT_MAX_EDGES];
+static volatile uint8_t dht_edge_count;
+static volatile uint32_t dht_isr_cycles;
+static uint32_t dht_last_critical_cycles;
+static dht_pulses_t dht_last_pulses;
+
 static bool dht_await_pin_state(uint8_t pin, uint32_t timeout,
         bool expected_pin_state, uint32_t *duration)
 {
@@ -29,98 +58,307 @@ static bool dht_await_pin_state(uint8_t pin, uint32_t timeout,
     return false;
 }
 
-static inline bool dht_fetch_data(dht_sensor_type_t sensor_type, uint8_t pin, bool bits[DHT_DATA_BITS])
+static inline uint8_t dht_width(uint32_t us)
+{
+    return us < UINT8_MAX ? us : UINT8_MAX;
+}
+
+uint8_t dht_pulse_threshold(uint32_t preamble_low, uint32_t preamble_high)
+{
+    uint32_t threshold = ((preamble_low + preamble_high) * 19) >> 6;
+
+    if (threshold < DHT_THRESHOLD_MIN) {
+        return DHT_THRESHOLD_MIN;
+    }
+    return threshold > DHT_THRESHOLD_MAX ? DHT_THRESHOLD_MAX : threshold;
+}
+
+/* Holds the line low for the start signal, outside any critical section; the caller releases it. */
+static void dht_start_signal(dht_sensor_type_t sensor_type, gpio_num_t pin)
+{
+    gpio_set_level(pin, 0);
+    if (sensor_type == DHT_TYPE_SI7021) {
+        os_delay_us(500);
+    } else {
+        // >= 18 ms start signal: sleep instead of spinning, the upper bound is not critical
+        vTaskDelay(pdMS_TO_TICKS(20) + 1);
+    }
+}
+
+/* Polls the response after the start signal, with interrupts disabled: each bit is shifted into
+ * data as soon as its high pulse ends, no more work than that between two edges. */
+static inline esp_err_t dht_fetch_data(gpio_num_t pin, dht_pulses_t *pulses, uint8_t data[DHT_DATA_BYTES])
 {
     uint32_t low_duration;
     uint32_t high_duration;
 
-    gpio_set_level(pin, 0);
-    os_delay_us(sensor_type == DHT_TYPE_SI7021 ? 500 : 20000);
     gpio_set_level(pin, 1);
 
     if (!dht_await_pin_state(pin, 40, false, NULL)) {
         debug("Initialization error, problem in phase 'B'\n");
-        return false;
+        return ESP_ERR_DHT_NO_RESPONSE;
     }
 
-    if (!dht_await_pin_state(pin, 88, true, NULL)) {
+    if (!dht_await_pin_state(pin, 88, true, &low_duration)) {
         debug("Initialization error, problem in phase 'C'\n");
-        return false;
+        return ESP_ERR_DHT_PHASE_C;
     }
 
-    if (!dht_await_pin_state(pin, 88, false, NULL)) {
+    if (!dht_await_pin_state(pin, 88, false, &high_duration)) {
         debug("Initialization error, problem in phase 'D'\n");
-        return false;
+        return ESP_ERR_DHT_PHASE_D;
     }
+    pulses->preamble_low = dht_width(low_duration);
+    pulses->preamble_high = dht_width(high_duration);
+    pulses->threshold = dht_pulse_threshold(low_duration, high_duration);
 
+    uint32_t threshold = pulses->threshold;
     for (int i = 0; i < DHT_DATA_BITS; i++) {
         if (!dht_await_pin_state(pin, 65, true, &low_duration)) {
             debug("LOW bit timeout\n");
-            return false;
+            return ESP_ERR_DHT_BIT_TIMEOUT;
         }
         if (!dht_await_pin_state(pin, 75, false, &high_duration)) {
             debug("HIGH bit timeout\n");
-            return false;
+            return ESP_ERR_DHT_BIT_TIMEOUT;
         }
-        bits[i] = high_duration > low_duration;
+        pulses->low[i] = low_duration;
+        pulses->high[i] = high_duration;
+        pulses->bits = i + 1;
+        data[i / 8] = (data[i / 8] << 1) | (high_duration > threshold);
     }
-    return true;
+    return ESP_OK;
 }
 
-static inline float dht_convert_data(dht_sensor_type_t sensor_type, uint8_t msb, uint8_t lsb)
+static void IRAM_ATTR dht_edge_isr(void *arg)
 {
-    float data;
+    uint32_t start = soc_get_ccount();
+    uint8_t n = dht_edge_count;
 
-    if (sensor_type == DHT_TYPE_DHT22) {
-        data = ((msb & 0x7F) << 8) | lsb; // Combine MSB and LSB
-        data /= 10.0; // Convert to float with decimal precision
-        if (msb & 0x80) { // Check if the sign bit is set (for negative values)
-            data = -data;
+    if (n < DHT_MAX_EDGES) {
+        dht_edges[n].ccount = start;
+        dht_edges[n].level = gpio_get_level((gpio_num_t)(uintptr_t)arg);
+        dht_edge_count = ++n;
+        if (n == DHT_COMPLETE_EDGES) {
+            BaseType_t woken = pdFALSE;
+            xSemaphoreGiveFromISR(dht_capture_done, &woken);
+            if (woken) {
+                portYIELD_FROM_ISR();
+            }
         }
-    } else {
-        data = msb; // DHT11 data only in integer
     }
+    dht_isr_cycles += soc_get_ccount() - start;
+}
 
-    return data;
+/* Releases the line and waits for it to be idle (high): after an aborted read the sensor may
+ * still be sending, and a start signal over its response would corrupt the next read. */
+static esp_err_t dht_recover_bus(gpio_num_t pin)
+{
+    gpio_set_level(pin, 1);
+    if (gpio_get_level(pin)) {
+        return ESP_OK;
+    }
+    vTaskDelay(DHT_BUS_IDLE_TICKS);
+    if (gpio_get_level(pin)) {
+        return ESP_OK;
+    }
+    debug("Bus held low\n");
+    return ESP_ERR_DHT_BUS_LOW;
 }
 
-esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature)
+static void dht_capture_edges(dht_sensor_type_t sensor_type, gpio_num_t pin)
 {
-    bool bits[DHT_DATA_BITS];
-    uint8_t data[DHT_DATA_BITS / 8] = {0};
-    bool result;
+    dht_edge_count = 0;
+    dht_isr_cycles = 0;
+    xSemaphoreTake(dht_capture_done, 0);
 
-    taskENTER_CRITICAL();
-    result = dht_fetch_data(sensor_type, pin, bits);
-    taskEXIT_CRITICAL();
+    dht_start_signal(sensor_type, pin);
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+    gpio_set_level(pin, 1);
+
+    if (xSemaphoreTake(dht_capture_done, DHT_CAPTURE_TIMEOUT_TICKS) != pdTRUE) {
+        debug("Edge capture timeout, %d edges\n", dht_edge_count);
+    }
+    gpio_set_intr_type(pin, GPIO_INTR_DISABLE);
+}
 
-    if (!result) {
-        return ESP_FAIL;
+/* Pulse widths of the captured edges, also when the capture timed out: how far the response
+ * got tells which phase failed. */
+static esp_err_t dht_measure_edges(dht_pulses_t *pulses)
+{
+    uint8_t count = dht_edge_count;
+    uint8_t i = 0;
+
+    pulses->bits = 0;
+    // Skip our own release edge: the response starts when the sensor pulls low (phase B)
+    while (i < count && dht_edges[i].level) {
+        i++;
+    }
+    if (i == count) {
+        debug("Initialization error, problem in phase 'B'\n");
+        return ESP_ERR_DHT_NO_RESPONSE;
+    }
+    if (i + 1 == count || !dht_edges[i + 1].level) {
+        debug("Initialization error, problem in phase 'C'\n");
+        return ESP_ERR_DHT_PHASE_C;
+    }
+    if (i + 2 == count || dht_edges[i + 2].level) {
+        debug("Initialization error, problem in phase 'D'\n");
+        return ESP_ERR_DHT_PHASE_D;
     }
 
-    for (uint8_t i = 0; i < DHT_DATA_BITS; i++) {
-        data[i / 8] <<= 1;
-        data[i / 8] |= bits[i];
+    // Then each bit is a falling edge (start of low), a rising edge and the next falling edge
+    const dht_edge_t *e = &dht_edges[i];
+    const uint32_t mhz = CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ;
+    pulses->preamble_low = dht_width((e[1].ccount - e[0].ccount) / mhz);
+    pulses->preamble_high = dht_width((e[2].ccount - e[1].ccount) / mhz);
+    for (e += 2; e + 2 < &dht_edges[count] && pulses->bits < DHT_DATA_BITS; e += 2) {
+        pulses->low[pulses->bits] = dht_width((e[1].ccount - e[0].ccount) / mhz);
+        pulses->high[pulses->bits++] = dht_width((e[2].ccount - e[1].ccount) / mhz);
     }
+    return ESP_OK;
+}
 
+static esp_err_t dht_check_frame(const uint8_t data[DHT_DATA_BYTES])
+{
     if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
         debug("Checksum failed, invalid data received from sensor\n");
-        return ESP_FAIL;
+        return ESP_ERR_DHT_CHECKSUM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dht_decode_pulses(dht_pulses_t *pulses, uint8_t data[DHT_DATA_BYTES])
+{
+    pulses->threshold = dht_pulse_threshold(pulses->preamble_low, pulses->preamble_high);
+    if (pulses->bits < DHT_DATA_BITS) {
+        debug("Bit timeout, %d bits received\n", pulses->bits);
+        return ESP_ERR_DHT_BIT_TIMEOUT;
+    }
+
+    uint32_t threshold = pulses->threshold;
+    const uint8_t *high = pulses->high;
+    for (int i = 0; i < DHT_DATA_BYTES; i++, high += 8) {
+        uint8_t byte = 0;
+        for (int b = 0; b < 8; b++) {
+            byte = (byte << 1) | (high[b] > threshold);
+        }
+        data[i] = byte;
     }
+    return dht_check_frame(data);
+}
+
+/* A reading in tenths from its two bytes: (msb & msb_mask) * msb_weight + (lsb & lsb_mask),
+ * negated when the sign bit of either byte is set. */
+typedef struct
+{
+    uint8_t msb_mask;
+    uint8_t lsb_mask;
+    uint16_t msb_weight;
+    uint8_t msb_sign;
+    uint8_t lsb_sign;
+} dht_field_format_t;
+
+typedef struct
+{
+    dht_field_format_t humidity;
+    dht_field_format_t temperature;
+} dht_format_t;
 
-    if (sensor_type == DHT_TYPE_DHT11) {
-        *humidity = data[0] + data[1] * 0.1;
-        *temperature = data[2] + data[3] * 0.1;
+static const dht_format_t dht_formats[DHT_TYPE_COUNT] = {
+    // Integer and tenths bytes; bit 7 of the temperature tenths marks a negative temperature
+    [DHT_TYPE_DHT11] = { { 0xFF, 0xFF, 10, 0, 0 }, { 0xFF, 0x7F, 10, 0, 0x80 } },
+    // 16-bit words in tenths, the temperature in sign and magnitude
+    [DHT_TYPE_DHT22] = { { 0x7F, 0xFF, 256, 0, 0 }, { 0x7F, 0xFF, 256, 0x80, 0 } },
+    [DHT_TYPE_SI7021] = { { 0x7F, 0xFF, 256, 0, 0 }, { 0x7F, 0xFF, 256, 0x80, 0 } },
+};
+
+static inline int16_t dht_convert_field(const dht_field_format_t *f, uint8_t msb, uint8_t lsb)
+{
+    int16_t value = (msb & f->msb_mask) * f->msb_weight + (lsb & f->lsb_mask);
+
+    return ((msb & f->msb_sign) | (lsb & f->lsb_sign)) ? -value : value;
+}
+
+esp_err_t dht_convert_data(dht_sensor_type_t sensor_type, const uint8_t data[DHT_DATA_BYTES],
+        int16_t *humidity, int16_t *temperature)
+{
+    if ((unsigned)sensor_type >= DHT_TYPE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const dht_format_t *format = &dht_formats[sensor_type];
+    *humidity = dht_convert_field(&format->humidity, data[0], data[1]);
+    *temperature = dht_convert_field(&format->temperature, data[2], data[3]);
+    return ESP_OK;
+}
+
+static esp_err_t dht_read_frame(dht_sensor_type_t sensor_type, gpio_num_t pin, int16_t *humidity, int16_t *temperature)
+{
+    dht_pulses_t *pulses = &dht_last_pulses;
+    uint8_t data[DHT_DATA_BYTES] = {0};
+    esp_err_t result = dht_recover_bus(pin);
+
+    if (result != ESP_OK) {
+        return result;
+    }
+    if (dht_edge_capture_pins & (1UL << pin)) {
+        TRACE_BEGIN(DHT_CAPTURE);
+        dht_capture_edges(sensor_type, pin);
+        TRACE_END(DHT_CAPTURE);
+        TRACE_BEGIN(DHT_DECODE);
+        result = dht_measure_edges(pulses);
+        if (result == ESP_OK) {
+            result = dht_decode_pulses(pulses, data);
+        }
+        TRACE_END(DHT_DECODE);
+        dht_last_critical_cycles = dht_isr_cycles;
     } else {
-        *humidity = ((data[0] << 8) | data[1]) / 10.0;
-        *temperature = ((data[2] << 8) | data[3]) / 10.0;
+        pulses->bits = 0;
+        dht_start_signal(sensor_type, pin);
+        TRACE_BEGIN(DHT_FETCH);
+        taskENTER_CRITICAL();
+        uint32_t start = soc_get_ccount();
+        result = dht_fetch_data(pin, pulses, data);
+        dht_last_critical_cycles = soc_get_ccount() - start;
+        taskEXIT_CRITICAL();
+        TRACE_END(DHT_FETCH);
+        if (result == ESP_OK) {
+            result = dht_check_frame(data);
+        }
+    }
+
+    if (result != ESP_OK) {
+        return result;
     }
 
-    debug("Sensor data: humidity=%.1f, temp=%.1f\n", *humidity, *temperature);
+    dht_convert_data(sensor_type, data, humidity, temperature);
+    debug("Sensor data: humidity=%d, temp=%d\n", *humidity, *temperature);
 
     return ESP_OK;
 }
 
+esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, int16_t *humidity, int16_t *temperature)
+{
+    if ((unsigned)sensor_type >= DHT_TYPE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    TRACE_BEGIN(DHT_READ);
+    esp_err_t result = dht_read_frame(sensor_type, pin, humidity, temperature);
+    TRACE_END(DHT_READ);
+    return result;
+}
+
+esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature)
+{
+    int16_t humidity_tenths, temperature_tenths;
+    esp_err_t result = dht_read_data(sensor_type, pin, &humidity_tenths, &temperature_tenths);
+
+    if (result == ESP_OK) {
+        *humidity = humidity_tenths / 10.0f;
+        *temperature = temperature_tenths / 10.0f;
+    }
+    return result;
+}
 
 esp_err_t dht_init(gpio_num_t pin, bool pull_up) {
     gpio_config_t io_conf = {
@@ -137,3 +375,60 @@ esp_err_t dht_init(gpio_num_t pin, bool pull_up) {
     }
     return result;
 }
+
+esp_err_t dht_set_decode_mode(gpio_num_t pin, dht_decode_mode_t mode)
+{
+    if (pin >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (mode == DHT_DECODE_POLLING) {
+        if (dht_edge_capture_pins & (1UL << pin)) {
+            gpio_isr_handler_remove(pin);
+            dht_edge_capture_pins &= ~(1UL << pin);
+        }
+        return ESP_OK;
+    }
+    if (mode != DHT_DECODE_EDGE_CAPTURE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!dht_capture_done) {
+        dht_capture_done = xSemaphoreCreateBinary();
+        if (!dht_capture_done) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // The service may already be installed by another driver
+    esp_err_t result = gpio_install_isr_service(0);
+    if (result != ESP_OK && result != ESP_ERR_INVALID_STATE) {
+        return result;
+    }
+    result = gpio_isr_handler_add(pin, dht_edge_isr, (void *)(uintptr_t)pin);
+    if (result == ESP_OK) {
+        dht_edge_capture_pins |= 1UL << pin;
+    }
+    return result;
+}
+
+const char *dht_err_to_name(esp_err_t err)
+{
+    static const char *const names[DHT_ERR_COUNT] = {
+        "no response", "phase C", "phase D", "bit timeout", "checksum", "bus low",
+    };
+
+    if (err <= ESP_ERR_DHT_BASE || err > ESP_ERR_DHT_BASE + DHT_ERR_COUNT) {
+        return "unknown";
+    }
+    return names[err - ESP_ERR_DHT_BASE - 1];
+}
+
+const dht_pulses_t *dht_get_last_pulses(void)
+{
+    return &dht_last_pulses;
+}
+
+uint32_t dht_get_last_critical_us(void)
+{
+    return dht_last_critical_cycles / CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ;
+}
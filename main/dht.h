@@ -9,6 +9,19 @@
 extern "C" {
 #endif
 
+#define ESP_ERR_DHT_BASE            0xD000                  //!< Starting number of DHT error codes
+#define ESP_ERR_DHT_NO_RESPONSE     (ESP_ERR_DHT_BASE + 1)  //!< Phase B: line not pulled low after the start signal
+#define ESP_ERR_DHT_PHASE_C         (ESP_ERR_DHT_BASE + 2)  //!< Phase C: response low too long
+#define ESP_ERR_DHT_PHASE_D         (ESP_ERR_DHT_BASE + 3)  //!< Phase D: response high too long
+#define ESP_ERR_DHT_BIT_TIMEOUT     (ESP_ERR_DHT_BASE + 4)  //!< A data bit did not end in time, or edges are missing
+#define ESP_ERR_DHT_CHECKSUM        (ESP_ERR_DHT_BASE + 5)  //!< Frame received, checksum mismatch
+#define ESP_ERR_DHT_BUS_LOW         (ESP_ERR_DHT_BASE + 6)  //!< Line held low before the start signal
+// Number of ESP_ERR_DHT_* codes, for counters indexed by code - ESP_ERR_DHT_BASE - 1
+#define DHT_ERR_COUNT 6
+
+#define DHT_DATA_BITS 40
+#define DHT_DATA_BYTES (DHT_DATA_BITS / 8)
+
 /**
  * Sensor type
  */
@@ -16,9 +29,36 @@ typedef enum
 {
     DHT_TYPE_DHT11 = 0, //!< DHT11
     DHT_TYPE_DHT22,     //!< DHT22
-    DHT_TYPE_SI7021     //!< Itead SI7021
+    DHT_TYPE_SI7021,    //!< Itead SI7021
+    DHT_TYPE_COUNT
 } dht_sensor_type_t;
 
+/**
+ * Decoding mode
+ */
+typedef enum
+{
+    DHT_DECODE_POLLING = 0,     //!< Poll the line every 2 us inside a critical section
+    DHT_DECODE_EDGE_CAPTURE     //!< Timestamp edges from a GPIO interrupt, decode afterwards
+} dht_decode_mode_t;
+
+/**
+ * Pulse widths of a response, in microseconds, saturated at 255. Each data bit is a low pulse
+ * then a high one, short for a 0 and long for a 1: a bit is 1 when its high pulse is longer
+ * than the threshold, learned from the 80 us preamble of the same response so that it follows
+ * the sensor's clock. DHT_DECODE_POLLING counts polling loop steps of 2 us, so its widths read
+ * short when the loop is slower; the threshold scales with them.
+ */
+typedef struct
+{
+    uint8_t preamble_low;           //!< phase C, nominally 80 us
+    uint8_t preamble_high;          //!< phase D, nominally 80 us
+    uint8_t threshold;              //!< longest high pulse read as 0, dht_pulse_threshold
+    uint8_t bits;                   //!< data bits received, DHT_DATA_BITS for a whole frame
+    uint8_t low[DHT_DATA_BITS];     //!< nominally 50 us
+    uint8_t high[DHT_DATA_BITS];    //!< nominally 26-28 us for a 0, 70 us for a 1
+} dht_pulses_t;
+
 
 /**
  * Initialize Config dht pin to be read on specified pin
@@ -37,22 +77,54 @@ typedef enum
   */
 esp_err_t dht_init(gpio_num_t pin, bool pull_up);
 
+/**
+  * @brief  Select how dht_read_data decodes the sensor response on specified pin.
+  *         DHT_DECODE_POLLING (default) busy-polls the line with interrupts disabled for the
+  *         whole response (~5 ms). DHT_DECODE_EDGE_CAPTURE timestamps every edge with CCOUNT
+  *         from a GPIO interrupt and decodes the bits afterwards, so interrupts stay enabled.
+  *         Edge capture uses one shared capture buffer: do not read two pins concurrently.
+  *
+  * @param  pin GPIO number of dht sensor
+  * @param  mode decoding mode
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_ARG Parameter error
+  *     - ESP_ERR_NO_MEM Could not allocate the capture semaphore
+  */
+esp_err_t dht_set_decode_mode(gpio_num_t pin, dht_decode_mode_t mode);
+
+/**
+  * @brief  Time the last dht_read_data spent with interrupts disabled: the polling critical
+  *         section, or the sum of the edge interrupt handlers in edge capture mode.
+  *
+  * @return time in microseconds
+  */
+uint32_t dht_get_last_critical_us(void);
+
 /**
   * @brief  Read data from sensor on specified pin. dht_init must be called before reading it.
-  *         Humidity and temperature is returned as integers.
+  *         Humidity and temperature is returned as integers, in tenths.
   *         For example: humidity=625 is 62.5 %
   *                      temperature=244 is 24.4 degrees Celsius
+  *         Converted by dht_convert_data.
   * 
   * @param  sensor_type
   * @param  pin GPIO number of dht sensor
-  * @param  humidity output humidity
-  * @param  temperature output temperature
+  * @param  humidity output humidity, 0.1 %
+  * @param  temperature output temperature, 0.1 degrees Celsius
   * 
   * @return
   *     - ESP_OK Success
-  *     - ESP_FAIL Init error
+  *     - ESP_ERR_INVALID_ARG Unknown sensor type
+  *     - ESP_ERR_DHT_BUS_LOW The line did not go back high, even after waiting for the end
+  *       of a previous response: short to ground, missing pull-up
+  *     - ESP_ERR_DHT_NO_RESPONSE No answer to the start signal: sensor unpowered or disconnected
+  *     - ESP_ERR_DHT_PHASE_C, ESP_ERR_DHT_PHASE_D Preamble out of spec
+  *     - ESP_ERR_DHT_BIT_TIMEOUT Response cut short: noise, long wires, interrupted capture
+  *     - ESP_ERR_DHT_CHECKSUM Bit errors: noise, or a read too soon after the previous one
   */
-esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature);
+esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, int16_t *humidity, int16_t *temperature);
 
 
 /**
@@ -60,17 +132,66 @@ esp_err_t dht_read_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *hu
   *         Humidity and temperature is returned as float.
   *         For example: humidity=62.5 is 62.5 %
   *                      temperature=24.4 is 24.4 degrees Celsius
+  *         Uses floating point only to scale the result of dht_read_data.
   * 
   * @param  sensor_type
   * @param  pin GPIO number of dht sensor
   * @param  humidity output humidity
   * @param  temperature output temperature
   * 
+  * @return the errors of dht_read_data
+  */
+esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature);
+
+/**
+  * @brief  Pulse widths of the last dht_read_data, for diagnostics: bits is 0 when the
+  *         response did not get through the preamble. Overwritten by the next read, of any pin.
+  */
+const dht_pulses_t *dht_get_last_pulses(void);
+
+/**
+  * @brief  Bit threshold for a response with the given preamble, in the unit of the widths:
+  *         between the 0 and 1 high pulses, 19/64 of the preamble, within sane bounds when
+  *         the preamble itself is distorted.
+  */
+uint8_t dht_pulse_threshold(uint32_t preamble_low, uint32_t preamble_high);
+
+/**
+  * @brief  Decode recorded pulse widths as dht_read_data does: sets pulses->threshold from the
+  *         preamble and packs the bits, most significant first.
+  *
+  * @param  pulses preamble and pulses->bits bit widths
+  * @param  data the frame: humidity, temperature, checksum
+  *
   * @return
   *     - ESP_OK Success
-  *     - ESP_FAIL Init error
+  *     - ESP_ERR_DHT_BIT_TIMEOUT Fewer than DHT_DATA_BITS bits
+  *     - ESP_ERR_DHT_CHECKSUM Checksum mismatch
   */
-esp_err_t dht_read_float_data(dht_sensor_type_t sensor_type, gpio_num_t pin, float *humidity, float *temperature);
+esp_err_t dht_decode_pulses(dht_pulses_t *pulses, uint8_t data[DHT_DATA_BYTES]);
+
+/**
+  * @brief  Convert a frame to readings in tenths, without floating point. DHT11: integer and
+  *         tenths bytes, a negative temperature flagged by bit 7 of its tenths byte. DHT22 and
+  *         SI7021: 16-bit words, the temperature in sign and magnitude (bit 15), bit 15 of the
+  *         humidity ignored. Every frame gives values within int16_t.
+  *
+  * @param  sensor_type
+  * @param  data the frame, checksum already verified
+  * @param  humidity output humidity, 0.1 %
+  * @param  temperature output temperature, 0.1 degrees Celsius
+  *
+  * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown sensor type
+  */
+esp_err_t dht_convert_data(dht_sensor_type_t sensor_type, const uint8_t data[DHT_DATA_BYTES],
+        int16_t *humidity, int16_t *temperature);
+
+/**
+  * @brief  Short name of an ESP_ERR_DHT_* code, for logs.
+  *
+  * @return the name, "unknown" for any other code
+  */
+const char *dht_err_to_name(esp_err_t err);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,30 @@
+#include "fixed_fmt.h"
+
+size_t fixed_fmt(char *buf, int32_t value, uint8_t decimals)
+{
+    char digits[10];
+    uint32_t magnitude = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    size_t count = 0;
+    size_t len = 0;
+
+    if (decimals > 9) {
+        decimals = 9;
+    }
+    // Least significant first, with a leading zero before the point if needed
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0 || count <= decimals);
+
+    if (value < 0) {
+        buf[len++] = '-';
+    }
+    while (count > 0) {
+        if (count == decimals) {
+            buf[len++] = '.';
+        }
+        buf[len++] = digits[--count];
+    }
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest text fixed_fmt can write: sign, 10 digits, decimal point and NUL
+#define FIXED_FMT_MAX_LEN 13
+
+/**
+  * @brief  Format a fixed-point value as decimal text, with integer arithmetic only.
+  *         For example: fixed_fmt(buf, 2437, 2) writes "24.37"
+  *                      fixed_fmt(buf, -5, 1) writes "-0.5"
+  *                      fixed_fmt(buf, 101325, 0) writes "101325"
+  *
+  * @param  buf output buffer, at least FIXED_FMT_MAX_LEN bytes
+  * @param  value value scaled by 10^decimals
+  * @param  decimals digits after the decimal point, 0 to 9
+  *
+  * @return length of the text, terminating NUL not included
+  */
+size_t fixed_fmt(char *buf, int32_t value, uint8_t decimals);
+
+#ifdef __cplusplus
+}
+#endif
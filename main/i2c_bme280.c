@@ -27,89 +27,58 @@ THE SOFTWARE.
 */
 
 #include <math.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/i2c.h"
 
 #include "i2c_bme280.h"
+#include "trace.h"
 
-uint16_t calib_dig_T1;
-int16_t calib_dig_T2;
-int16_t calib_dig_T3;
-uint16_t calib_dig_P1;
-int16_t calib_dig_P2;
-int16_t calib_dig_P3;
-int16_t calib_dig_P4;
-int16_t calib_dig_P5;
-int16_t calib_dig_P6;
-int16_t calib_dig_P7;
-int16_t calib_dig_P8;
-int16_t calib_dig_P9;
-int8_t calib_dig_H1;
-int16_t calib_dig_H2;
-int8_t calib_dig_H3;
-int16_t calib_dig_H4;
-int16_t calib_dig_H5;
-int8_t calib_dig_H6;
-
-bme280_config_t bme280_config;
-uint8_t bme280_chip_id;
-
-uint32_t hum_raw, temp_raw, pres_raw;
-int32_t t_fine;
-int32_t temp_act;
-uint32_t press_act, hum_act;
-
-bool i2c_master_read_data(uint8_t read_reg, uint8_t *data, size_t data_len)
+static bme280_dev_t bme280_default_dev;
+static uint8_t i2c_master_users;
+
+static bool i2c_master_read_data(const bme280_dev_t *dev, uint8_t read_reg, uint8_t *data, size_t data_len)
 {
 	esp_err_t err;
 	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
 	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, bme280_config.address | I2C_MASTER_WRITE, true);
+	i2c_master_write_byte(cmd, (dev->config.address << 1) | I2C_MASTER_WRITE, true);
 	i2c_master_write_byte(cmd, read_reg, true);
 	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, bme280_config.address | I2C_MASTER_READ, true);
+	i2c_master_write_byte(cmd, (dev->config.address << 1) | I2C_MASTER_READ, true);
 	i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
 	i2c_master_stop(cmd);
+	TRACE_BEGIN(I2C_CMD);
 	err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
+	TRACE_END(I2C_CMD);
 	i2c_cmd_link_delete(cmd);
 
 	if (err != ESP_OK)
 	{
-		BME280_DEBUG_MSG("i2c_master_read_data: reg 0x%X error: 0x%X\r\n", read_reg, err);
+		BME280_DEBUG_MSG("i2c_master_read_data: 0x%X reg 0x%X error: 0x%X\r\n", dev->config.address, read_reg, err);
 		return false;
 	}
 
 	return true;
 }
 
-bool i2c_master_write_data(uint8_t write_reg, uint8_t *data, size_t data_len)
+// The bus is shared: the first device installs the driver with its pins, the last one removes it
+static bool i2c_master_init(const bme280_dev_t *dev)
 {
 	esp_err_t err;
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, bme280_config.address | I2C_MASTER_WRITE, true);
-	i2c_master_write_byte(cmd, write_reg, true);
-	i2c_master_write(cmd, data, data_len, true);
-	i2c_master_stop(cmd);
-	err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
-	i2c_cmd_link_delete(cmd);
+	i2c_config_t conf;
 
-	if (err != ESP_OK)
+	if (i2c_master_users > 0)
 	{
-		BME280_DEBUG_MSG("i2c_master_write_data: reg 0x%X error: 0x%X\r\n", write_reg, err);
-		return false;
+		i2c_master_users++;
+		return true;
 	}
 
-	return true;
-}
-
-bool i2c_master_init()
-{
-	esp_err_t err;
-	i2c_config_t conf;
 	conf.mode = I2C_MODE_MASTER;
-	conf.sda_io_num = bme280_config.gpio_sda;
+	conf.sda_io_num = dev->config.gpio_sda;
 	conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-	conf.scl_io_num = bme280_config.gpio_scl;
+	conf.scl_io_num = dev->config.gpio_scl;
 	conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
 	conf.clk_stretch_tick = 300;
 	err = i2c_driver_install(I2C_NUM_0, conf.mode);
@@ -122,331 +91,882 @@ bool i2c_master_init()
 	if (err != ESP_OK)
 	{
 		BME280_DEBUG_MSG("i2c_master_init: i2c_param_config error!\r\n");
+		i2c_driver_delete(I2C_NUM_0);
+		return false;
+	}
+	i2c_master_users = 1;
+	return true;
+}
+
+static void i2c_master_dispose()
+{
+	if (i2c_master_users > 0 && --i2c_master_users == 0)
+	{
+		i2c_driver_delete(I2C_NUM_0);
+	}
+}
+
+static bool i2c_master_run(const bme280_dev_t *dev, i2c_cmd_handle_t cmd)
+{
+	TRACE_BEGIN(I2C_CMD);
+	esp_err_t err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
+	TRACE_END(I2C_CMD);
+
+	if (err != ESP_OK)
+	{
+		BME280_DEBUG_MSG("i2c_master_run: 0x%X error: 0x%X\r\n", dev->config.address, err);
+		return false;
+	}
+
+	return true;
+}
+
+// Command links are not consumed by i2c_master_cmd_begin(): build the per-sample ones once
+static bool bme280_build_commands(bme280_dev_t *dev)
+{
+	const bme280_config_t *config = &dev->config;
+	uint8_t burst_len = dev->chip_id == BMP280_CHIP_ID ? BMP280_BURST_LEN : BME280_BURST_LEN;
+
+	dev->burst_cmd = i2c_cmd_link_create();
+	dev->trigger_cmd = i2c_cmd_link_create();
+	if (!dev->burst_cmd || !dev->trigger_cmd)
+	{
+		BME280_DEBUG_MSG("bme280_build_commands: out of memory\r\n");
 		return false;
 	}
+
+	i2c_master_start(dev->burst_cmd);
+	i2c_master_write_byte(dev->burst_cmd, (config->address << 1) | I2C_MASTER_WRITE, true);
+	i2c_master_write_byte(dev->burst_cmd, BME280_BURST_START, true);
+	i2c_master_start(dev->burst_cmd);
+	i2c_master_write_byte(dev->burst_cmd, (config->address << 1) | I2C_MASTER_READ, true);
+	i2c_master_read(dev->burst_cmd, dev->burst, burst_len, I2C_MASTER_LAST_NACK);
+	i2c_master_stop(dev->burst_cmd);
+
+	dev->trigger[0] = BME280_REG_CTRL_MEAS;
+	dev->trigger[1] = (config->osrs_t << 5) | (config->osrs_p << 2) | BME280_MODE_FORCED;
+	i2c_master_start(dev->trigger_cmd);
+	i2c_master_write_byte(dev->trigger_cmd, (config->address << 1) | I2C_MASTER_WRITE, true);
+	i2c_master_write(dev->trigger_cmd, dev->trigger, sizeof(dev->trigger), true);
+	i2c_master_stop(dev->trigger_cmd);
+
 	return true;
 }
 
-void i2c_master_dispose()
+static void bme280_delete_commands(bme280_dev_t *dev)
 {
-	i2c_driver_delete(I2C_NUM_0);
+	if (dev->burst_cmd)
+	{
+		i2c_cmd_link_delete(dev->burst_cmd);
+		dev->burst_cmd = NULL;
+	}
+	if (dev->trigger_cmd)
+	{
+		i2c_cmd_link_delete(dev->trigger_cmd);
+		dev->trigger_cmd = NULL;
+	}
 }
 
-bool bme280_write_config_registers(void)
+// The sensor takes (register, value) pairs in one write transaction. config goes before
+// ctrl_meas because config writes may be ignored in normal mode, and ctrl_hum only takes
+// effect after the ctrl_meas write, which also sets the mode.
+static bool bme280_write_config_registers(bme280_dev_t *dev, uint8_t mode)
 {
-	uint8_t ctrl_meas_reg = (bme280_config.osrs_t << 5) | (bme280_config.osrs_p << 2) | bme280_config.operation_mode;
-	uint8_t ctrl_hum_reg = bme280_config.osrs_h;
-	uint8_t config_reg = (bme280_config.t_sb << 5) | (bme280_config.filter << 2) | bme280_config.spi3w_en;
+	const bme280_config_t *config = &dev->config;
+	uint8_t regs[] = {
+		BME280_REG_CTRL_HUM, config->osrs_h,
+		BME280_REG_CONFIG, (config->t_sb << 5) | (config->filter << 2) | config->spi3w_en,
+		BME280_REG_CTRL_MEAS, (config->osrs_t << 5) | (config->osrs_p << 2) | mode};
+	esp_err_t err;
 
-	if (!i2c_master_write_data(BME280_REG_CTRL_HUM, &ctrl_hum_reg, 1) ||
-		!i2c_master_write_data(BME280_REG_CTRL_MEAS, &ctrl_meas_reg, 1) ||
-		!i2c_master_write_data(BME280_REG_CONFIG, &config_reg, 1))
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+	i2c_master_start(cmd);
+	i2c_master_write_byte(cmd, (config->address << 1) | I2C_MASTER_WRITE, true);
+	i2c_master_write(cmd, regs, sizeof(regs), true);
+	i2c_master_stop(cmd);
+	TRACE_BEGIN(I2C_CMD);
+	err = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_RATE_MS);
+	TRACE_END(I2C_CMD);
+	i2c_cmd_link_delete(cmd);
+
+	if (err != ESP_OK)
 	{
-		BME280_DEBUG_MSG("bme280_write_config_registers: error!\r\n");
+		BME280_DEBUG_MSG("bme280_write_config_registers: error: 0x%X\r\n", err);
 		return false;
 	}
 
 	return true;
 }
 
-bool bme280_verify_chip_id(void)
+static bool bme280_verify_chip_id(bme280_dev_t *dev)
 {
-	if (!i2c_master_read_data(BME280_CHIP_ID_REG, &bme280_chip_id, 1))
+	if (!i2c_master_read_data(dev, BME280_CHIP_ID_REG, &dev->chip_id, 1))
 	{
 		BME280_DEBUG_MSG("bme280_verify_chip_id: error!\r\n");
 		return false;
 	}
 
-	if (bme280_chip_id != BME280_CHIP_ID && bme280_chip_id != BMP280_CHIP_ID)
+	if (dev->chip_id != BME280_CHIP_ID && dev->chip_id != BMP280_CHIP_ID)
 	{
 		BME280_DEBUG_MSG("bme280_verify_chip_id: expected chip id 0x%X or 0x%X, found chip id 0x%X\r\n",
-						 BME280_CHIP_ID, BMP280_CHIP_ID, bme280_chip_id);
+						 BME280_CHIP_ID, BMP280_CHIP_ID, dev->chip_id);
 		return false;
 	}
 
 	return true;
 }
 
-int32_t bme280_get_t_fine()
+int32_t bme280_dev_get_t_fine(const bme280_dev_t *dev)
 {
-	return t_fine;
+	return dev->t_fine;
 }
 
-bool bme280_is_temperature_supported()
+bool bme280_dev_is_temperature_supported(const bme280_dev_t *dev)
 {
-	return (bme280_chip_id == BMP280_CHIP_ID || bme280_chip_id == BME280_CHIP_ID);
+	return (dev->chip_id == BMP280_CHIP_ID || dev->chip_id == BME280_CHIP_ID);
 }
 
-bool bme280_is_pressure_supported()
+bool bme280_dev_is_pressure_supported(const bme280_dev_t *dev)
 {
-	return (bme280_chip_id == BMP280_CHIP_ID || bme280_chip_id == BME280_CHIP_ID);
+	return (dev->chip_id == BMP280_CHIP_ID || dev->chip_id == BME280_CHIP_ID);
 }
 
-bool bme280_is_humidity_supported()
+bool bme280_dev_is_humidity_supported(const bme280_dev_t *dev)
 {
-	return (bme280_chip_id == BME280_CHIP_ID);
+	return (dev->chip_id == BME280_CHIP_ID);
 }
 
-int32_t bme280_get_temperature()
+int32_t bme280_dev_get_temperature(const bme280_dev_t *dev)
 {
-	return temp_act;
+	return dev->temp_act;
 }
 
-uint32_t bme280_get_pressure()
+uint32_t bme280_dev_get_pressure(const bme280_dev_t *dev)
 {
-	return press_act;
+	return dev->press_act;
 }
 
-uint32_t bme280_get_humidity()
+uint32_t bme280_dev_get_humidity(const bme280_dev_t *dev)
 {
-	return hum_act;
+	return dev->hum_act;
 }
 
-uint32_t bme280_get_temperature_raw()
+uint32_t bme280_dev_get_temperature_raw(const bme280_dev_t *dev)
 {
-	return temp_raw;
+	return dev->temp_raw;
 }
 
-uint32_t bme280_get_tressure_raw()
+uint32_t bme280_dev_get_pressure_raw(const bme280_dev_t *dev)
 {
-	return pres_raw;
+	return dev->pres_raw;
 }
 
-uint32_t bme280_get_humidity_raw()
+uint32_t bme280_dev_get_humidity_raw(const bme280_dev_t *dev)
 {
-	return hum_raw;
+	return dev->hum_raw;
 }
 
-int32_t bme280_calibration_temp(int32_t adc_T)
+/*
+ * Compensation formulas of the datasheet (4.2.3 and 8.2), in 32-bit integers.
+ * The inline helpers return every result instead of writing through a pointer,
+ * so that the loops of bme280_compensate_batch() vectorize.
+ */
+static inline int32_t compensate_t_fine(const bme280_calib_t *c, int32_t adc_T)
 {
+	int32_t var1, var2;
+	var1 = ((((adc_T >> 3) - ((int32_t)c->dig_T1 << 1))) * ((int32_t)c->dig_T2)) >> 11;
+	var2 = (((((adc_T >> 4) - ((int32_t)c->dig_T1)) * ((adc_T >> 4) - ((int32_t)c->dig_T1))) >> 12) * ((int32_t)c->dig_T3)) >> 14;
+	return var1 + var2;
+}
 
-	int32_t var1, var2, T;
-	var1 = ((((adc_T >> 3) - ((int32_t)calib_dig_T1 << 1))) * ((int32_t)calib_dig_T2)) >> 11;
-	var2 = (((((adc_T >> 4) - ((int32_t)calib_dig_T1)) * ((adc_T >> 4) - ((int32_t)calib_dig_T1))) >> 12) * ((int32_t)calib_dig_T3)) >> 14;
+static inline int32_t compensate_temp(int32_t t_fine)
+{
+	return (t_fine * 5 + 128) >> 8;
+}
 
-	t_fine = var1 + var2;
-	T = (t_fine * 5 + 128) >> 8;
-	return T;
+// Divisor of the pressure formula, 0 when it cannot be computed
+static inline int32_t compensate_press_divisor(const bme280_calib_t *c, int32_t t_fine)
+{
+	int32_t var1 = (t_fine >> 1) - (int32_t)64000;
+	var1 = (((c->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)c->dig_P2) * var1) >> 1)) >> 18;
+	return (((32768 + var1)) * ((int32_t)c->dig_P1)) >> 15;
+}
+
+// Numerator of the pressure formula, before the division
+static inline uint32_t compensate_press_num(const bme280_calib_t *c, int32_t adc_P, int32_t t_fine)
+{
+	int32_t var1 = (t_fine >> 1) - (int32_t)64000;
+	int32_t var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)c->dig_P6);
+	var2 = var2 + ((var1 * ((int32_t)c->dig_P5)) << 1);
+	var2 = (var2 >> 2) + (((int32_t)c->dig_P4) << 16);
+	return (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+}
+
+// The datasheet divides (num << 1) when that does not overflow, and doubles the quotient otherwise
+static inline uint32_t compensate_press_dividend(uint32_t num)
+{
+	return num << (num < 0x80000000);
 }
 
-uint32_t bme280_calibration_press(int32_t adc_P)
+static inline uint32_t compensate_press_final(const bme280_calib_t *c, uint32_t num, uint32_t quotient)
 {
 	int32_t var1, var2;
-	uint32_t P;
-	var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
-	var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)calib_dig_P6);
-	var2 = var2 + ((var1 * ((int32_t)calib_dig_P5)) << 1);
-	var2 = (var2 >> 2) + (((int32_t)calib_dig_P4) << 16);
-	var1 = (((calib_dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)calib_dig_P2) * var1) >> 1)) >> 18;
-	var1 = ((((32768 + var1)) * ((int32_t)calib_dig_P1)) >> 15);
-	if (var1 == 0)
-	{
-		return 0;
-	}
-	P = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
-	if (P < 0x80000000)
-	{
-		P = (P << 1) / ((uint32_t)var1);
-	}
-	else
-	{
-		P = (P / (uint32_t)var1) * 2;
-	}
-	var1 = (((int32_t)calib_dig_P9) * ((int32_t)(((P >> 3) * (P >> 3)) >> 13))) >> 12;
-	var2 = (((int32_t)(P >> 2)) * ((int32_t)calib_dig_P8)) >> 13;
-	P = (uint32_t)((int32_t)P + ((var1 + var2 + calib_dig_P7) >> 4));
-	return P;
+	uint32_t P = quotient << (num >= 0x80000000);
+
+	var1 = (((int32_t)c->dig_P9) * ((int32_t)(((P >> 3) * (P >> 3)) >> 13))) >> 12;
+	var2 = (((int32_t)(P >> 2)) * ((int32_t)c->dig_P8)) >> 13;
+	return (uint32_t)((int32_t)P + ((var1 + var2 + c->dig_P7) >> 4));
 }
 
-uint32_t bme280_calibration_hum(int32_t adc_H)
+static inline uint32_t compensate_hum(const bme280_calib_t *c, int32_t adc_H, int32_t t_fine)
 {
 	int32_t v_x1;
 
 	v_x1 = (t_fine - ((int32_t)76800));
-	v_x1 = (((((adc_H << 14) - (((int32_t)calib_dig_H4) << 20) - (((int32_t)calib_dig_H5) * v_x1)) +
+	v_x1 = (((((adc_H << 14) - (((int32_t)c->dig_H4) << 20) - (((int32_t)c->dig_H5) * v_x1)) +
 			  ((int32_t)16384)) >>
 			 15) *
-			(((((((v_x1 * ((int32_t)calib_dig_H6)) >> 10) *
-				 (((v_x1 * ((int32_t)calib_dig_H3)) >> 11) + ((int32_t)32768))) >>
+			(((((((v_x1 * ((int32_t)c->dig_H6)) >> 10) *
+				 (((v_x1 * ((int32_t)c->dig_H3)) >> 11) + ((int32_t)32768))) >>
 				10) +
 			   ((int32_t)2097152)) *
-				  ((int32_t)calib_dig_H2) +
+				  ((int32_t)c->dig_H2) +
 			  8192) >>
 			 14));
-	v_x1 = (v_x1 - (((((v_x1 >> 15) * (v_x1 >> 15)) >> 7) * ((int32_t)calib_dig_H1)) >> 4));
+	v_x1 = (v_x1 - (((((v_x1 >> 15) * (v_x1 >> 15)) >> 7) * ((int32_t)c->dig_H1)) >> 4));
 	v_x1 = (v_x1 < 0 ? 0 : v_x1);
 	v_x1 = (v_x1 > 419430400 ? 419430400 : v_x1);
 	return (uint32_t)(v_x1 >> 12);
 }
 
-bool bme280_read_calibration_registers(void)
+int32_t bme280_compensate_temperature(const bme280_calib_t *calib, int32_t adc_T, int32_t *t_fine)
+{
+	int32_t fine = compensate_t_fine(calib, adc_T);
+
+	if (t_fine)
+	{
+		*t_fine = fine;
+	}
+	return compensate_temp(fine);
+}
+
+uint32_t bme280_compensate_pressure(const bme280_calib_t *calib, int32_t adc_P, int32_t t_fine)
+{
+	int32_t divisor = compensate_press_divisor(calib, t_fine);
+	if (divisor == 0)
+	{
+		return 0;
+	}
+	uint32_t num = compensate_press_num(calib, adc_P, t_fine);
+	return compensate_press_final(calib, num, compensate_press_dividend(num) / (uint32_t)divisor);
+}
+
+uint32_t bme280_compensate_pressure64(const bme280_calib_t *calib, int32_t adc_P, int32_t t_fine)
+{
+	const bme280_calib_t *c = calib;
+	int64_t var1, var2, p;
+
+	var1 = ((int64_t)t_fine) - 128000;
+	var2 = var1 * var1 * (int64_t)c->dig_P6;
+	var2 = var2 + ((var1 * (int64_t)c->dig_P5) * ((int64_t)1 << 17));
+	var2 = var2 + (((int64_t)c->dig_P4) * ((int64_t)1 << 35));
+	var1 = ((var1 * var1 * (int64_t)c->dig_P3) >> 8) + ((var1 * (int64_t)c->dig_P2) * ((int64_t)1 << 12));
+	var1 = ((((int64_t)1) << 47) + var1) * ((int64_t)c->dig_P1) >> 33;
+	if (var1 == 0)
+	{
+		return 0;
+	}
+	p = 1048576 - adc_P;
+	p = ((p * ((int64_t)1 << 31)) - var2) * 3125 / var1;
+	var1 = (((int64_t)c->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (((int64_t)c->dig_P8) * p) >> 19;
+	p = ((p + var1 + var2) >> 8) + (((int64_t)c->dig_P7) * 16);
+	return (uint32_t)p;
+}
+
+uint32_t bme280_compensate_humidity(const bme280_calib_t *calib, int32_t adc_H, int32_t t_fine)
 {
+	return compensate_hum(calib, adc_H, t_fine);
+}
+
+#ifdef __SSE2__
+// Division in doubles, which SSE2 vectorizes and integer division does not. The truncated
+// quotient is exact for operands below 2^53; uint32_t <-> double goes through int32_t
+// conversions, the only ones SSE2 has, so a quotient must stay below 2^31: b = 1 is
+// answered apart. No floating point comparison either, it would keep the loop branching.
+static inline double compensate_u32_to_double(uint32_t x)
+{
+	return (double)(int32_t)(x ^ 0x80000000) + 2147483648.0;
+}
+
+static inline uint32_t compensate_udiv(uint32_t a, uint32_t b)
+{
+	uint32_t one = -(uint32_t)(b == 1); // all ones when b = 1, masks rather than a select
+	double q = compensate_u32_to_double(a) / compensate_u32_to_double(b + (b == 1));
+	return (a & one) | ((uint32_t)(int32_t)q & ~one);
+}
+#else
+static inline uint32_t compensate_udiv(uint32_t a, uint32_t b)
+{
+	return a / b;
+}
+#endif
+
+void bme280_compensate_batch(const bme280_calib_t *calib, size_t count,
+							 const int32_t *restrict adc_T, const int32_t *restrict adc_P, const int32_t *restrict adc_H,
+							 int32_t *restrict temperature, uint32_t *restrict pressure, uint32_t *restrict humidity)
+{
+	// Local copy: the outputs may not alias it, so the coefficients stay in registers
+	const bme280_calib_t c = *calib;
+	int32_t t_fine[BME280_COMPENSATE_BLOCK];
+
+	for (size_t done = 0; done < count; done += BME280_COMPENSATE_BLOCK)
+	{
+		size_t n = count - done < BME280_COMPENSATE_BLOCK ? count - done : BME280_COMPENSATE_BLOCK;
+
+		// One pass per quantity over a block, each a straight loop without calls
+		for (size_t i = 0; i < n; i++)
+		{
+			t_fine[i] = compensate_t_fine(&c, adc_T[done + i]);
+		}
+		if (temperature)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				temperature[done + i] = compensate_temp(t_fine[i]);
+			}
+		}
+		if (adc_P && pressure)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				int32_t divisor = compensate_press_divisor(&c, t_fine[i]);
+				uint32_t num = compensate_press_num(&c, adc_P[done + i], t_fine[i]);
+				uint32_t quotient = compensate_udiv(compensate_press_dividend(num), (uint32_t)divisor + (divisor == 0));
+				uint32_t P = compensate_press_final(&c, num, quotient);
+				pressure[done + i] = P & -(uint32_t)(divisor != 0);
+			}
+		}
+		if (adc_H && humidity)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				humidity[done + i] = compensate_hum(&c, adc_H[done + i], t_fine[i]);
+			}
+		}
+	}
+}
+
+void bme280_comp_init(const bme280_calib_t *calib, bme280_comp_t *comp)
+{
+	const bme280_calib_t *c = calib;
+
+	comp->t1 = c->dig_T1;
+	comp->t1x2 = (int32_t)c->dig_T1 << 1;
+	comp->t2 = c->dig_T2;
+	comp->t3 = c->dig_T3;
+	comp->p1 = c->dig_P1;
+	comp->p2 = c->dig_P2;
+	comp->p3 = c->dig_P3;
+	comp->p4s16 = (int32_t)c->dig_P4 << 16;
+	comp->p5x2 = (int32_t)c->dig_P5 * 2;
+	comp->p6 = c->dig_P6;
+	comp->p7 = c->dig_P7;
+	comp->p8 = c->dig_P8;
+	comp->p9 = c->dig_P9;
+	comp->h1 = c->dig_H1;
+	comp->h2 = c->dig_H2;
+	comp->h3 = c->dig_H3;
+	comp->h4s20 = ((int32_t)c->dig_H4 << 20) - 16384;
+	comp->h5 = c->dig_H5;
+	comp->h6 = c->dig_H6;
+}
+
+/*
+ * The formulas of compensate_t_fine(), compensate_press_*() and compensate_hum() rearranged:
+ * constants from bme280_comp_t, (t_fine >> 1) - 64000 and its square shared by the two halves
+ * of the pressure formula, and the divisions by shifts kept. Wrapping int32 arithmetic, so the
+ * folded products and sums give the same bits.
+ */
+void bme280_compensate_fused(const bme280_comp_t *comp, int32_t adc_T, int32_t adc_P, int32_t adc_H,
+							 bme280_reading_t *reading)
+{
+	const bme280_comp_t *c = comp;
+	int32_t var1, var2, t_fine;
+	uint32_t P = 0;
+
+	var1 = (((adc_T >> 3) - c->t1x2) * c->t2) >> 11;
+	var2 = (adc_T >> 4) - c->t1;
+	var2 = (((var2 * var2) >> 12) * c->t3) >> 14;
+	t_fine = var1 + var2;
+	reading->t_fine = t_fine;
+	reading->temperature = (t_fine * 5 + 128) >> 8;
+
+	int32_t v = (t_fine >> 1) - (int32_t)64000;
+	int32_t square = (v >> 2) * (v >> 2);
+	var1 = (((c->p3 * (square >> 13)) >> 3) + ((c->p2 * v) >> 1)) >> 18;
+	uint32_t divisor = (uint32_t)(((32768 + var1) * c->p1) >> 15);
+	if (divisor != 0)
+	{
+		var2 = (((square >> 11) * c->p6 + v * c->p5x2) >> 2) + c->p4s16;
+		uint32_t num = ((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12)) * 3125;
+		P = num < 0x80000000 ? (num << 1) / divisor : (num / divisor) << 1;
+		var1 = (c->p9 * ((int32_t)(((P >> 3) * (P >> 3)) >> 13))) >> 12;
+		var2 = (((int32_t)(P >> 2)) * c->p8) >> 13;
+		P = (uint32_t)((int32_t)P + ((var1 + var2 + c->p7) >> 4));
+	}
+	reading->pressure = P;
+
+	reading->humidity = 0;
+	if (adc_H >= 0)
+	{
+		int32_t x = t_fine - ((int32_t)76800);
+		int32_t scale = ((((((x * c->h6) >> 10) * (((x * c->h3) >> 11) + ((int32_t)32768))) >> 10) +
+						  ((int32_t)2097152)) * c->h2 + 8192) >> 14;
+		int32_t h = (((adc_H << 14) - c->h4s20 - c->h5 * x) >> 15) * scale;
+		h = h - (((((h >> 15) * (h >> 15)) >> 7) * c->h1) >> 4);
+		h = h < 0 ? 0 : h;
+		h = h > 419430400 ? 419430400 : h;
+		reading->humidity = (uint32_t)(h >> 12);
+	}
+}
+
+static bool bme280_read_calibration_registers(bme280_dev_t *dev)
+{
+	bme280_calib_t *c = &dev->calib;
 	uint8_t data[24];
 
 	// ***************** Read section 0x88:0x9F *****************
-	if (!i2c_master_read_data(0x88, data, 24))
+	if (!i2c_master_read_data(dev, 0x88, data, 24))
 	{
 		BME280_DEBUG_MSG("bme280_read_calibration_registers: section 0x88:0x9F error!\r\n");
 		return false;
 	}
 
 	// 0x88 / 0x89
-	calib_dig_T1 = data[0] | (data[1] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T1 = %u\r\n", data[0], data[1], calib_dig_T1);
+	c->dig_T1 = data[0] | (data[1] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T1 = %u\r\n", data[0], data[1], c->dig_T1);
 
 	// 0x8A / 0x8B
-	calib_dig_T2 = data[2] | (data[3] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T2 = %d\r\n", data[2], data[3], calib_dig_T2);
+	c->dig_T2 = data[2] | (data[3] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T2 = %d\r\n", data[2], data[3], c->dig_T2);
 
 	// 0x8C / 0x8D
-	calib_dig_T3 = data[4] | (data[5] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T3 = %d\r\n", data[4], data[5], calib_dig_T3);
+	c->dig_T3 = data[4] | (data[5] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_T3 = %d\r\n", data[4], data[5], c->dig_T3);
 
 	// 0x8E / 0x8F
-	calib_dig_P1 = data[6] | (data[7] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P1 = %u\r\n", data[6], data[7], calib_dig_P1);
+	c->dig_P1 = data[6] | (data[7] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P1 = %u\r\n", data[6], data[7], c->dig_P1);
 
 	// 0x90 / 0x91
-	calib_dig_P2 = data[8] | (data[9] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P2 = %d\r\n", data[8], data[9], calib_dig_P2);
+	c->dig_P2 = data[8] | (data[9] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P2 = %d\r\n", data[8], data[9], c->dig_P2);
 
 	// 0x92 / 0x93
-	calib_dig_P3 = data[10] | (data[11] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P3 = %d\r\n", data[10], data[11], calib_dig_P3);
+	c->dig_P3 = data[10] | (data[11] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P3 = %d\r\n", data[10], data[11], c->dig_P3);
 
 	// 0x94 / 0x95
-	calib_dig_P4 = data[12] | (data[13] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P4 = %d\r\n", data[12], data[13], calib_dig_P4);
+	c->dig_P4 = data[12] | (data[13] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P4 = %d\r\n", data[12], data[13], c->dig_P4);
 
 	// 0x96 / 0x97
-	calib_dig_P5 = data[14] | (data[15] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P5 = %d\r\n", data[14], data[15], calib_dig_P5);
+	c->dig_P5 = data[14] | (data[15] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P5 = %d\r\n", data[14], data[15], c->dig_P5);
 
 	// 0x98 / 0x99
-	calib_dig_P6 = data[16] | (data[17] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P6 = %d\r\n", data[16], data[17], calib_dig_P6);
+	c->dig_P6 = data[16] | (data[17] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P6 = %d\r\n", data[16], data[17], c->dig_P6);
 
 	// 0x9A / 0x9B
-	calib_dig_P7 = data[18] | (data[19] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P7 = %d\r\n", data[18], data[19], calib_dig_P7);
+	c->dig_P7 = data[18] | (data[19] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P7 = %d\r\n", data[18], data[19], c->dig_P7);
 
 	// 0x9C / 0x9D
-	calib_dig_P8 = data[20] | (data[21] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P8 = %d\r\n", data[20], data[21], calib_dig_P8);
+	c->dig_P8 = data[20] | (data[21] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P8 = %d\r\n", data[20], data[21], c->dig_P8);
 
 	// 0x9E / 0x9F
-	calib_dig_P9 = data[22] | (data[23] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P9 = %d\r\n", data[22], data[23], calib_dig_P9);
+	c->dig_P9 = data[22] | (data[23] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_P9 = %d\r\n", data[22], data[23], c->dig_P9);
 
-	if (bme280_chip_id == BMP280_CHIP_ID)
+	if (dev->chip_id == BMP280_CHIP_ID)
 	{
 		return true;
 	}
 
 	// ***************** Read section 0xA1 *****************
-	if (!i2c_master_read_data(0xA1, data, 1))
+	if (!i2c_master_read_data(dev, 0xA1, data, 1))
 	{
 		BME280_DEBUG_MSG("bme280_read_calibration_registers: section 0xA1 error!\r\n");
 		return false;
 	}
 
 	// 0xA1
-	calib_dig_H1 = data[0];
-	BME280_DEBUG_MSG("msb: 0x%X = calib_dig_H1 = %d\r\n", data[0], calib_dig_H1);
+	c->dig_H1 = data[0];
+	BME280_DEBUG_MSG("msb: 0x%X = calib_dig_H1 = %d\r\n", data[0], c->dig_H1);
 
 	// ***************** Read section 0xE1:0xE6 *****************
-	if (!i2c_master_read_data(0xE1, data, 7))
+	if (!i2c_master_read_data(dev, 0xE1, data, 7))
 	{
 		BME280_DEBUG_MSG("bme280_read_calibration_registers: section 0xE1 error!\r\n");
 		return false;
 	}
 
 	// 0xE1 / 0xE2
-	calib_dig_H2 = data[0] | (data[1] << 8);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H2 = %d\r\n", data[0], data[1], calib_dig_H2);
+	c->dig_H2 = data[0] | (data[1] << 8);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H2 = %d\r\n", data[0], data[1], c->dig_H2);
 
 	// 0xE3
-	calib_dig_H3 = data[2];
-	BME280_DEBUG_MSG("lsb 0x%X = calib_dig_H3 = %d\r\n", data[2], calib_dig_H3);
+	c->dig_H3 = data[2];
+	BME280_DEBUG_MSG("lsb 0x%X = calib_dig_H3 = %d\r\n", data[2], c->dig_H3);
 
 	// 0xE4 / 0xE5[3:0]
-	calib_dig_H4 = (data[3] << 4) | (0x0f & data[4]);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H4 = %d\r\n", data[3], data[4], calib_dig_H4);
+	c->dig_H4 = (data[3] << 4) | (0x0f & data[4]);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H4 = %d\r\n", data[3], data[4], c->dig_H4);
 
 	// 0xE5[7:4] / 0xE6
-	calib_dig_H5 = (data[4] >> 4) | (data[5] << 4);
-	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H5 = %d\r\n", data[5], data[4], calib_dig_H5);
+	c->dig_H5 = (data[4] >> 4) | (data[5] << 4);
+	BME280_DEBUG_MSG("lsb 0x%X, msb: 0x%X = calib_dig_H5 = %d\r\n", data[5], data[4], c->dig_H5);
 
 	// 0xE7
-	calib_dig_H6 = data[6];
-	BME280_DEBUG_MSG("lsb 0x%X = calib_dig_H6 = %d\r\n", data[6], calib_dig_H6);
+	c->dig_H6 = data[6];
+	BME280_DEBUG_MSG("lsb 0x%X = calib_dig_H6 = %d\r\n", data[6], c->dig_H6);
 
 	return true;
 }
 
-bool bme280_init(bme280_config_t config)
+bool bme280_dev_probe(bme280_dev_t *dev, bme280_config_t config)
 {
-	bme280_config = config;
-	bme280_config.address <<= 1;
+	memset(dev, 0, sizeof(*dev));
+	dev->config = config;
 
-	if (!i2c_master_init() ||
-		!bme280_verify_chip_id() ||
-		!bme280_write_config_registers() ||
-		!bme280_read_calibration_registers())
+	if (!i2c_master_init(dev))
 	{
-		BME280_DEBUG_MSG("bme280_init: failed\r\n");
+		BME280_DEBUG_MSG("bme280_probe: failed\r\n");
+		return false;
+	}
+
+	if (!bme280_verify_chip_id(dev))
+	{
+		BME280_DEBUG_MSG("bme280_probe: failed\r\n");
+		i2c_master_dispose();
 		return false;
 	}
 
-	BME280_DEBUG_MSG("bme280_init: success\r\n");
 	return true;
 }
 
-void bme280_dispose()
+bool bme280_dev_setup(bme280_dev_t *dev, const bme280_calib_t *calib)
 {
-	i2c_master_dispose();
+	if (calib)
+	{
+		dev->calib = *calib;
+	}
+
+	if (!bme280_write_config_registers(dev, dev->config.operation_mode) ||
+		(!calib && !bme280_read_calibration_registers(dev)) ||
+		!bme280_build_commands(dev))
+	{
+		BME280_DEBUG_MSG("bme280_setup: failed\r\n");
+		bme280_delete_commands(dev);
+		i2c_master_dispose();
+		return false;
+	}
+	bme280_comp_init(&dev->calib, &dev->comp);
+
+	BME280_DEBUG_MSG("bme280_setup: success\r\n");
+	return true;
 }
 
-bool bme280_trigger_forced_read()
+bool bme280_dev_init(bme280_dev_t *dev, bme280_config_t config)
 {
-	uint8_t ctrl_meas_reg = (bme280_config.osrs_t << 5) | (bme280_config.osrs_p << 2) | bme280_config.operation_mode;
+	return bme280_dev_probe(dev, config) && bme280_dev_setup(dev, NULL);
+}
 
-	if (!i2c_master_write_data(BME280_REG_CTRL_MEAS, &ctrl_meas_reg, 1))
+bool bme280_dev_reconfigure(bme280_dev_t *dev, const bme280_config_t *config)
+{
+	if (dev->read_state == BME280_READ_MEASURING)
 	{
-		BME280_DEBUG_MSG("bme280_trigger_forced_read_i2c: error!\r\n");
+		return false;
+	}
+
+	dev->config.osrs_t = config->osrs_t;
+	dev->config.osrs_p = config->osrs_p;
+	dev->config.osrs_h = config->osrs_h;
+	dev->config.t_sb = config->t_sb;
+	dev->config.filter = config->filter;
+
+	// The trigger carries the oversampling: rebuilt, as the link may hold a copy of the bytes
+	bme280_delete_commands(dev);
+	if (!bme280_write_config_registers(dev, BME280_MODE_SLEEP) || !bme280_build_commands(dev))
+	{
+		BME280_DEBUG_MSG("bme280_reconfigure: failed\r\n");
 		return false;
 	}
 
 	return true;
 }
 
-bool bme280_read_sensor_data()
+void bme280_dev_dispose(bme280_dev_t *dev)
 {
-	uint8_t data[8];
+	bme280_delete_commands(dev);
+	i2c_master_dispose();
+}
 
-	if (!i2c_master_read_data(0xF7, data, bme280_chip_id == BMP280_CHIP_ID ? 6 : 8))
+bool bme280_dev_trigger_forced_read(bme280_dev_t *dev)
+{
+	if (!i2c_master_run(dev, dev->trigger_cmd))
 	{
-		BME280_DEBUG_MSG("bme280_read_sensor_data_i2c: section 0xF7 error!\r\n");
+		BME280_DEBUG_MSG("bme280_trigger_forced_read_i2c: error!\r\n");
 		return false;
 	}
 
+	return true;
+}
+
+static void bme280_compensate_burst(bme280_dev_t *dev)
+{
+	const uint8_t *data = &dev->burst[BME280_REG_DATA - BME280_BURST_START];
+
+	bool humidity = dev->chip_id == BME280_CHIP_ID;
+	bme280_reading_t reading;
+
+	TRACE_BEGIN(BME280_COMPENSATE);
 	// 0xF7 - pressure
-	pres_raw = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
-	press_act = bme280_calibration_press(pres_raw);
+	dev->pres_raw = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
 	BME280_DEBUG_MSG("pres_raw 0: %X, pres_raw 1: %X, pres_raw 2: %X\r\n", data[0], data[1], data[2]);
 
 	//0xFA - temp
-	temp_raw = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
-	temp_act = bme280_calibration_temp(temp_raw);
+	dev->temp_raw = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
 	BME280_DEBUG_MSG("temp_raw 3: %X, temp_raw 4: %X, temp_raw 5: %X\r\n", data[3], data[4], data[5]);
 
-	if (bme280_chip_id == BME280_CHIP_ID)
+	if (humidity)
 	{
 		//0xFD - humidity
-		hum_raw = (data[6] << 8) | data[7];
-		hum_act = bme280_calibration_hum(hum_raw);
+		dev->hum_raw = (data[6] << 8) | data[7];
 		BME280_DEBUG_MSG("hum_raw 6: %X, hum_raw 7: %X\r\n", data[6], data[7]);
 	}
 
+	// Pressure and humidity need the t_fine of this reading: all from the same burst
+	bme280_compensate_fused(&dev->comp, dev->temp_raw, dev->pres_raw, humidity ? (int32_t)dev->hum_raw : -1, &reading);
+	dev->t_fine = reading.t_fine;
+	dev->temp_act = reading.temperature;
+	dev->press_act = reading.pressure;
+	if (humidity)
+	{
+		dev->hum_act = reading.humidity;
+	}
+	TRACE_END(BME280_COMPENSATE);
+}
+
+bool bme280_dev_read_sensor_data(bme280_dev_t *dev)
+{
+	if (!i2c_master_run(dev, dev->burst_cmd))
+	{
+		BME280_DEBUG_MSG("bme280_read_sensor_data_i2c: section 0xF3 error!\r\n");
+		return false;
+	}
+
+	bme280_compensate_burst(dev);
 	return true;
 }
+
+static uint32_t bme280_oversampling_count(uint8_t osrs)
+{
+	return osrs == BME280_NO_OVERSAMPLING ? 0 : 1 << (osrs > BME280_OVERSAMPLING_16X ? 4 : osrs - 1);
+}
+
+// Datasheet appendix B: t_measure,max = 1.25 + 2.3 * T + (2.3 * P + 0.575) + (2.3 * H + 0.575) ms,
+// a skipped measurement (oversampling 0) drops its whole term.
+uint32_t bme280_dev_get_measurement_time_us(const bme280_dev_t *dev)
+{
+	uint32_t osrs_t = bme280_oversampling_count(dev->config.osrs_t);
+	uint32_t osrs_p = bme280_oversampling_count(dev->config.osrs_p);
+	uint32_t osrs_h = bme280_dev_is_humidity_supported(dev) ? bme280_oversampling_count(dev->config.osrs_h) : 0;
+	uint32_t time_us = 1250 + 2300 * osrs_t;
+
+	if (osrs_p)
+	{
+		time_us += 2300 * osrs_p + 575;
+	}
+	if (osrs_h)
+	{
+		time_us += 2300 * osrs_h + 575;
+	}
+	return time_us;
+}
+
+static bme280_read_state_t bme280_complete_forced_read(bme280_dev_t *dev, bool success)
+{
+	dev->read_state = success ? BME280_READ_DONE : BME280_READ_ERROR;
+	if (dev->read_cb)
+	{
+		dev->read_cb(success, dev->read_cb_arg);
+	}
+	return dev->read_state;
+}
+
+bool bme280_dev_start_forced_read(bme280_dev_t *dev, bme280_read_cb_t cb, void *arg)
+{
+	uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+
+	if (dev->read_state == BME280_READ_MEASURING)
+	{
+		BME280_DEBUG_MSG("bme280_start_forced_read: read already in progress\r\n");
+		return false;
+	}
+
+	dev->read_cb = cb;
+	dev->read_cb_arg = arg;
+	if (!i2c_master_run(dev, dev->trigger_cmd))
+	{
+		BME280_DEBUG_MSG("bme280_start_forced_read: error!\r\n");
+		dev->read_state = BME280_READ_ERROR;
+		return false;
+	}
+
+	dev->read_ready_tick = xTaskGetTickCount() + (bme280_dev_get_measurement_time_us(dev) + tick_us - 1) / tick_us;
+	dev->read_state = BME280_READ_MEASURING;
+	return true;
+}
+
+bme280_read_state_t bme280_dev_poll_forced_read(bme280_dev_t *dev)
+{
+	if (dev->read_state != BME280_READ_MEASURING)
+	{
+		return dev->read_state;
+	}
+	if ((int32_t)(xTaskGetTickCount() - dev->read_ready_tick) < 0)
+	{
+		return BME280_READ_MEASURING;
+	}
+
+	// Status and data come in the same burst: while measuring, the data is the previous sample
+	if (!i2c_master_run(dev, dev->burst_cmd))
+	{
+		BME280_DEBUG_MSG("bme280_poll_forced_read: burst error!\r\n");
+		return bme280_complete_forced_read(dev, false);
+	}
+	if (dev->burst[0] & BME280_STATUS_MEASURING)
+	{
+		dev->read_ready_tick = xTaskGetTickCount() + 1;
+		return BME280_READ_MEASURING;
+	}
+
+	bme280_compensate_burst(dev);
+	return bme280_complete_forced_read(dev, true);
+}
+
+TickType_t bme280_dev_get_ready_tick(const bme280_dev_t *dev)
+{
+	return dev->read_ready_tick;
+}
+
+bme280_read_state_t bme280_dev_wait_forced_read(bme280_dev_t *dev)
+{
+	bme280_read_state_t state;
+
+	while ((state = bme280_dev_poll_forced_read(dev)) == BME280_READ_MEASURING)
+	{
+		TickType_t now = xTaskGetTickCount();
+		vTaskDelay((int32_t)(dev->read_ready_tick - now) > 0 ? dev->read_ready_tick - now : 1);
+	}
+	return state;
+}
+
+bool bme280_init(bme280_config_t config)
+{
+	return bme280_dev_init(&bme280_default_dev, config);
+}
+
+void bme280_dispose()
+{
+	bme280_dev_dispose(&bme280_default_dev);
+}
+
+bool bme280_trigger_forced_read()
+{
+	return bme280_dev_trigger_forced_read(&bme280_default_dev);
+}
+
+bool bme280_read_sensor_data()
+{
+	return bme280_dev_read_sensor_data(&bme280_default_dev);
+}
+
+uint32_t bme280_get_measurement_time_us()
+{
+	return bme280_dev_get_measurement_time_us(&bme280_default_dev);
+}
+
+bool bme280_start_forced_read(bme280_read_cb_t cb, void *arg)
+{
+	return bme280_dev_start_forced_read(&bme280_default_dev, cb, arg);
+}
+
+bme280_read_state_t bme280_poll_forced_read()
+{
+	return bme280_dev_poll_forced_read(&bme280_default_dev);
+}
+
+TickType_t bme280_get_ready_tick()
+{
+	return bme280_dev_get_ready_tick(&bme280_default_dev);
+}
+
+bme280_read_state_t bme280_wait_forced_read()
+{
+	return bme280_dev_wait_forced_read(&bme280_default_dev);
+}
+
+int32_t bme280_get_t_fine()
+{
+	return bme280_dev_get_t_fine(&bme280_default_dev);
+}
+
+int32_t bme280_get_temperature()
+{
+	return bme280_dev_get_temperature(&bme280_default_dev);
+}
+
+uint32_t bme280_get_pressure()
+{
+	return bme280_dev_get_pressure(&bme280_default_dev);
+}
+
+uint32_t bme280_get_humidity()
+{
+	return bme280_dev_get_humidity(&bme280_default_dev);
+}
+
+uint32_t bme280_get_temperature_raw()
+{
+	return bme280_dev_get_temperature_raw(&bme280_default_dev);
+}
+
+uint32_t bme280_get_tressure_raw()
+{
+	return bme280_dev_get_pressure_raw(&bme280_default_dev);
+}
+
+uint32_t bme280_get_humidity_raw()
+{
+	return bme280_dev_get_humidity_raw(&bme280_default_dev);
+}
+
+bool bme280_is_temperature_supported()
+{
+	return bme280_dev_is_temperature_supported(&bme280_default_dev);
+}
+
+bool bme280_is_pressure_supported()
+{
+	return bme280_dev_is_pressure_supported(&bme280_default_dev);
+}
+
+bool bme280_is_humidity_supported()
+{
+	return bme280_dev_is_humidity_supported(&bme280_default_dev);
+}
@@ -29,6 +29,12 @@ THE SOFTWARE.
 #ifndef __I2C_BME280_H
 #define __I2C_BME280_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c.h"
+
 #define BME280_I2C_MASTER_SCL_PIN_DEFAULT 5
 #define BME280_I2C_MASTER_SDA_PIN_DEFAULT 4
 
@@ -62,9 +68,23 @@ THE SOFTWARE.
 #define BMP280_CHIP_ID 0x58
 
 #define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_STATUS 0xF3
 #define BME280_REG_CTRL_MEAS 0xF4
 #define BME280_REG_CONFIG 0xF5
 
+#define BME280_REG_DATA 0xF7
+
+#define BME280_STATUS_MEASURING 0x08 // set while a conversion is running
+
+// One burst covers status, ctrl_meas, config, (0xF6), pressure, temperature and humidity: 0xF3..0xFE
+#define BME280_BURST_START BME280_REG_STATUS
+#define BME280_BURST_LEN 12
+#define BMP280_BURST_LEN 10
+
+// Samples compensated per pass by bme280_compensate_batch(), t_fine kept on the stack
+#define BME280_COMPENSATE_BLOCK 64
+
+#define BME280_MODE_SLEEP 0x00  // no conversions
 #define BME280_MODE_NORMAL 0x03 // reads sensors at set interval
 #define BME280_MODE_FORCED 0x01 // reads sensors once when you write this register
 
@@ -90,6 +110,17 @@ THE SOFTWARE.
         .spi3w_en = 0                                  \
     }
 
+typedef enum
+{
+    BME280_READ_IDLE = 0,  // no forced read started
+    BME280_READ_MEASURING, // conversion running, poll again later
+    BME280_READ_DONE,      // data read and compensated
+    BME280_READ_ERROR      // I2C error while triggering or reading
+} bme280_read_state_t;
+
+// Completion callback of bme280_start_forced_read(), called from the polling task
+typedef void (*bme280_read_cb_t)(bool success, void *arg);
+
 typedef struct
 {
     uint8_t gpio_scl;       // I2C SCl pin number
@@ -104,11 +135,139 @@ typedef struct
     uint8_t spi3w_en;       // 3-wire SPI Disable
 } bme280_config_t;
 
+// Trimming coefficients (datasheet 4.2.2), 16-bit words first so the struct packs without holes
+typedef struct
+{
+    uint16_t dig_T1;
+    int16_t dig_T2;
+    int16_t dig_T3;
+    uint16_t dig_P1;
+    int16_t dig_P2;
+    int16_t dig_P3;
+    int16_t dig_P4;
+    int16_t dig_P5;
+    int16_t dig_P6;
+    int16_t dig_P7;
+    int16_t dig_P8;
+    int16_t dig_P9;
+    int16_t dig_H2;
+    int16_t dig_H4;
+    int16_t dig_H5;
+    uint8_t dig_H1;
+    uint8_t dig_H3;
+    int8_t dig_H6;
+} bme280_calib_t;
+
+// Compensation of raw readings with given trimming coefficients, without a device: pure and
+// reentrant, for replaying logged raw samples. Temperature in 0.01 degC, pressure in Pa,
+// humidity in Q22.10 %RH, the same results as the bme280_dev_get_* values.
+// t_fine (fine temperature) comes from the temperature of the same reading; may be NULL.
+int32_t bme280_compensate_temperature(const bme280_calib_t *calib, int32_t adc_T, int32_t *t_fine);
+uint32_t bme280_compensate_pressure(const bme280_calib_t *calib, int32_t adc_P, int32_t t_fine);
+// 64-bit datasheet formula, pressure in Q24.8 Pa (1/256 Pa)
+uint32_t bme280_compensate_pressure64(const bme280_calib_t *calib, int32_t adc_P, int32_t t_fine);
+uint32_t bme280_compensate_humidity(const bme280_calib_t *calib, int32_t adc_H, int32_t t_fine);
+// count readings given as arrays, bit-exact with the functions above and written for the
+// compiler to vectorize. adc_P/pressure and adc_H/humidity may be NULL (BMP280), temperature too.
+void bme280_compensate_batch(const bme280_calib_t *calib, size_t count,
+                             const int32_t *adc_T, const int32_t *adc_P, const int32_t *adc_H,
+                             int32_t *temperature, uint32_t *pressure, uint32_t *humidity);
+
+// Trimming coefficients prepared once for bme280_compensate_fused(): widened to 32 bits, with the
+// constant shifts and offsets of the formulas folded in
+typedef struct
+{
+    int32_t t1, t1x2, t2, t3;
+    int32_t p1, p2, p3, p4s16, p5x2, p6, p7, p8, p9;
+    int32_t h1, h2, h3, h4s20, h5, h6; // h4s20 = (dig_H4 << 20) - 16384, the rounding term
+} bme280_comp_t;
+
+typedef struct
+{
+    int32_t t_fine;
+    int32_t temperature;
+    uint32_t pressure;
+    uint32_t humidity;
+} bme280_reading_t;
+
+void bme280_comp_init(const bme280_calib_t *calib, bme280_comp_t *comp);
+// One reading in one pass: temperature and t_fine first, then pressure and humidity with that
+// t_fine. Bit-exact with the functions above; adc_H < 0 skips humidity (BMP280), left 0.
+void bme280_compensate_fused(const bme280_comp_t *comp, int32_t adc_T, int32_t adc_P, int32_t adc_H,
+                             bme280_reading_t *reading);
+
+// Device context: one per sensor, all sensors share the I2C master (I2C_NUM_0).
+// The prebuilt command links point into the context: it must not move after init.
+typedef struct
+{
+    bme280_config_t config;
+    bme280_calib_t calib;
+    bme280_comp_t comp;           // from calib, by setup
+    uint8_t chip_id;
+
+    i2c_cmd_handle_t burst_cmd;   // status + data read, reused for every sample
+    i2c_cmd_handle_t trigger_cmd; // ctrl_meas write starting a forced conversion
+    uint8_t burst[BME280_BURST_LEN];
+    uint8_t trigger[2];
+
+    int32_t t_fine;
+    uint32_t temp_raw, pres_raw, hum_raw;
+    int32_t temp_act;
+    uint32_t press_act, hum_act;
+
+    bme280_read_state_t read_state;
+    TickType_t read_ready_tick;
+    bme280_read_cb_t read_cb;
+    void *read_cb_arg;
+} bme280_dev_t;
+
+bool bme280_dev_init(bme280_dev_t *dev, bme280_config_t config);
+// bme280_dev_init in two steps, for callers keeping the trimming coefficients across resets:
+// probe starts the bus and checks the chip ID (dev->chip_id), setup writes the configuration,
+// takes calib when given instead of reading it (3 transactions) and builds the commands.
+// On failure both leave the device disposed.
+bool bme280_dev_probe(bme280_dev_t *dev, bme280_config_t config);
+bool bme280_dev_setup(bme280_dev_t *dev, const bme280_calib_t *calib);
+// New oversampling, standby time and filter of a set-up device; pins, address and mode stay.
+// Not while a conversion is running. Leaves the sensor in sleep mode until the next trigger.
+// On failure the device has no commands: retry before triggering it again.
+bool bme280_dev_reconfigure(bme280_dev_t *dev, const bme280_config_t *config);
+void bme280_dev_dispose(bme280_dev_t *dev);
+bool bme280_dev_trigger_forced_read(bme280_dev_t *dev);
+bool bme280_dev_read_sensor_data(bme280_dev_t *dev);
+
+uint32_t bme280_dev_get_measurement_time_us(const bme280_dev_t *dev);
+bool bme280_dev_start_forced_read(bme280_dev_t *dev, bme280_read_cb_t cb, void *arg);
+bme280_read_state_t bme280_dev_poll_forced_read(bme280_dev_t *dev);
+TickType_t bme280_dev_get_ready_tick(const bme280_dev_t *dev);
+bme280_read_state_t bme280_dev_wait_forced_read(bme280_dev_t *dev);
+
+int32_t bme280_dev_get_t_fine(const bme280_dev_t *dev);
+int32_t bme280_dev_get_temperature(const bme280_dev_t *dev);
+uint32_t bme280_dev_get_pressure(const bme280_dev_t *dev);
+uint32_t bme280_dev_get_humidity(const bme280_dev_t *dev);
+uint32_t bme280_dev_get_temperature_raw(const bme280_dev_t *dev);
+uint32_t bme280_dev_get_pressure_raw(const bme280_dev_t *dev);
+uint32_t bme280_dev_get_humidity_raw(const bme280_dev_t *dev);
+bool bme280_dev_is_temperature_supported(const bme280_dev_t *dev);
+bool bme280_dev_is_pressure_supported(const bme280_dev_t *dev);
+bool bme280_dev_is_humidity_supported(const bme280_dev_t *dev);
+
+// Single-sensor API, operating on a default device context
 bool bme280_init(bme280_config_t config);
 void bme280_dispose();
 bool bme280_trigger_forced_read();
 bool bme280_read_sensor_data();
 
+// Non-blocking forced mode read: start, then poll until DONE or ERROR.
+// The bus is not touched before the datasheet maximum measurement time for the
+// configured oversampling has elapsed; after that the status register decides.
+uint32_t bme280_get_measurement_time_us();
+bool bme280_start_forced_read(bme280_read_cb_t cb, void *arg);
+bme280_read_state_t bme280_poll_forced_read();
+TickType_t bme280_get_ready_tick();
+bme280_read_state_t bme280_wait_forced_read();
+
 int32_t bme280_get_t_fine();
 int32_t bme280_get_temperature();
 uint32_t bme280_get_pressure();
@@ -13,6 +13,8 @@
 #include <string.h>
 #include "esp_wifi.h"
 #include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_event.h"
 #include "esp_netif.h"
@@ -22,7 +24,20 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
-#include "dht.h"
+#include "fixed_fmt.h"
+#include "sensors.h"
+#include "sample_aggregate.h"
+#include "sample_codec.h"
+#include "sample_filter.h"
+#include "sample_log.h"
+#include "sample_ring.h"
+#include "rtc_state.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "alloc_guard.h"
+#include "outbox_pool.h"
+#include "node_config.h"
+#include "node_time.h"
 
 #include "lwip/sockets.h"
 #include "lwip/dns.h"
@@ -33,30 +48,135 @@
 
 #define GOT_IPV4_BIT BIT(0)
 #define GOT_IPV6_BIT BIT(1)
+#define MQTT_CONNECTED_BIT BIT(2)
 #define CONNECTED_BITS (GOT_IPV4_BIT)
 
 #define DHT_GPIO 5 // D1 pin
+// Sampling periods adapt to the readings (sample_rate.h): the shortest while they move, growing up
+// to the longest while they are stable. A change beyond the thresholds is a transient.
+#define DHT_PERIOD_MS 5000
+#define DHT_MAX_PERIOD_MS 60000
+#define DHT_CHANGE_TEMPERATURE 100  // one DHT11 step, 1 degC
+#define DHT_CHANGE_HUMIDITY 200     // two steps, 2 %RH
+#define BME280_SCL_GPIO 14 // D5 pin, the default SCL pin is taken by the DHT
+#define BME280_SDA_GPIO 4  // D2 pin
+#define BME280_PERIOD_MS 5000
+#define BME280_MAX_PERIOD_MS 30000  // thresholds: the filter deadbands, a smaller change is not published
 #define WIFI_SSID   ""
 #define WIFI_PASS   ""
 #define BROKER_MQTT "mqtt://test.mosquitto.org"
+#define SNTP_SERVER "pool.ntp.org"  // samples are stamped in Unix time once synchronized (node_time.h)
+#define SAMPLES_TOPIC "mestrado/iot/aluno/yan/amostras"
+#define HISTORY_TOPIC "mestrado/iot/aluno/yan/historico"
+#define DIAGNOSTICS_TOPIC "mestrado/iot/aluno/yan/diagnostico"
+#define TELEMETRY_PERIOD_S 300      // self-metrics on DIAGNOSTICS_TOPIC (telemetry.h), 0 to disable
+#define TRACE_TOPIC "mestrado/iot/aluno/yan/trace"
+#define SUMMARY_TOPIC "mestrado/iot/aluno/yan/resumo"
+// Settings changed at run time (node_config.h), stored in NVS: publish them retained on CONFIG_TOPIC
+// to reach nodes in deep sleep too. Each message is answered with every setting on CONFIG_STATE_TOPIC.
+#define CONFIG_TOPIC "mestrado/iot/aluno/yan/configuracao"
+#define CONFIG_STATE_TOPIC "mestrado/iot/aluno/yan/configuracao/estado"
+#define TRACE_DUMP_PERIOD_S 30      // with TRACE_ENABLED: trace dumps (trace.h) on TRACE_TOPIC, on the UART offline
+// Samples are published as binary batches (sample_codec.h) on SAMPLES_TOPIC, sent once
+// PUBLISH_BATCH_SIZE samples are pending or the oldest is PUBLISH_FLUSH_INTERVAL_S old.
+// 0 publishes every reading as text on one topic per value instead.
+#define PUBLISH_BATCH_SIZE 6
+#define PUBLISH_FLUSH_INTERVAL_S 60
+#define LOG_DRAIN_BATCH 12          // samples per backlog message, as many as fit an outbox slot
+#define LOG_DRAIN_MAX_BATCHES 32    // per sampling period, so sampling goes on while draining
+#define LOG_DRAIN_IN_FLIGHT (OUTBOX_POOL_SLOTS - 2) // unacknowledged messages, room left for live batches
+#define SAMPLE_PERIOD_MS 10000     // publisher wake-up when no sample comes, to drain the log
+#define SAMPLER_PRIORITY (tskIDLE_PRIORITY + 6)   // above the MQTT and publisher tasks: keeps the periods
+#define PUBLISHER_PRIORITY (tskIDLE_PRIORITY + 1)
+#define PIPELINE_STATS_EVERY 60                    // samples between two pipeline counter reports
+// Filtering stage (sample_filter.h): a sample is only published when a value moved by its deadband
+// since the last one published, or after the heartbeat
+#define FILTER_EWMA_SHIFT 2                 // smoothing factor 1/4
+#define FILTER_DEADBAND_TEMPERATURE 20      // 0.2 degC
+#define FILTER_DEADBAND_HUMIDITY 100        // 1 %RH
+#define FILTER_DEADBAND_PRESSURE 20         // 0.2 hPa
+#define FILTER_HEARTBEAT_S 600
+// Aggregation stage (sample_aggregate.h), in place of the filtering stage: the readings of each sensor
+// are published as one summary per window on SUMMARY_TOPIC (minimum, maximum, mean, standard deviation),
+// and a reading departing from the window mean by its breach threshold is also published raw, at once.
+// 0 publishes the readings through the filtering stage instead. Awake mode only: the duty cycle keeps
+// filtering, a window would have to survive deep sleep and does not fit in the RTC_STATE_HEADROOM bytes
+// left in RTC memory (asserted below).
+#define AGGREGATE_WINDOW_S 60
+#define AGGREGATE_BREACH_TEMPERATURE 200    // 2 degC
+#define AGGREGATE_BREACH_HUMIDITY 1000      // 10 %RH
+#define AGGREGATE_BREACH_PRESSURE 200       // 2 hPa
+#define AGGREGATE_SENSORS 4                 // sensors with a window, others are published raw
+// Duty cycle mode: app_main reads every sensor once per wake and deep sleeps DEEP_SLEEP_PERIOD_S
+// between wakes, keeping the pending batch in RTC memory; Wi-Fi only comes up when a batch is due.
+// Needs GPIO16 wired to RST. 0 stays awake and samples from sampler_task on the sensor periods.
+#define DEEP_SLEEP_PERIOD_S 0
+#define DUTY_CYCLE_CONNECT_TIMEOUT_MS 10000 // Wi-Fi and broker, the batch is logged after that
+#define DUTY_CYCLE_ACK_TIMEOUT_MS 3000      // PUBACKs awaited before sleeping
+#define DUTY_CYCLE_SNTP_TIMEOUT_MS 1500     // SNTP answer awaited from the connection, when a sync is due
 
 static const char *TAG = "APP_MAIN";
 static EventGroupHandle_t s_connect_event_group;
 static ip4_addr_t s_ip_addr;
-void temperature_task(void *arg);
+static void sampler_task(void *arg);
+static void publisher_task(void *arg);
+static void config_defaults(node_config_t *config);
 static esp_mqtt_client_handle_t client = NULL;
 static bool mqtt_connected = false;
+static volatile uint32_t mqtt_published, mqtt_acked; // QoS 1 messages sent and acknowledged
+static rtc_state_t s_rtc_state;
+// Sampling and publishing run in separate tasks, so a slow publish cannot delay the next sample.
+// sampler_task -> s_sample_ring (lock-free) -> publisher_task, which owns MQTT and the sample log.
+static sample_ring_t s_sample_ring;
+static SemaphoreHandle_t s_samples_ready;
+static uint32_t s_samples_filtered; // samples the filtering stage found nothing new in
+static uint32_t s_summaries, s_samples_breached; // aggregation stage windows closed, readings passed on raw
+static TaskHandle_t s_sampler_task, s_publisher_task, s_mqtt_task;
+// Loop bodies that must not touch the heap once running, checked with ALLOC_GUARD_ENABLED
+static alloc_guard_t s_sampler_guard = ALLOC_GUARD_INIT("sampler_task");
+static alloc_guard_t s_publisher_guard = ALLOC_GUARD_INIT("publisher_task");
+// Running settings (node_config.h) as last applied: filtering by the sampling side, the rest by the publisher
+static sample_filter_config_t s_filter_config;
+static bool s_aggregating; // the sampling side hands every reading over, unfiltered
+static node_config_t s_publish_config;
+static sample_aggregate_config_t s_aggregate_config;
+static sample_aggregate_t s_aggregates[AGGREGATE_SENSORS]; // publisher side
 
 static void start(void);
 static esp_err_t example_connect(void);
+#if DEEP_SLEEP_PERIOD_S > 0
+static void duty_cycle(bool warm);
+#endif
 static void on_got_ip(void *arg, esp_event_base_t event_base,
                       int32_t event_id, void *event_data)
 {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     memcpy(&s_ip_addr, &event->ip_info.ip, sizeof(s_ip_addr));
+
+    // Next boot connects to this AP directly, without scanning every channel
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        memcpy(s_rtc_state.wifi_bssid, ap.bssid, sizeof(s_rtc_state.wifi_bssid));
+        s_rtc_state.wifi_channel = ap.primary;
+        rtc_state_save(&s_rtc_state);
+    }
     xEventGroupSetBits(s_connect_event_group, GOT_IPV4_BIT);
 }
 
+static void wifi_set_config(void)
+{
+    wifi_config_t wifi_config = { 0 };
+
+    strncpy((char *)&wifi_config.sta.ssid, WIFI_SSID, 32);
+    strncpy((char *)&wifi_config.sta.password, WIFI_PASS, 32);
+    if (s_rtc_state.wifi_channel) {
+        wifi_config.sta.bssid_set = 1;
+        memcpy(wifi_config.sta.bssid, s_rtc_state.wifi_bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = s_rtc_state.wifi_channel;
+    }
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+}
+
 static void on_wifi_disconnect(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
@@ -67,35 +187,67 @@ static void on_wifi_disconnect(void *arg, esp_event_base_t event_base,
         /*Switch to 802.11 bgn mode */
         esp_wifi_set_protocol(ESP_IF_WIFI_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
     }
+    if (s_rtc_state.wifi_channel) {
+        // The cached AP did not answer: forget it and scan
+        s_rtc_state.wifi_channel = 0;
+        wifi_set_config();
+    }
     ESP_ERROR_CHECK(esp_wifi_connect());
 }
 
+/* A message on CONFIG_TOPIC, from the MQTT task: the tasks pick the new settings up on their next pass. */
+static void config_received(esp_mqtt_client_handle_t client, esp_mqtt_event_handle_t event)
+{
+    uint8_t state[NODE_CONFIG_MAX_SIZE];
+    node_config_t config;
+
+    // Settings messages are small: one that comes in fragments is not one
+    esp_err_t err = event->data_len == event->total_data_len ?
+                    node_config_update((const uint8_t *)event->data, event->data_len) : ESP_ERR_INVALID_SIZE;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Settings message rejected (0x%x)", err);
+    }
+    node_config_get(&config);
+    size_t len = node_config_encode(&config, state, sizeof(state));
+    esp_mqtt_client_publish(client, CONFIG_STATE_TOPIC, (const char *)state, len, 0, 0);
+}
+
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 {
     esp_mqtt_client_handle_t client = event->client;
-    int msg_id;
     // your_context_t *context = event->context;
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            // Events are dispatched from the client's own task
+            s_mqtt_task = xTaskGetCurrentTaskHandle();
             mqtt_connected = true;
+            esp_mqtt_client_subscribe(client, CONFIG_TOPIC, 1);
+            xEventGroupSetBits(s_connect_event_group, MQTT_CONNECTED_BIT);
+            break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+            mqtt_connected = false;
+            xEventGroupClearBits(s_connect_event_group, MQTT_CONNECTED_BIT);
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-            msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
-            ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
             break;
         case MQTT_EVENT_UNSUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            mqtt_acked++;
             break;
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
+            if (event->topic_len == sizeof(CONFIG_TOPIC) - 1 &&
+                memcmp(event->topic, CONFIG_TOPIC, event->topic_len) == 0) {
+                config_received(client, event);
+                break;
+            }
             printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
             printf("DATA=%.*s\r\n", event->data_len, event->data);
             break;
@@ -140,16 +292,36 @@ void app_main(void)
     esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
     
     ESP_ERROR_CHECK(nvs_flash_init());
+    node_config_t defaults;
+    config_defaults(&defaults);
+    node_config_init(&defaults);
+    esp_err_t err = sample_log_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Offline sample log unavailable (0x%x), samples taken offline will be lost", err);
+    }
+    bool warm = rtc_state_load(&s_rtc_state);
+    s_rtc_state.boot_count++;
+    node_time_init(&s_rtc_state.time, warm && esp_reset_reason() == ESP_RST_DEEPSLEEP);
+    ESP_LOGI(TAG, "[APP] Boot %u since power on, RTC state %s, reset reason %d",
+             s_rtc_state.boot_count, warm ? "kept" : "lost", esp_reset_reason());
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+#if DEEP_SLEEP_PERIOD_S > 0
+    duty_cycle(warm);
+#endif
+
     /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig.
      * Read "Establishing Wi-Fi or Ethernet Connection" section in
      * examples/protocols/README.md for more information about this function.
      */
     ESP_ERROR_CHECK(example_connect());
+    node_time_sntp_start(SNTP_SERVER);
 
-    xTaskCreate(temperature_task, "temperature task", 2048, NULL, tskIDLE_PRIORITY, NULL);
+    sample_ring_init(&s_sample_ring);
+    s_samples_ready = xSemaphoreCreateBinary();
+    xTaskCreate(sampler_task, "sampler", 2048, NULL, SAMPLER_PRIORITY, &s_sampler_task);
+    xTaskCreate(publisher_task, "publisher", 3072, NULL, PUBLISHER_PRIORITY, &s_publisher_task);
 
     mqtt_app_start();
 }
@@ -184,45 +356,700 @@ static void start(void)
 #endif    
 
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
-    wifi_config_t wifi_config = { 0 };
 
-    strncpy((char *)&wifi_config.sta.ssid, WIFI_SSID, 32);
-    strncpy((char *)&wifi_config.sta.password, WIFI_PASS, 32);
-
-    ESP_LOGI(TAG, "Connecting to %s...", wifi_config.sta.ssid);
+    ESP_LOGI(TAG, "Connecting to %s%s...", WIFI_SSID, s_rtc_state.wifi_channel ? " (cached AP)" : "");
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+    wifi_set_config();
     ESP_ERROR_CHECK(esp_wifi_start());
     ESP_ERROR_CHECK(esp_wifi_connect());
 }
 
-void temperature_task(void *arg)
+static int mqtt_publish(const char *topic, const char *data, int len, int qos)
+{
+    TRACE_BEGIN(MQTT_PUBLISH);
+    int msg_id = esp_mqtt_client_publish(client, topic, data, len, qos, 0);
+    TRACE_END(MQTT_PUBLISH);
+    if (msg_id >= 0 && qos > 0) {
+        mqtt_published++;
+    }
+    return msg_id;
+}
+
+/* QoS 1 messages the MQTT client still holds for retransmission, 0 without the outbox pool. */
+static uint32_t mqtt_in_flight(void)
+{
+    outbox_pool_stats_t stats;
+
+    outbox_pool_get_stats(&stats);
+    return stats.in_use;
+}
+
+/* Keep samples that could not be published in the offline log. */
+static void log_samples(const sensor_sample_t *samples, size_t count)
+{
+    TRACE_BEGIN(LOG_APPEND);
+    for (size_t i = 0; i < count; i++) {
+        if (sample_log_append(&samples[i]) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not log offline sample");
+            break;
+        }
+    }
+    TRACE_END(LOG_APPEND);
+}
+
+#if PUBLISH_BATCH_SIZE > 0
+static bool publish_samples(const sensor_sample_t *samples, size_t count)
+{
+    static uint8_t payload[SAMPLE_CODEC_BATCH_SIZE(RTC_STATE_BATCH_MAX)];
+
+    size_t len = sample_codec_encode(samples, count, payload, sizeof(payload));
+    return len > 0 && mqtt_publish(SAMPLES_TOPIC, (const char *)payload, len, s_publish_config.qos) >= 0;
+}
+#else
+static bool publish_samples(const sensor_sample_t *samples, size_t count)
+{
+    char convertido[FIXED_FMT_MAX_LEN];
+    bool published = true;
+
+    for (size_t i = 0; i < count; i++) {
+        const sensor_sample_t *sample = &samples[i];
+        if (sample->flags & SAMPLE_HAS_HUMIDITY) {
+            fixed_fmt(convertido, sample->humidity, 2);
+            published &= mqtt_publish("mestrado/iot/aluno/yan/umidade", convertido, 0, s_publish_config.qos) >= 0;
+        }
+        if (sample->flags & SAMPLE_HAS_TEMPERATURE) {
+            fixed_fmt(convertido, sample->temperature, 2);
+            published &= mqtt_publish("mestrado/iot/aluno/yan/temperatura", convertido, 0, s_publish_config.qos) >= 0;
+        }
+        if (sample->flags & SAMPLE_HAS_PRESSURE) {
+            fixed_fmt(convertido, sample->pressure, 2); // hPa
+            published &= mqtt_publish("mestrado/iot/aluno/yan/pressao", convertido, 0, s_publish_config.qos) >= 0;
+        }
+    }
+    return published;
+}
+#endif
+
+_Static_assert(PUBLISH_BATCH_SIZE <= NODE_CONFIG_BATCH_MAX, "the default batch must be a valid setting");
+_Static_assert(NODE_CONFIG_BATCH_MAX <= RTC_STATE_BATCH_MAX, "a batch must fit in RTC memory");
+_Static_assert((int)sizeof(sample_aggregate_t) > RTC_STATE_HEADROOM,
+               "a window fits in RTC memory: the duty cycle could aggregate");
+_Static_assert(OUTBOX_POOL_PUBLISH_SIZE(sizeof(SAMPLES_TOPIC) - 1, SAMPLE_CODEC_BATCH_SIZE(RTC_STATE_BATCH_MAX)) <=
+               OUTBOX_POOL_SLOT_SIZE, "a batch must fit in an outbox slot");
+_Static_assert(OUTBOX_POOL_PUBLISH_SIZE(sizeof(HISTORY_TOPIC) - 1, SAMPLE_CODEC_BATCH_SIZE(LOG_DRAIN_BATCH)) <=
+               OUTBOX_POOL_SLOT_SIZE, "a backlog message must fit in an outbox slot");
+_Static_assert(OUTBOX_POOL_PUBLISH_SIZE(sizeof(SUMMARY_TOPIC) - 1, SAMPLE_SUMMARY_MAX_SIZE) <= OUTBOX_POOL_SLOT_SIZE,
+               "a summary must fit in an outbox slot");
+_Static_assert(AGGREGATE_WINDOW_S <= NODE_CONFIG_WINDOW_MAX_S, "the default window must be a valid setting");
+
+static sensor_sample_t publish_batch[NODE_CONFIG_BATCH_MAX];
+static size_t publish_batch_count;
+static uint32_t publish_batch_started_s; // node clock when the first sample was queued
+
+/* By node clock: sample timestamps switch to Unix time when the clock gets synchronized. */
+static bool batch_due_at(uint32_t now_s, uint32_t started_s, size_t count)
+{
+    return count >= s_publish_config.batch_size ||
+           (count > 0 && now_s - started_s >= s_publish_config.flush_interval_s);
+}
+
+static bool batch_due(uint32_t started_s, size_t count)
+{
+    return batch_due_at(node_time_clock(), started_s, count);
+}
+
+static void publish_flush(void)
+{
+    TRACE_BEGIN(PUBLISH_FLUSH);
+    if (!mqtt_connected || !publish_samples(publish_batch, publish_batch_count)) {
+        log_samples(publish_batch, publish_batch_count);
+    }
+    publish_batch_count = 0;
+    TRACE_END(PUBLISH_FLUSH);
+}
+
+static void publish_sample(const sensor_sample_t *sample)
+{
+    if (publish_batch_count == 0) {
+        publish_batch_started_s = node_time_clock();
+    }
+    publish_batch[publish_batch_count++] = *sample;
+    if (batch_due(publish_batch_started_s, publish_batch_count)) {
+        publish_flush();
+    }
+}
+
+/* Summary of a window on SUMMARY_TOPIC; the log only holds samples, so it keeps the means when offline. */
+static void publish_summary(sample_aggregate_t *aggregate)
+{
+    uint8_t payload[SAMPLE_SUMMARY_MAX_SIZE];
+    sample_summary_t summary;
+
+    if (!sample_aggregate_close(aggregate, &summary)) {
+        return;
+    }
+    s_summaries++;
+    size_t len = sample_summary_encode(&summary, payload, sizeof(payload));
+    if (!mqtt_connected || mqtt_publish(SUMMARY_TOPIC, (const char *)payload, len, s_publish_config.qos) < 0) {
+        sensor_sample_t means;
+        sample_summary_mean(&summary, &means);
+        log_samples(&means, 1);
+    }
+}
+
+/* Aggregation stage: the reading goes into the window of its sensor, closed first when its time is up. */
+static void aggregate_sample(const sensor_sample_t *sample)
+{
+    sample_aggregate_t *aggregate = sample_aggregate_get(s_aggregates, AGGREGATE_SENSORS, sample->sensor);
+    uint32_t now_s = node_time_clock();
+
+    // A sensor beyond AGGREGATE_SENSORS is published raw
+    if (!aggregate) {
+        publish_sample(sample);
+        return;
+    }
+    if (sample_aggregate_due(aggregate, &s_aggregate_config, now_s, sample)) {
+        publish_summary(aggregate);
+    }
+    if (sample_aggregate_add(aggregate, &s_aggregate_config, sample, now_s)) {
+        s_samples_breached++;
+        publish_sample(sample);
+        if (publish_batch_count > 0) {
+            publish_flush();
+        }
+    }
+}
+
+/* Windows whose time is up, or all of them when the window changes. */
+static void aggregate_close(bool all)
+{
+    uint32_t now_s = node_time_clock();
+
+    for (size_t i = 0; i < AGGREGATE_SENSORS; i++) {
+        if (all || sample_aggregate_due(&s_aggregates[i], &s_aggregate_config, now_s, NULL)) {
+            publish_summary(&s_aggregates[i]);
+        }
+    }
+}
+
+static void aggregate_config_from(const node_config_t *config)
+{
+    s_aggregate_config.window_s = config->aggregate_window_s;
+    for (int i = 0; i < SAMPLE_AGGREGATE_CHANNELS; i++) {
+        s_aggregate_config.breach[i] = config->breach[i];
+    }
+}
+
+/* Upload samples stored while offline, oldest first, in the SAMPLES_TOPIC batch format. */
+static void drain_sample_log(void)
 {
-    ESP_ERROR_CHECK(dht_init(DHT_GPIO, true));
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-    char convertido[16];
+    static sensor_sample_t batch[LOG_DRAIN_BATCH];
+    static uint8_t payload[SAMPLE_CODEC_BATCH_SIZE(LOG_DRAIN_BATCH)];
+
+    TRACE_BEGIN(LOG_DRAIN);
+    for (int i = 0; i < LOG_DRAIN_MAX_BATCHES && mqtt_connected && mqtt_in_flight() < LOG_DRAIN_IN_FLIGHT; i++) {
+        size_t count = sample_log_peek(batch, LOG_DRAIN_BATCH);
+        if (count == 0) {
+            break;
+        }
+        size_t len = sample_codec_encode(batch, count, payload, sizeof(payload));
+        if (mqtt_publish(HISTORY_TOPIC, (const char *)payload, len, s_publish_config.qos) < 0) {
+            break;
+        }
+        if (sample_log_mark_sent(count) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not mark %u logged samples as sent", (unsigned)count);
+            break;
+        }
+    }
+    if (sample_log_pending() == 0 && sample_log_dropped() > 0) {
+        ESP_LOGW(TAG, "Backlog uploaded, %u samples were lost to a full log", sample_log_dropped());
+    }
+    TRACE_END(LOG_DRAIN);
+}
+
+/* The settings the firmware is built with, that CONFIG_TOPIC messages change. */
+static void config_defaults(node_config_t *config)
+{
+    const bme280_config_t bme280 = bme280_config_default;
+
+    *config = (node_config_t){
+        .dht_period_ms = DHT_PERIOD_MS,
+        .dht_max_period_ms = DHT_MAX_PERIOD_MS,
+        .bme280_period_ms = BME280_PERIOD_MS,
+        .bme280_max_period_ms = BME280_MAX_PERIOD_MS,
+        .bme280_osrs_t = bme280.osrs_t,
+        .bme280_osrs_p = bme280.osrs_p,
+        .bme280_osrs_h = bme280.osrs_h,
+        .bme280_filter = bme280.filter,
+        .deadband = { FILTER_DEADBAND_TEMPERATURE, FILTER_DEADBAND_HUMIDITY, FILTER_DEADBAND_PRESSURE },
+        .ewma_shift = FILTER_EWMA_SHIFT,
+        .heartbeat_s = FILTER_HEARTBEAT_S,
+        .batch_size = PUBLISH_BATCH_SIZE > 0 ? PUBLISH_BATCH_SIZE : 1,
+        .flush_interval_s = PUBLISH_FLUSH_INTERVAL_S,
+        .qos = 1,
+        .telemetry_period_s = TELEMETRY_PERIOD_S,
+        .aggregate_window_s = DEEP_SLEEP_PERIOD_S > 0 ? 0 : AGGREGATE_WINDOW_S,
+        .breach = { AGGREGATE_BREACH_TEMPERATURE, AGGREGATE_BREACH_HUMIDITY, AGGREGATE_BREACH_PRESSURE },
+    };
+}
+
+/* Sampling settings of a sensor of the given type, pins and model left out. */
+static void sensor_config_from(const node_config_t *config, sample_sensor_t type, sensor_config_t *sensor)
+{
+    *sensor = (sensor_config_t){ .type = type };
+    if (type == SAMPLE_SENSOR_DHT) {
+        sensor->period_ms = config->dht_period_ms;
+        sensor->max_period_ms = config->dht_max_period_ms;
+        sensor->change[0] = DHT_CHANGE_TEMPERATURE;
+        sensor->change[1] = DHT_CHANGE_HUMIDITY;
+    } else {
+        sensor->period_ms = config->bme280_period_ms;
+        sensor->max_period_ms = config->bme280_max_period_ms;
+        memcpy(sensor->change, config->deadband, sizeof(sensor->change));
+        sensor->bme280 = (bme280_config_t)bme280_config_default;
+        sensor->bme280.osrs_t = config->bme280_osrs_t;
+        sensor->bme280.osrs_p = config->bme280_osrs_p;
+        sensor->bme280.osrs_h = config->bme280_osrs_h;
+        sensor->bme280.filter = config->bme280_filter;
+    }
+}
+
+static void filter_config_from(const node_config_t *config)
+{
+    s_filter_config.ewma_shift = config->ewma_shift;
+    for (int i = 0; i < SAMPLE_FILTER_CHANNELS; i++) {
+        s_filter_config.deadband[i] = config->deadband[i];
+    }
+    s_filter_config.heartbeat_s = config->heartbeat_s;
+    s_aggregating = DEEP_SLEEP_PERIOD_S == 0 && config->aggregate_window_s > 0;
+}
+
+/* The sensors of the node, see sensors.h, with the running settings. */
+static void sensors_setup(bool warm, const node_config_t *config)
+{
+    sensor_config_t dht, bme280;
+
+    sensor_config_from(config, SAMPLE_SENSOR_DHT, &dht);
+    dht.dht.model = DHT_TYPE_DHT11;
+    dht.dht.gpio = DHT_GPIO;
+    sensor_config_from(config, SAMPLE_SENSOR_BME280, &bme280);
+    bme280.bme280.gpio_scl = BME280_SCL_GPIO;
+    bme280.bme280.gpio_sda = BME280_SDA_GPIO;
+
+    ESP_ERROR_CHECK(sensors_add(&dht));
+    ESP_ERROR_CHECK(sensors_add(&bme280));
+    ESP_LOGI(TAG, "%u sensors in use", (unsigned)sensors_init(warm));
+    filter_config_from(config);
+}
+
+/* New settings on the sampling side, between two sensors_run calls. */
+static void sampler_reconfigure(const node_config_t *config)
+{
+    for (size_t i = 0; i < sensors_count(); i++) {
+        sensor_config_t sensor;
+        sensor_config_from(config, SAMPLE_SENSOR_TYPE(sensors_get_stats(i)->sensor), &sensor);
+        ESP_ERROR_CHECK(sensors_configure(i, &sensor));
+    }
+    filter_config_from(config);
+}
+
+/* Stamp a new sample and print it. */
+static void sample_taken(sensor_sample_t *sample)
+{
+    char text[3][FIXED_FMT_MAX_LEN] = { "-", "-", "-" };
+
+    node_time_stamp(sample);
+    s_rtc_state.sample_seq++;
+    if (sample->flags & SAMPLE_HAS_TEMPERATURE) {
+        fixed_fmt(text[0], sample->temperature, 2);
+    }
+    if (sample->flags & SAMPLE_HAS_HUMIDITY) {
+        fixed_fmt(text[1], sample->humidity, 2);
+    }
+    if (sample->flags & SAMPLE_HAS_PRESSURE) {
+        fixed_fmt(text[2], sample->pressure, 2); // hPa
+    }
+    printf("Sensor %u: Temperature: %s Humidity: %s Pressure: %s\n", sample->sensor, text[0], text[1], text[2]);
+}
+
+/* Filtering stage, state in RTC memory: false when the sample is not worth publishing. */
+static bool filter_sample(sensor_sample_t *sample)
+{
+    sample_filter_t *filter = sample_filter_get(s_rtc_state.filters, RTC_STATE_FILTERS, sample->sensor);
+
+    // A sensor beyond RTC_STATE_FILTERS is published unfiltered
+    if (filter && !sample_filter_apply(filter, &s_filter_config, sample)) {
+        s_samples_filtered++;
+        return false;
+    }
+    return true;
+}
+
+/* Time spent in one pipeline stage, per sample. */
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint16_t histogram[TELEMETRY_LATENCY_BUCKETS];
+} stage_latency_t;
+
+static struct
+{
+    stage_latency_t read;       // sensors_run calls, sampler side
+    stage_latency_t queue;      // from the end of the read to the publisher picking the sample up
+    stage_latency_t publish;    // batching, publishing or logging, publisher side
+    uint64_t publisher_busy_us; // publisher_task work, samples, backlog and telemetry
+} s_pipeline_stats;
+
+static void stage_latency_add(stage_latency_t *stage, uint32_t us)
+{
+    uint16_t *bucket = &stage->histogram[telemetry_latency_bucket(us)];
+
+    stage->count++;
+    stage->total_us += us;
+    if (us > stage->max_us) {
+        stage->max_us = us;
+    }
+    if (*bucket < UINT16_MAX) {
+        (*bucket)++;
+    }
+}
+
+static void log_pipeline_stats(void)
+{
+    const stage_latency_t *read = &s_pipeline_stats.read;
+    const stage_latency_t *queue = &s_pipeline_stats.queue;
+    const stage_latency_t *publish = &s_pipeline_stats.publish;
+
+    for (size_t i = 0; i < sensors_count(); i++) {
+        const sensor_stats_t *stats = sensors_get_stats(i);
+        ESP_LOGI(TAG, "Sensor %u: %u samples, %u errors, %u periods missed, late max %u ms, period %u ms",
+                 (unsigned)i, stats->samples, stats->errors, stats->missed, stats->late_max_ms, stats->period_ms);
+        if (stats->retries || stats->lost) {
+            ESP_LOGI(TAG, "Sensor %u: %u retries, %u recovered, %u periods lost", (unsigned)i, stats->retries,
+                     stats->recovered, stats->lost);
+        }
+        for (int cause = 0; cause < DHT_ERR_COUNT; cause++) {
+            if (stats->dht_failures[cause]) {
+                ESP_LOGW(TAG, "Sensor %u: %u reads failed, %s", (unsigned)i, stats->dht_failures[cause],
+                         dht_err_to_name(ESP_ERR_DHT_BASE + 1 + cause));
+            }
+        }
+    }
+    ESP_LOGI(TAG, "Pipeline: %u samples filtered out, %u dropped, %u summaries, %u readings passed on raw",
+             s_samples_filtered, s_sample_ring.overruns, s_summaries, s_samples_breached);
+    ESP_LOGI(TAG, "Pipeline avg/max us: read %u/%u, queue %u/%u, publish %u/%u",
+             (unsigned)(read->total_us / (read->count ? read->count : 1)), read->max_us,
+             (unsigned)(queue->total_us / (queue->count ? queue->count : 1)), queue->max_us,
+             (unsigned)(publish->total_us / (publish->count ? publish->count : 1)), publish->max_us);
+
+    outbox_pool_stats_t outbox;
+    outbox_pool_get_stats(&outbox);
+    ESP_LOGI(TAG, "MQTT outbox: %u of %u slots in use, %u at most, %u messages kept, %u overflows",
+             outbox.in_use, OUTBOX_POOL_SLOTS, outbox.in_use_max, outbox.enqueued, outbox.overflows);
+#if ALLOC_GUARD_ENABLED
+    ESP_LOGI(TAG, "Heap: %u allocations since boot, %u in the sampler loop, %u in the publisher loop",
+             alloc_guard_total(), s_sampler_guard.violations, s_publisher_guard.violations);
+#endif
+}
+
+static void telemetry_add_task(telemetry_t *t, telemetry_task_id_t id, TaskHandle_t task, uint64_t busy_us)
+{
+    if (task) {
+        telemetry_task_t *entry = &t->tasks[t->task_count++];
+        entry->id = id;
+        entry->stack_free = uxTaskGetStackHighWaterMark(task);
+        entry->busy_us = (uint32_t)busy_us;
+    }
+}
+
+/* Self-metrics on DIAGNOSTICS_TOPIC, from publisher_task. */
+static void publish_telemetry(void)
+{
+    telemetry_t t = {
+        .uptime_s = xTaskGetTickCount() / configTICK_RATE_HZ,
+        .free_heap = esp_get_free_heap_size(),
+        .min_free_heap = esp_get_minimum_free_heap_size(),
+        .run_max_ms = s_pipeline_stats.read.max_us / 1000,
+        .queue_max_ms = s_pipeline_stats.queue.max_us / 1000,
+        .filtered = s_samples_filtered,
+        .dropped = s_sample_ring.overruns,
+    };
+    uint8_t payload[TELEMETRY_MAX_SIZE];
+
+    // Busy time of the MQTT task is not measured: CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS is off
+    telemetry_add_task(&t, TELEMETRY_TASK_SAMPLER, s_sampler_task, s_pipeline_stats.read.total_us);
+    telemetry_add_task(&t, TELEMETRY_TASK_PUBLISHER, s_publisher_task, s_pipeline_stats.publisher_busy_us);
+    telemetry_add_task(&t, TELEMETRY_TASK_MQTT, s_mqtt_task, 0);
+    for (size_t i = 0; i < sensors_count(); i++) {
+        const sensor_stats_t *stats = sensors_get_stats(i);
+        bool dht = SAMPLE_SENSOR_TYPE(stats->sensor) == SAMPLE_SENSOR_DHT;
+        if (dht && stats->critical_max_us > t.dht_critical_max_us) {
+            t.dht_critical_max_us = stats->critical_max_us;
+        } else if (!dht && stats->busy_max_us > t.i2c_max_us) {
+            t.i2c_max_us = stats->busy_max_us;
+        }
+        if (stats->late_max_ms > t.late_max_ms) {
+            t.late_max_ms = stats->late_max_ms;
+        }
+        t.samples += stats->samples;
+        t.errors += stats->errors;
+    }
+    memcpy(t.publish_latency, s_pipeline_stats.publish.histogram, sizeof(t.publish_latency));
+
+    size_t len = telemetry_encode(&t, payload, sizeof(payload));
+    if (len > 0) {
+        // QoS 0: the next report supersedes a lost one, and the outbox keeps no copy
+        mqtt_publish(DIAGNOSTICS_TOPIC, (const char *)payload, len, 0);
+    }
+}
+
+#if TRACE_ENABLED
+/* Trace dump on TRACE_TOPIC, or on the console while the broker is unreachable. */
+static void publish_trace(void)
+{
+    static uint8_t dump[TRACE_DUMP_MAX_SIZE];
+
+    if (!mqtt_connected) {
+        trace_print();
+        return;
+    }
+    size_t len = trace_dump(dump, sizeof(dump));
+    if (len > 0) {
+        mqtt_publish(TRACE_TOPIC, (const char *)dump, len, 0); // larger than an outbox slot
+    }
+}
+#endif
+
+static void sampler_push(sensor_sample_t *sample, void *arg)
+{
+    sample_taken(sample);
+    if (!s_aggregating && !filter_sample(sample)) {
+        return;
+    }
+    if (sample_ring_push(&s_sample_ring, sample, (uint32_t)esp_timer_get_time())) {
+        xSemaphoreGive(s_samples_ready);
+    }
+}
+
+/* Runs the sensors on their periods and hands the samples over. */
+static void sampler_task(void *arg)
+{
+    node_config_t config;
+    uint32_t generation = node_config_get(&config);
+
+    sensors_setup(false, &config);
 
     while (1)
     {
-        float humidity = 0;
-        float temperature = 0;
-        if (dht_read_data(DHT_TYPE_DHT11, DHT_GPIO, &humidity, &temperature) == ESP_OK) {
-            // e.g. in dht22, 604 = 60.4%, 252 = 25.2 C
-            // If you want to print float data, you should run `make menuconfig`
-            // to enable full newlib and call dht_read_float_data() here instead
-            if(mqtt_connected)
-            {
-                sprintf(convertido, "%.2f", humidity);
-                esp_mqtt_client_publish(client, "mestrado/iot/aluno/yan/umidade", convertido, 0, 1, 0);
-                sprintf(convertido, "%.2f", temperature);
-                esp_mqtt_client_publish(client, "mestrado/iot/aluno/yan/temperatura", convertido, 0, 1, 0);
+        ALLOC_GUARD_BEGIN(&s_sampler_guard);
+        if (node_config_generation() != generation) {
+            generation = node_config_get(&config);
+            sampler_reconfigure(&config);
+        }
+        int64_t start_us = esp_timer_get_time();
+        TickType_t wait = sensors_run(sampler_push, NULL);
+        stage_latency_add(&s_pipeline_stats.read, esp_timer_get_time() - start_us);
+        ALLOC_GUARD_END(&s_sampler_guard);
+        vTaskDelay(wait);
+    }
+    vTaskDelete(NULL);
+}
+
+/* Batches and publishes the samples, keeps them in the log while offline and drains it. */
+static void publisher_task(void *arg)
+{
+    uint32_t generation = node_config_get(&s_publish_config);
+    aggregate_config_from(&s_publish_config);
+    TickType_t telemetry_at = xTaskGetTickCount();
+#if TRACE_ENABLED
+    TickType_t trace_at = telemetry_at;
+#endif
+
+    while (1)
+    {
+        // Woken by each sample, or after a period to drain the log once the broker is back
+        xSemaphoreTake(s_samples_ready, SAMPLE_PERIOD_MS / portTICK_PERIOD_MS);
+        ALLOC_GUARD_BEGIN(&s_publisher_guard);
+        int64_t busy_since_us = esp_timer_get_time();
+        if (node_config_generation() != generation) {
+            uint32_t window_s = s_aggregate_config.window_s;
+            generation = node_config_get(&s_publish_config);
+            aggregate_config_from(&s_publish_config);
+            if (s_aggregate_config.window_s != window_s) {
+                aggregate_close(true);
             }
+        }
 
-            printf("Humidity: %f Temperature: %f\n", humidity, temperature);
-        } else {
-            printf("Fail to get dht temperature data\n");
+        sensor_sample_t sample;
+        uint32_t taken_us;
+        while (sample_ring_pop(&s_sample_ring, &sample, &taken_us)) {
+            uint32_t start_us = (uint32_t)esp_timer_get_time();
+            stage_latency_add(&s_pipeline_stats.queue, start_us - taken_us);
+            if (s_aggregate_config.window_s > 0) {
+                aggregate_sample(&sample);
+            } else {
+                publish_sample(&sample);
+            }
+            stage_latency_add(&s_pipeline_stats.publish, (uint32_t)esp_timer_get_time() - start_us);
+            if (s_pipeline_stats.publish.count % PIPELINE_STATS_EVERY == 0) {
+                log_pipeline_stats();
+            }
+        }
+        aggregate_close(false);
+        // Filtered samples are sparse: a partial batch is flushed on time, not on the next sample
+        if (batch_due(publish_batch_started_s, publish_batch_count)) {
+            publish_flush();
+        }
+        if (mqtt_connected && sample_log_pending() > 0) {
+            drain_sample_log();
+        }
+        if (s_publish_config.telemetry_period_s > 0 && mqtt_connected &&
+            xTaskGetTickCount() - telemetry_at >= s_publish_config.telemetry_period_s * configTICK_RATE_HZ) {
+            telemetry_at = xTaskGetTickCount();
+            publish_telemetry();
+        }
+#if TRACE_ENABLED
+        if (xTaskGetTickCount() - trace_at >= TRACE_DUMP_PERIOD_S * configTICK_RATE_HZ) {
+            trace_at = xTaskGetTickCount();
+            publish_trace();
         }
-        vTaskDelay(10000 / portTICK_PERIOD_MS);
+#endif
+        s_pipeline_stats.publisher_busy_us += esp_timer_get_time() - busy_since_us;
+        ALLOC_GUARD_END(&s_publisher_guard);
     }
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
+
+#if DEEP_SLEEP_PERIOD_S > 0
+/* Wait up to DUTY_CYCLE_ACK_TIMEOUT_MS for the PUBACKs of every QoS 1 message published. */
+static bool duty_cycle_wait_acks(void)
+{
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(DUTY_CYCLE_ACK_TIMEOUT_MS);
+
+    while (mqtt_acked < mqtt_published) {
+        if ((int32_t)(xTaskGetTickCount() - deadline) >= 0) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+/* drain_sample_log for the duty cycle: the MQTT client's outbox does not survive the deep sleep,
+ * so each backlog message is marked sent only once acknowledged, and the drain stops at the
+ * first one that is not. Left in the log, it goes again on a later wake: a duplicate at worst. */
+static void duty_cycle_drain(void)
+{
+    static sensor_sample_t batch[LOG_DRAIN_BATCH];
+    static uint8_t payload[SAMPLE_CODEC_BATCH_SIZE(LOG_DRAIN_BATCH)];
+
+    TRACE_BEGIN(LOG_DRAIN);
+    for (int i = 0; i < LOG_DRAIN_MAX_BATCHES && mqtt_connected; i++) {
+        size_t count = sample_log_peek(batch, LOG_DRAIN_BATCH);
+        if (count == 0) {
+            break;
+        }
+        size_t len = sample_codec_encode(batch, count, payload, sizeof(payload));
+        if (mqtt_publish(HISTORY_TOPIC, (const char *)payload, len, s_publish_config.qos) < 0 ||
+            !duty_cycle_wait_acks()) {
+            break;
+        }
+        if (sample_log_mark_sent(count) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not mark %u logged samples as sent", (unsigned)count);
+            break;
+        }
+    }
+    if (sample_log_pending() == 0 && sample_log_dropped() > 0) {
+        ESP_LOGW(TAG, "Backlog uploaded, %u samples were lost to a full log", sample_log_dropped());
+    }
+    TRACE_END(LOG_DRAIN);
+}
+
+/* Bring Wi-Fi and MQTT up, publish the RTC batch and the offline backlog, wait for the PUBACKs.
+ * When a sync is due, SNTP runs meanwhile. */
+static void duty_cycle_publish(void)
+{
+    const EventBits_t ready = GOT_IPV4_BIT | MQTT_CONNECTED_BIT;
+
+    s_connect_event_group = xEventGroupCreate();
+    start();
+    mqtt_app_start();
+    EventBits_t bits = xEventGroupWaitBits(s_connect_event_group, ready, false, true,
+                                           pdMS_TO_TICKS(DUTY_CYCLE_CONNECT_TIMEOUT_MS));
+    bool sntp = (bits & GOT_IPV4_BIT) && node_time_sync_due();
+    TickType_t sntp_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(DUTY_CYCLE_SNTP_TIMEOUT_MS);
+    if (sntp) {
+        node_time_sntp_start(SNTP_SERVER);
+    }
+
+    bool published = (bits & ready) == ready && publish_samples(s_rtc_state.batch, s_rtc_state.batch_count) &&
+                      duty_cycle_wait_acks();
+    if (published && sample_log_pending() > 0) {
+        duty_cycle_drain();
+    }
+    while (sntp) {
+        node_time_synced(); // the system time does not survive the deep sleep, the offset does
+        if (!node_time_sync_due() || (int32_t)(xTaskGetTickCount() - sntp_deadline) >= 0) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    if (!published) {
+        ESP_LOGW(TAG, "Broker unreachable, logging %u samples", s_rtc_state.batch_count);
+        log_samples(s_rtc_state.batch, s_rtc_state.batch_count);
+    }
+    s_rtc_state.batch_count = 0;
+    esp_mqtt_client_stop(client);
+    esp_wifi_stop();
+}
+
+static void duty_cycle_store(sensor_sample_t *sample, void *arg)
+{
+    sample_taken(sample);
+    if (!filter_sample(sample)) {
+        return;
+    }
+    if (s_rtc_state.batch_count == RTC_STATE_BATCH_MAX) {
+        log_samples(sample, 1);
+        return;
+    }
+    if (s_rtc_state.batch_count == 0) {
+        s_rtc_state.batch_started_s = node_time_clock();
+    }
+    s_rtc_state.batch[s_rtc_state.batch_count++] = *sample;
+}
+
+/* One wake of the duty cycle: sample, publish when a batch is due, deep sleep. Does not return. */
+static void duty_cycle(bool warm)
+{
+    node_config_get(&s_publish_config);
+    sensors_setup(warm, &s_publish_config);
+    sensors_read_all(duty_cycle_store, NULL);
+    if (batch_due(s_rtc_state.batch_started_s, s_rtc_state.batch_count) ||
+        s_rtc_state.batch_count + sensors_count() > RTC_STATE_BATCH_MAX) {
+        duty_cycle_publish();
+        node_config_get(&s_publish_config); // settings received while connected
+    }
+
+    uint64_t awake_us = (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000;
+    uint64_t period_us = DEEP_SLEEP_PERIOD_S * 1000000ULL;
+    // A wake longer than the period (broker timeout) skips to the next slot: 0 would never wake up
+    uint64_t sleep_us = period_us - awake_us % period_us;
+    node_time_sleep(awake_us + sleep_us);
+
+    // Skip RF calibration on wakes that may publish, keep the radio off only on those that cannot:
+    // the test above with every sensor's reading kept, and the node clock of the next wake's test,
+    // for which this wake's uptime stands in (the node clock already counts the sleep), plus a second
+    size_t next_count = s_rtc_state.batch_count + sensors_count();
+    uint32_t next_s = node_time_clock() + 1;
+    uint32_t next_started_s = s_rtc_state.batch_count > 0 ? s_rtc_state.batch_started_s : next_s;
+    bool next_publishes = batch_due_at(next_s, next_started_s, next_count) ||
+                          next_count + sensors_count() > RTC_STATE_BATCH_MAX;
+    esp_deep_sleep_set_rf_option(next_publishes ? 2 : 4);
+    rtc_state_save(&s_rtc_state);
+    ESP_LOGI(TAG, "Awake %u ms, sleeping %u ms", (unsigned)(awake_us / 1000), (unsigned)(sleep_us / 1000));
+    esp_deep_sleep(sleep_us);
+}
+#endif
\ No newline at end of file
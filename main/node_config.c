@@ -0,0 +1,169 @@
+#include "node_config.h"
+#include <string.h>
+#include "i2c_bme280.h"
+
+typedef struct
+{
+    uint8_t key;
+    uint8_t offset;
+    uint8_t size;
+    const char *name;
+} node_config_field_t;
+
+#define NODE_CONFIG_FIELD(field_key, field_name, field) \
+    { field_key, offsetof(node_config_t, field), sizeof(((node_config_t *)0)->field), field_name },
+static const node_config_field_t fields[] = { NODE_CONFIG_FIELDS(NODE_CONFIG_FIELD) };
+
+#define NODE_CONFIG_FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+static const node_config_field_t *field_find(uint8_t key)
+{
+    for (size_t i = 0; i < NODE_CONFIG_FIELD_COUNT; i++) {
+        if (fields[i].key == key) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Fields of 1, 2 or 4 bytes, read and written through their own type
+
+static uint32_t field_get(const node_config_t *config, const node_config_field_t *f)
+{
+    const uint8_t *p = (const uint8_t *)config + f->offset;
+
+    switch (f->size) {
+    case 1:
+        return *p;
+    case 2:
+        return *(const uint16_t *)p;
+    default:
+        return *(const uint32_t *)p;
+    }
+}
+
+static void field_set(node_config_t *config, const node_config_field_t *f, uint32_t value)
+{
+    uint8_t *p = (uint8_t *)config + f->offset;
+
+    switch (f->size) {
+    case 1:
+        *p = (uint8_t)value;
+        break;
+    case 2:
+        *(uint16_t *)p = (uint16_t)value;
+        break;
+    default:
+        *(uint32_t *)p = value;
+        break;
+    }
+}
+
+size_t node_config_encode(const node_config_t *config, uint8_t *buf, size_t size)
+{
+    uint8_t *p = buf;
+
+    if (size < NODE_CONFIG_MAX_SIZE) {
+        return 0;
+    }
+    *p++ = NODE_CONFIG_VERSION;
+    for (size_t i = 0; i < NODE_CONFIG_FIELD_COUNT; i++) {
+        uint32_t value = field_get(config, &fields[i]);
+        *p++ = fields[i].key;
+        for (uint8_t b = 0; b < fields[i].size; b++) {
+            *p++ = (value >> (8 * b)) & 0xFF;
+        }
+    }
+    return p - buf;
+}
+
+esp_err_t node_config_decode(const uint8_t *buf, size_t len, const node_config_t *defaults, node_config_t *config)
+{
+    node_config_t decoded = *config;
+    size_t pos = 1;
+
+    if (len < 1 || buf[0] != NODE_CONFIG_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    while (pos < len) {
+        uint8_t key = buf[pos++];
+        if (key == NODE_CONFIG_KEY_DEFAULTS) {
+            decoded = *defaults;
+            continue;
+        }
+        const node_config_field_t *f = field_find(key);
+        if (!f) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (len - pos < f->size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint32_t value = 0;
+        for (uint8_t b = 0; b < f->size; b++) {
+            value |= (uint32_t)buf[pos++] << (8 * b);
+        }
+        field_set(&decoded, f, value);
+    }
+    *config = decoded;
+    return ESP_OK;
+}
+
+static bool period_valid(uint32_t period_ms, uint32_t max_period_ms)
+{
+    return period_ms >= NODE_CONFIG_PERIOD_MIN_MS && period_ms <= NODE_CONFIG_PERIOD_MAX_MS &&
+           (max_period_ms == 0 || (max_period_ms >= period_ms && max_period_ms <= NODE_CONFIG_PERIOD_MAX_MS));
+}
+
+static bool oversampling_valid(uint8_t osrs)
+{
+    return osrs >= BME280_OVERSAMPLING_1X && osrs <= BME280_OVERSAMPLING_16X;
+}
+
+esp_err_t node_config_validate(const node_config_t *config)
+{
+    bool valid = period_valid(config->dht_period_ms, config->dht_max_period_ms) &&
+                 period_valid(config->bme280_period_ms, config->bme280_max_period_ms) &&
+                 oversampling_valid(config->bme280_osrs_t) && oversampling_valid(config->bme280_osrs_p) &&
+                 oversampling_valid(config->bme280_osrs_h) && config->bme280_filter <= BME280_FILTER_COEFF_16 &&
+                 config->ewma_shift <= NODE_CONFIG_EWMA_SHIFT_MAX &&
+                 config->batch_size >= 1 && config->batch_size <= NODE_CONFIG_BATCH_MAX &&
+                 config->qos <= 1 &&
+                 (config->telemetry_period_s == 0 || config->telemetry_period_s >= NODE_CONFIG_TELEMETRY_MIN_S) &&
+                 config->aggregate_window_s <= NODE_CONFIG_WINDOW_MAX_S;
+
+    return valid ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+const char *node_config_key_name(uint8_t key)
+{
+    const node_config_field_t *f = field_find(key);
+    return f ? f->name : NULL;
+}
+
+size_t node_config_key_size(uint8_t key)
+{
+    const node_config_field_t *f = field_find(key);
+    return f ? f->size : 0;
+}
+
+bool node_config_get_value(const node_config_t *config, uint8_t key, uint32_t *value)
+{
+    const node_config_field_t *f = field_find(key);
+
+    if (!f) {
+        return false;
+    }
+    *value = field_get(config, f);
+    return true;
+}
+
+bool node_config_set_value(node_config_t *config, uint8_t key, uint32_t value)
+{
+    const node_config_field_t *f = field_find(key);
+
+    if (!f || (f->size < 4 && value >> (8 * f->size))) {
+        return false;
+    }
+    field_set(config, f, value);
+    return true;
+}
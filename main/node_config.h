@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Settings of the node that can change at run time, received on the configuration topic,
+ * kept in NVS and reported back on the configuration state topic. Little endian:
+ *
+ *   u8  version (NODE_CONFIG_VERSION)
+ *   any number of settings, each:
+ *     u8  key (NODE_CONFIG_KEY_*)
+ *     the new value, of the width of the setting: u8, u16 or u32 as in node_config_t
+ *
+ * Settings left out keep their value; NODE_CONFIG_KEY_DEFAULTS, without a value, first
+ * brings every setting back to the value the firmware was built with. A message is taken
+ * whole or not at all: one unknown key, truncated value or setting out of range
+ * (node_config_validate) rejects it. A report carries every setting.
+ */
+#define NODE_CONFIG_VERSION 1
+#define NODE_CONFIG_KEY_DEFAULTS 0
+
+// Limits of node_config_validate
+#define NODE_CONFIG_PERIOD_MIN_MS 1000
+#define NODE_CONFIG_PERIOD_MAX_MS 3600000
+#define NODE_CONFIG_BATCH_MAX 8             // samples per message, RTC_STATE_BATCH_MAX
+#define NODE_CONFIG_EWMA_SHIFT_MAX 6
+#define NODE_CONFIG_TELEMETRY_MIN_S 10
+#define NODE_CONFIG_WINDOW_MAX_S 3600
+
+/**
+ * The settings
+ */
+typedef struct
+{
+    uint32_t dht_period_ms;         //!< sensor_config_t.period_ms of the DHT sensors
+    uint32_t dht_max_period_ms;     //!< sensor_config_t.max_period_ms, 0 for a fixed period
+    uint32_t bme280_period_ms;
+    uint32_t bme280_max_period_ms;
+    uint8_t bme280_osrs_t;          //!< BME280_OVERSAMPLING_*, 1X to 16X
+    uint8_t bme280_osrs_p;
+    uint8_t bme280_osrs_h;
+    uint8_t bme280_filter;          //!< BME280_FILTER_COEFF_*
+    uint16_t deadband[3];           //!< filtering stage deadbands, also the BME280 adaptive period
+                                    //!< thresholds: temperature, humidity, pressure, in sample units
+    uint8_t ewma_shift;             //!< filtering stage smoothing, sample_filter_config_t
+    uint16_t heartbeat_s;
+    uint8_t batch_size;             //!< samples per message, 1 to NODE_CONFIG_BATCH_MAX
+    uint16_t flush_interval_s;      //!< age of the oldest sample that sends a partial batch
+    uint8_t qos;                    //!< of the sample and backlog messages, 0 or 1
+    uint16_t telemetry_period_s;    //!< self-metrics period, 0 for none
+    uint16_t aggregate_window_s;    //!< aggregation stage window, 0 publishes the readings through the filtering stage
+    uint16_t breach[3];             //!< aggregation stage raw passthrough thresholds, sample_aggregate_config_t
+} node_config_t;
+
+// Key, name for tools, field
+#define NODE_CONFIG_FIELDS(X)                                \
+    X(1, "dht_period_ms", dht_period_ms)                     \
+    X(2, "dht_max_period_ms", dht_max_period_ms)             \
+    X(3, "bme280_period_ms", bme280_period_ms)               \
+    X(4, "bme280_max_period_ms", bme280_max_period_ms)       \
+    X(5, "bme280_osrs_t", bme280_osrs_t)                     \
+    X(6, "bme280_osrs_p", bme280_osrs_p)                     \
+    X(7, "bme280_osrs_h", bme280_osrs_h)                     \
+    X(8, "bme280_filter", bme280_filter)                     \
+    X(9, "deadband_temperature", deadband[0])                \
+    X(10, "deadband_humidity", deadband[1])                  \
+    X(11, "deadband_pressure", deadband[2])                  \
+    X(12, "ewma_shift", ewma_shift)                          \
+    X(13, "heartbeat_s", heartbeat_s)                        \
+    X(14, "batch_size", batch_size)                          \
+    X(15, "flush_interval_s", flush_interval_s)              \
+    X(16, "qos", qos)                                        \
+    X(17, "telemetry_period_s", telemetry_period_s)          \
+    X(18, "aggregate_window_s", aggregate_window_s)          \
+    X(19, "breach_temperature", breach[0])                   \
+    X(20, "breach_humidity", breach[1])                      \
+    X(21, "breach_pressure", breach[2])
+
+#define NODE_CONFIG_FIELD_SIZE(key, name, field) + 1 + sizeof(((node_config_t *)0)->field)
+// Buffer size that always fits an encoded report
+#define NODE_CONFIG_MAX_SIZE (1 NODE_CONFIG_FIELDS(NODE_CONFIG_FIELD_SIZE))
+
+// NVS namespace of the stored settings; nvs_flash_init must have been called
+#define NODE_CONFIG_NAMESPACE "node_config"
+
+/**
+  * @brief  Encode every setting.
+  *
+  * @param  config settings
+  * @param  buf output buffer
+  * @param  size size of buf, NODE_CONFIG_MAX_SIZE is always enough
+  *
+  * @return number of bytes written, 0 if buf is too small
+  */
+size_t node_config_encode(const node_config_t *config, uint8_t *buf, size_t size);
+
+/**
+  * @brief  Apply the settings of a message to config, without validating the result.
+  *
+  * @param  buf message
+  * @param  len length of the message
+  * @param  defaults values of NODE_CONFIG_KEY_DEFAULTS
+  * @param  config settings to change, untouched on failure
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_VERSION Another format
+  *     - ESP_ERR_INVALID_SIZE A value is cut short
+  *     - ESP_ERR_NOT_FOUND Unknown key
+  */
+esp_err_t node_config_decode(const uint8_t *buf, size_t len, const node_config_t *defaults, node_config_t *config);
+
+/**
+  * @brief  Check that every setting is in range: periods within NODE_CONFIG_PERIOD_*_MS and
+  *         maximum periods 0 or above the periods, BME280 oversampling 1X to 16X and filter
+  *         coefficients up to 16, a batch size up to NODE_CONFIG_BATCH_MAX, QoS 0 or 1,
+  *         telemetry off or at least every NODE_CONFIG_TELEMETRY_MIN_S, an aggregation window
+  *         up to NODE_CONFIG_WINDOW_MAX_S.
+  *
+  * @return ESP_OK or ESP_ERR_INVALID_ARG
+  */
+esp_err_t node_config_validate(const node_config_t *config);
+
+/**
+  * @brief  Settings by key, for tools.
+  *
+  * @return NULL, 0 or false for an unknown key; false also for a value wider than the setting
+  */
+const char *node_config_key_name(uint8_t key);
+size_t node_config_key_size(uint8_t key);
+bool node_config_get_value(const node_config_t *config, uint8_t key, uint32_t *value);
+bool node_config_set_value(node_config_t *config, uint8_t key, uint32_t value);
+
+/**
+  * @brief  Load the stored settings, on top of the given defaults. Settings missing from the
+  *         stored copy, as after an update that adds some, keep their defaults. The stored copy
+  *         is taken whole or not at all, as a message: with an unknown key (written by a later
+  *         firmware, whose value width is not known), a truncated value or a setting out of
+  *         range, every setting starts from its default. Call once before the others.
+  *
+  * @param  defaults the settings the firmware was built with, copied
+  */
+void node_config_init(const node_config_t *defaults);
+
+/**
+  * @brief  Copy of the running settings, from any task. A change is seen whole or not at all.
+  *
+  * @return generation of the settings, changed by each update
+  */
+uint32_t node_config_get(node_config_t *config);
+
+/**
+  * @brief  Generation of the running settings: compare with the one of the last copy to see
+  *         whether it is still current, without copying.
+  */
+uint32_t node_config_generation(void);
+
+/**
+  * @brief  Apply a message to the running settings: decode, validate, store in NVS, then
+  *         make the new settings current. A message that changes nothing is not stored.
+  *
+  * @return
+  *     - ESP_OK Success, or nothing to change
+  *     - ESP_ERR_INVALID_ARG A setting is out of range
+  *     - other node_config_decode errors, NVS errors: the running settings stay as they were
+  */
+esp_err_t node_config_update(const uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
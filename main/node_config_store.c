@@ -0,0 +1,120 @@
+/*
+ * Running settings (node_config.h): one current copy, replaced whole in a critical section
+ * and read by copy, with a generation number for the tasks to notice a change between two
+ * passes of their loops. Stored in NVS as a report of every setting, so settings added by a
+ * later firmware start from their defaults. Going back to an earlier firmware drops the stored
+ * copy: its keys carry no width, the first unknown one ends the decoding.
+ */
+#include "node_config.h"
+#include <string.h>
+#include <nvs.h>
+#include <esp_log.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define NODE_CONFIG_STORE_KEY "settings"
+
+static const char *TAG = "NODE_CONFIG";
+
+static node_config_t s_defaults;
+static node_config_t s_current;
+static uint32_t s_generation;
+
+static esp_err_t config_load(node_config_t *config)
+{
+    uint8_t buf[NODE_CONFIG_MAX_SIZE];
+    size_t length = sizeof(buf);
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(NODE_CONFIG_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_get_blob(handle, NODE_CONFIG_STORE_KEY, buf, &length);
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = node_config_decode(buf, length, &s_defaults, config);
+    return err == ESP_OK ? node_config_validate(config) : err;
+}
+
+static esp_err_t config_store(const node_config_t *config)
+{
+    uint8_t buf[NODE_CONFIG_MAX_SIZE];
+    size_t length = node_config_encode(config, buf, sizeof(buf));
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(NODE_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, NODE_CONFIG_STORE_KEY, buf, length);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+/* Setting by setting: padding bytes are not compared. */
+static bool config_equal(const node_config_t *a, const node_config_t *b)
+{
+    uint8_t ea[NODE_CONFIG_MAX_SIZE], eb[NODE_CONFIG_MAX_SIZE];
+    size_t len = node_config_encode(a, ea, sizeof(ea));
+
+    return len == node_config_encode(b, eb, sizeof(eb)) && memcmp(ea, eb, len) == 0;
+}
+
+void node_config_init(const node_config_t *defaults)
+{
+    node_config_t loaded = *defaults;
+
+    s_defaults = *defaults;
+    esp_err_t err = config_load(&loaded);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Stored settings in use");
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Discarding stored settings (0x%x)", err);
+        loaded = *defaults;
+    }
+    s_current = loaded;
+}
+
+uint32_t node_config_get(node_config_t *config)
+{
+    taskENTER_CRITICAL();
+    *config = s_current;
+    uint32_t generation = s_generation;
+    taskEXIT_CRITICAL();
+    return generation;
+}
+
+uint32_t node_config_generation(void)
+{
+    return __atomic_load_n(&s_generation, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t node_config_update(const uint8_t *buf, size_t len)
+{
+    // Single writer: s_current only changes here, read without the critical section
+    node_config_t config = s_current;
+    esp_err_t err = node_config_decode(buf, len, &s_defaults, &config);
+    if (err == ESP_OK) {
+        err = node_config_validate(&config);
+    }
+    if (err != ESP_OK || config_equal(&config, &s_current)) {
+        return err;
+    }
+    err = config_store(&config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    taskENTER_CRITICAL();
+    s_current = config;
+    __atomic_store_n(&s_generation, s_generation + 1, __ATOMIC_RELEASE);
+    taskEXIT_CRITICAL();
+    ESP_LOGI(TAG, "Settings updated, generation %u", s_generation);
+    return ESP_OK;
+}
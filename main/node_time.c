@@ -0,0 +1,100 @@
+#include "node_time.h"
+#include <string.h>
+#include <time.h>
+#include <nvs.h>
+#include <esp_log.h>
+#include "lwip/apps/sntp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define NODE_TIME_BOOT_KEY "boot"
+
+static const char *TAG = "NODE_TIME";
+
+static node_time_state_t *s_state;
+
+/* Next boot number, 0 when NVS is unavailable. */
+static uint32_t boot_counter_next(void)
+{
+    uint32_t boot = 0;
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(NODE_TIME_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        nvs_get_u32(handle, NODE_TIME_BOOT_KEY, &boot); // left 0 on the first boot
+        boot++;
+        err = nvs_set_u32(handle, NODE_TIME_BOOT_KEY, boot);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Boot counter not stored (0x%x)", err);
+    }
+    return boot;
+}
+
+void node_time_init(node_time_state_t *state, bool clock_kept)
+{
+    s_state = state;
+    if (clock_kept) {
+        return;
+    }
+    memset(state, 0, sizeof(*state));
+    state->boot = boot_counter_next();
+    ESP_LOGI(TAG, "Node clock started, boot %u", state->boot);
+}
+
+uint32_t node_time_clock(void)
+{
+    return s_state->clock_s + xTaskGetTickCount() / configTICK_RATE_HZ;
+}
+
+void node_time_sleep(uint64_t us)
+{
+    s_state->clock_s += (us + 500000) / 1000000;
+}
+
+void node_time_sntp_start(const char *server)
+{
+    if (sntp_enabled()) {
+        return;
+    }
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, server);
+    sntp_init();
+}
+
+bool node_time_sync_due(void)
+{
+    return !s_state->synced || node_time_clock() - s_state->synced_at_s >= NODE_TIME_RESYNC_S;
+}
+
+bool node_time_synced(void)
+{
+    uint32_t clock = node_time_clock();
+    time_t now = time(NULL);
+
+    // A set system time is taken at most every NODE_TIME_RESYNC_S: a new offset may be a second
+    // off the last one, the two clocks not ticking together
+    if (now >= NODE_TIME_MIN_UNIX && node_time_sync_due()) {
+        s_state->unix_offset_s = (uint32_t)now - clock;
+        s_state->synced_at_s = clock;
+        s_state->synced = 1;
+        ESP_LOGI(TAG, "Clock synchronized: Unix time %u at node clock %u", (uint32_t)now, clock);
+    }
+    return s_state->synced && clock - s_state->synced_at_s < NODE_TIME_VALID_S;
+}
+
+void node_time_stamp(sensor_sample_t *sample)
+{
+    if (node_time_synced()) {
+        sample->timestamp = node_time_clock() + s_state->unix_offset_s;
+        sample->flags |= SAMPLE_TIME_SYNCED;
+    } else {
+        sample->timestamp = node_time_clock();
+        sample->flags &= ~SAMPLE_TIME_SYNCED;
+    }
+    sample->boot = s_state->boot;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timestamps of the samples. The node clock counts seconds from the boot that started it,
+ * deep sleeps included, and restarts at 0 on any other boot, each start numbered by a boot
+ * counter kept in NVS. Once SNTP has set the system time, the offset from the node clock to
+ * Unix time is kept with the clock, in RTC memory: samples are then stamped in Unix time and
+ * flagged SAMPLE_TIME_SYNCED, also on wakes that do not connect, until the offset is older
+ * than NODE_TIME_VALID_S. Other samples carry the node clock and its boot number.
+ */
+
+// System time below this has not been set by SNTP (2020-01-01)
+#define NODE_TIME_MIN_UNIX 1577836800u
+// Age of the last sync, in node clock seconds, after which samples fall back to the node clock
+#define NODE_TIME_VALID_S (24 * 3600)
+// Age after which node_time_sync_due asks for a new sync
+#define NODE_TIME_RESYNC_S 3600
+// NVS namespace of the boot counter; nvs_flash_init must have been called
+#define NODE_TIME_NAMESPACE "node_time"
+
+/**
+ * Clock state, kept in RTC memory across deep sleeps
+ */
+typedef struct
+{
+    uint32_t clock_s;           //!< node clock at this boot
+    uint32_t unix_offset_s;     //!< Unix time minus node clock, from the last sync
+    uint32_t synced_at_s;       //!< node clock at the last sync
+    uint16_t boot;              //!< boot counter value of the clock's start
+    uint8_t synced;             //!< unix_offset_s is set
+} node_time_state_t;
+
+/**
+  * @brief  Start the node clock: keep it on a wake from deep sleep, otherwise restart it from 0
+  *         under the next boot number and forget the last sync. Call once, before the others.
+  *
+  * @param  state clock state in RTC memory, used from then on
+  * @param  clock_kept true on a wake from deep sleep with the RTC state valid
+  */
+void node_time_init(node_time_state_t *state, bool clock_kept);
+
+/**
+  * @brief  Node clock now, seconds.
+  */
+uint32_t node_time_clock(void);
+
+/**
+  * @brief  Advance the node clock past a deep sleep, before saving the RTC state.
+  *
+  * @param  us time from this boot to the wake-up: awake time plus sleep time
+  */
+void node_time_sleep(uint64_t us);
+
+/**
+  * @brief  Start SNTP in poll mode once the station has an address. Does nothing if it runs.
+  *
+  * @param  server NTP server name, kept by reference
+  */
+void node_time_sntp_start(const char *server);
+
+/**
+  * @brief  Whether SNTP should be started on this wake: no sync yet, or one older than
+  *         NODE_TIME_RESYNC_S.
+  */
+bool node_time_sync_due(void);
+
+/**
+  * @brief  Whether samples are stamped in Unix time: picks up a sync done by SNTP since the
+  *         last call. From the task that stamps the samples.
+  */
+bool node_time_synced(void);
+
+/**
+  * @brief  Stamp a new sample: Unix time and SAMPLE_TIME_SYNCED, or the node clock and boot.
+  *         From the task that stamps the samples.
+  */
+void node_time_stamp(sensor_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,239 @@
+#include "outbox_pool.h"
+#include <string.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+static outbox_pool_stats_t s_stats;
+
+#ifdef CONFIG_MQTT_CUSTOM_OUTBOX
+#include <esp_log.h>
+#include "mqtt_outbox.h"
+
+static const char *TAG = "OUTBOX";
+
+// Replaces esp-mqtt's mqtt_outbox.c: called by the MQTT client with its API lock held
+
+struct outbox_item
+{
+    uint8_t buffer[OUTBOX_POOL_SLOT_SIZE];
+    int len;
+    int msg_id;
+    int msg_type;
+    int msg_qos;
+    int tick;
+    pending_state_t pending;
+    uint32_t seq;               //!< enqueue order, the library expects FIFO
+    bool used;
+};
+
+struct outbox_list_t
+{
+    struct outbox_item items[OUTBOX_POOL_SLOTS];
+    uint32_t next_seq;
+    bool open;
+};
+
+static struct outbox_list_t s_outbox;
+
+static void item_free(struct outbox_item *item)
+{
+    item->used = false;
+    s_stats.in_use--;
+}
+
+/* Oldest item in the given state, any state if pending < 0. */
+static struct outbox_item *item_oldest(outbox_handle_t outbox, int pending)
+{
+    struct outbox_item *oldest = NULL;
+
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->used && (pending < 0 || item->pending == (pending_state_t)pending) &&
+            (!oldest || (int32_t)(item->seq - oldest->seq) < 0)) {
+            oldest = item;
+        }
+    }
+    return oldest;
+}
+
+outbox_handle_t outbox_init(void)
+{
+    // One client per node
+    if (s_outbox.open) {
+        return NULL;
+    }
+    memset(&s_outbox, 0, sizeof(s_outbox));
+    s_outbox.open = true;
+    s_stats.in_use = 0;
+    return &s_outbox;
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, int tick)
+{
+    int len = message->len + message->remaining_len;
+    struct outbox_item *item = NULL;
+
+    for (int i = 0; i < OUTBOX_POOL_SLOTS && len <= OUTBOX_POOL_SLOT_SIZE; i++) {
+        if (!outbox->items[i].used) {
+            item = &outbox->items[i];
+            break;
+        }
+    }
+    if (!item) {
+        s_stats.overflows++;
+        ESP_LOGW(TAG, "No slot for message %d, %d bytes: sent without retransmission", message->msg_id, len);
+        return NULL;
+    }
+
+    memcpy(item->buffer, message->data, message->len);
+    if (message->remaining_len > 0) {
+        memcpy(item->buffer + message->len, message->remaining_data, message->remaining_len);
+    }
+    item->len = len;
+    item->msg_id = message->msg_id;
+    item->msg_type = message->msg_type;
+    item->msg_qos = message->msg_qos;
+    item->tick = tick;
+    item->pending = QUEUED;
+    item->seq = outbox->next_seq++;
+    item->used = true;
+
+    s_stats.enqueued++;
+    if (++s_stats.in_use > s_stats.in_use_max) {
+        s_stats.in_use_max = s_stats.in_use;
+    }
+    return item;
+}
+
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, int *tick)
+{
+    struct outbox_item *item = item_oldest(outbox, pending);
+
+    if (item && tick) {
+        *tick = item->tick;
+    }
+    return item;
+}
+
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id)
+{
+    struct outbox_item *found = NULL;
+
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->used && item->msg_id == msg_id && (!found || (int32_t)(item->seq - found->seq) < 0)) {
+            found = item;
+        }
+    }
+    return found;
+}
+
+uint8_t *outbox_item_get_data(outbox_item_handle_t item, size_t *len, uint16_t *msg_id, int *msg_type, int *qos)
+{
+    if (!item) {
+        return NULL;
+    }
+    *len = item->len;
+    *msg_id = item->msg_id;
+    *msg_type = item->msg_type;
+    *qos = item->msg_qos;
+    return item->buffer;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
+{
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->used && item->msg_id == msg_id && item->msg_type == msg_type) {
+            item_free(item);
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t outbox_delete_msgid(outbox_handle_t outbox, int msg_id)
+{
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        if (outbox->items[i].used && outbox->items[i].msg_id == msg_id) {
+            item_free(&outbox->items[i]);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t outbox_delete_msgtype(outbox_handle_t outbox, int msg_type)
+{
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        if (outbox->items[i].used && outbox->items[i].msg_type == msg_type) {
+            item_free(&outbox->items[i]);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item)
+{
+    if (item < outbox->items || item >= outbox->items + OUTBOX_POOL_SLOTS || !item->used) {
+        return ESP_FAIL;
+    }
+    item_free(item);
+    return ESP_OK;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, int current_tick, int timeout)
+{
+    int deleted = 0;
+
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->used && current_tick - item->tick > timeout) {
+            item_free(item);
+            deleted++;
+        }
+    }
+    return deleted;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+    struct outbox_item *item = outbox_get(outbox, msg_id);
+
+    if (!item) {
+        return ESP_FAIL;
+    }
+    item->pending = pending;
+    return ESP_OK;
+}
+
+int outbox_get_size(outbox_handle_t outbox)
+{
+    int size = 0;
+
+    for (int i = 0; i < OUTBOX_POOL_SLOTS; i++) {
+        if (outbox->items[i].used) {
+            size += outbox->items[i].len;
+        }
+    }
+    return size;
+}
+
+esp_err_t outbox_cleanup(outbox_handle_t outbox, int max_size)
+{
+    while (outbox_get_size(outbox) > max_size) {
+        item_free(item_oldest(outbox, -1));
+    }
+    return ESP_OK;
+}
+
+void outbox_destroy(outbox_handle_t outbox)
+{
+    memset(outbox, 0, sizeof(*outbox));
+    s_stats.in_use = 0;
+}
+#endif
+
+void outbox_pool_get_stats(outbox_pool_stats_t *stats)
+{
+    *stats = s_stats;
+}
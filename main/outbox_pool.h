@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * esp-mqtt outbox in static memory. With CONFIG_MQTT_CUSTOM_OUTBOX the MQTT client keeps
+ * its unacknowledged QoS 1 messages here instead of allocating an entry and a copy of each
+ * on the heap: OUTBOX_POOL_SLOTS messages of up to OUTBOX_POOL_SLOT_SIZE bytes, as encoded
+ * on the wire. A message that does not fit, in size or because every slot is taken, is
+ * still sent but not kept for retransmission, and counted in overflows: keep the number of
+ * QoS 1 messages in flight under OUTBOX_POOL_SLOTS.
+ */
+#define OUTBOX_POOL_SLOTS 8
+#define OUTBOX_POOL_SLOT_SIZE 256
+
+// Largest encoded size of a QoS 1 PUBLISH: fixed header, topic, packet id, payload
+#define OUTBOX_POOL_PUBLISH_SIZE(topic_len, payload_len) (1 + 4 + 2 + (topic_len) + 2 + (payload_len))
+
+typedef struct
+{
+    uint32_t enqueued;          //!< messages kept since boot
+    uint32_t overflows;         //!< messages sent without a slot
+    uint8_t in_use;             //!< slots taken now
+    uint8_t in_use_max;         //!< most slots taken at once since boot
+} outbox_pool_stats_t;
+
+/**
+  * @brief  Usage of the pool, all zero without CONFIG_MQTT_CUSTOM_OUTBOX.
+  */
+void outbox_pool_get_stats(outbox_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
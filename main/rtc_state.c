@@ -0,0 +1,37 @@
+#include "rtc_state.h"
+#include <string.h>
+#include <stddef.h>
+#include <esp_attr.h>
+#include "crc.h"
+
+#define RTC_STATE_MAGIC 0x52544335 // "RTC5", changes with the layout
+
+_Static_assert(RTC_STATE_HEADROOM >= 0, "RTC data does not fit in RTC user memory");
+
+// RTC memory is not cleared on power on: the content is only trusted with a matching CRC.
+static RTC_DATA_ATTR rtc_state_t rtc_state_memory;
+
+static uint16_t rtc_state_crc(const rtc_state_t *state)
+{
+    return crc16_ccitt(0xFFFF, state, offsetof(rtc_state_t, crc));
+}
+
+bool rtc_state_load(rtc_state_t *state)
+{
+    memcpy(state, &rtc_state_memory, sizeof(*state));
+    if (state->magic == RTC_STATE_MAGIC && state->crc == rtc_state_crc(state) &&
+        state->batch_count <= RTC_STATE_BATCH_MAX) {
+        return true;
+    }
+    memset(state, 0, sizeof(*state));
+    state->magic = RTC_STATE_MAGIC;
+    return false;
+}
+
+void rtc_state_save(const rtc_state_t *state)
+{
+    // memcpy, not assignment: the CRC covers padding bytes too
+    memcpy(&rtc_state_memory, state, sizeof(rtc_state_memory));
+    rtc_state_memory.magic = RTC_STATE_MAGIC;
+    rtc_state_memory.crc = rtc_state_crc(&rtc_state_memory);
+}
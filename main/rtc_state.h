@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample.h"
+#include "sample_filter.h"
+#include "node_time.h"
+#include "bme280_calib_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Samples a duty cycle can hold across deep sleeps before publishing them
+#define RTC_STATE_BATCH_MAX 8
+// Sensors whose filter state is kept across deep sleeps: the node's two and a spare, 68 bytes each
+#define RTC_STATE_FILTERS 3
+// RTC memory of the application, shared by every RTC_DATA_ATTR object: rtc_state_t and the
+// BME280 calibration copies. A new one must be added to RTC_STATE_HEADROOM.
+#define RTC_STATE_USER_MEMORY 512
+// Bytes of it left free, asserted not negative in rtc_state.c
+#define RTC_STATE_HEADROOM ((int)RTC_STATE_USER_MEMORY - (int)sizeof(rtc_state_t) - \
+                            (int)BME280_CALIB_CACHE_RTC_SIZE)
+
+/**
+ * State kept in RTC memory, which survives deep sleep and esp_restart but not a power cycle.
+ * The ESP8266 has RTC_STATE_USER_MEMORY bytes of it for the application, for all its users.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t boot_count;            //!< resets since the last power on
+    uint32_t sample_seq;            //!< samples taken since the last power on
+    node_time_state_t time;         //!< node clock and its offset to Unix time
+    uint8_t wifi_bssid[6];          //!< AP of the last connection
+    uint8_t wifi_channel;           //!< its channel, 0 when no AP is cached
+    uint8_t batch_count;
+    uint32_t batch_started_s;       //!< node clock when the first sample of the batch was taken
+    sensor_sample_t batch[RTC_STATE_BATCH_MAX]; //!< samples not published yet
+    sample_filter_t filters[RTC_STATE_FILTERS]; //!< filtering stage state, by sensor
+    uint16_t crc;
+} rtc_state_t;
+
+/**
+  * @brief  Copy the state kept in RTC memory.
+  *
+  * @param  state output, zeroed when RTC memory holds no valid state
+  *
+  * @return true if the state was valid, false after a power on
+  */
+bool rtc_state_load(rtc_state_t *state);
+
+/**
+  * @brief  Store the state in RTC memory, for the next boot.
+  *
+  * @param  state state to keep
+  */
+void rtc_state_save(const rtc_state_t *state);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_HAS_TEMPERATURE  (1 << 0)
+#define SAMPLE_HAS_HUMIDITY     (1 << 1)
+#define SAMPLE_HAS_PRESSURE     (1 << 2)
+#define SAMPLE_TIME_SYNCED      (1 << 3) // timestamp in Unix time, otherwise node clock (node_time.h)
+
+/**
+ * Sample source
+ */
+typedef enum
+{
+    SAMPLE_SENSOR_DHT = 0,  //!< DHT11/DHT22/SI7021 on the one-wire pin
+    SAMPLE_SENSOR_BME280    //!< BME280/BMP280 on the I2C bus
+} sample_sensor_t;
+
+// Sensor field of a sample: the sample_sensor_t in bit 0 and, in bits 1..3, the instance number
+// among the sensors of that type (registration order), so one node can carry up to 8 of each.
+// Instance 0 keeps the plain sample_sensor_t values.
+#define SAMPLE_SENSOR_ID(type, instance) ((uint8_t)((type) | ((instance) << 1)))
+#define SAMPLE_SENSOR_TYPE(id) ((sample_sensor_t)((id) & 0x01))
+#define SAMPLE_SENSOR_INSTANCE(id) (((id) >> 1) & 0x07)
+
+/**
+ * One reading in fixed point, as stored in the offline log and sent to the broker.
+ * 16 bytes, no floats: temperature=2437 is 24.37 degrees Celsius,
+ * humidity=6250 is 62.50 %, pressure=101325 is 1013.25 hPa.
+ */
+typedef struct
+{
+    uint32_t timestamp;     //!< seconds: Unix time with SAMPLE_TIME_SYNCED, else node clock of boot
+    int16_t temperature;    //!< 0.01 degrees Celsius
+    uint16_t humidity;      //!< 0.01 %RH
+    uint32_t pressure;      //!< Pa
+    uint8_t sensor;         //!< SAMPLE_SENSOR_ID()
+    uint8_t flags;          //!< SAMPLE_HAS_* bits of the fields above that are valid, SAMPLE_TIME_SYNCED
+    uint16_t boot;          //!< boot number of the node clock, 0xFFFF in samples logged before it
+} sensor_sample_t;
+
+#ifdef __cplusplus
+}
+#endif
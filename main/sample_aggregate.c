@@ -0,0 +1,300 @@
+#include "sample_aggregate.h"
+#include <string.h>
+
+// Means carry 8 fraction bits, as the filtering stage: pressure in Pa still fits an int32_t
+#define SAMPLE_AGGREGATE_FRAC_BITS 8
+
+#define SAMPLE_SUMMARY_FLAGS_MASK (SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY | SAMPLE_HAS_PRESSURE | \
+                                   SAMPLE_TIME_SYNCED)
+
+static const uint8_t channel_flags[SAMPLE_AGGREGATE_CHANNELS] = {
+    SAMPLE_HAS_TEMPERATURE, SAMPLE_HAS_HUMIDITY, SAMPLE_HAS_PRESSURE,
+};
+
+// Encoded width of the mean of each channel
+static const uint8_t channel_sizes[SAMPLE_AGGREGATE_CHANNELS] = { 2, 2, 4 };
+
+static int32_t channel_get(const sensor_sample_t *sample, int channel)
+{
+    switch (channel) {
+    case 0:
+        return sample->temperature;
+    case 1:
+        return sample->humidity;
+    default:
+        return (int32_t)sample->pressure;
+    }
+}
+
+/* Fixed point value back to sample units, rounded. */
+static int32_t from_fixed(int32_t value)
+{
+    return (value + (1 << (SAMPLE_AGGREGATE_FRAC_BITS - 1))) >> SAMPLE_AGGREGATE_FRAC_BITS;
+}
+
+/* value / n rounded half away from zero, n > 0. */
+static int32_t div_round(int32_t value, int32_t n)
+{
+    return (value >= 0 ? value + n / 2 : value - n / 2) / n;
+}
+
+/* Floor of the square root. */
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+sample_aggregate_t *sample_aggregate_get(sample_aggregate_t *aggregates, size_t count, uint8_t sensor)
+{
+    sample_aggregate_t *free_slot = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        if (aggregates[i].seen == 0) {
+            free_slot = free_slot ? free_slot : &aggregates[i];
+        } else if (aggregates[i].sensor == sensor) {
+            return &aggregates[i];
+        }
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->sensor = sensor;
+    }
+    return free_slot;
+}
+
+bool sample_aggregate_due(const sample_aggregate_t *aggregate, const sample_aggregate_config_t *config,
+                          uint32_t now_s, const sensor_sample_t *next)
+{
+    if (aggregate->count == 0) {
+        return false;
+    }
+    // Timestamps switch to Unix time when the clock gets synchronized: a window takes one clock
+    return now_s - aggregate->opened_s >= config->window_s ||
+           (next && ((next->flags ^ aggregate->flags) & SAMPLE_TIME_SYNCED));
+}
+
+bool sample_aggregate_add(sample_aggregate_t *aggregate, const sample_aggregate_config_t *config,
+                          const sensor_sample_t *sample, uint32_t now_s)
+{
+    bool breach = false;
+
+    if (aggregate->count == 0) {
+        aggregate->opened_s = now_s;
+        aggregate->first = sample->timestamp;
+        aggregate->boot = sample->boot;
+        aggregate->flags = sample->flags & SAMPLE_TIME_SYNCED;
+    }
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        sample_aggregate_channel_t *c = &aggregate->channels[ch];
+        if (!(sample->flags & channel_flags[ch])) {
+            continue;
+        }
+        int32_t value = channel_get(sample, ch);
+        int32_t x = value * (1 << SAMPLE_AGGREGATE_FRAC_BITS);
+
+        if (config->breach[ch] && (aggregate->seen & channel_flags[ch])) {
+            int32_t mean = from_fixed(c->mean);
+            uint32_t departure = value > mean ? (uint32_t)(value - mean) : (uint32_t)(mean - value);
+            breach |= departure >= config->breach[ch];
+        }
+        if (c->count == 0) {
+            c->min = value;
+            c->max = value;
+            c->mean = x;
+            c->m2 = 0;
+            c->count = 1;
+            continue;
+        }
+        // Welford: the mean moves by delta / n, the squared deviations grow by delta times the
+        // distance to the new mean, which never has the other sign as delta
+        int32_t delta = x - c->mean;
+        c->count++;
+        c->mean += div_round(delta, c->count);
+        c->m2 += (uint64_t)((int64_t)delta * (x - c->mean));
+        c->min = value < c->min ? value : c->min;
+        c->max = value > c->max ? value : c->max;
+    }
+    aggregate->seen |= sample->flags & (SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY | SAMPLE_HAS_PRESSURE);
+    aggregate->flags |= sample->flags & (SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY | SAMPLE_HAS_PRESSURE);
+    aggregate->last = sample->timestamp;
+    aggregate->count++;
+    return breach;
+}
+
+bool sample_aggregate_close(sample_aggregate_t *aggregate, sample_summary_t *summary)
+{
+    if (aggregate->count == 0) {
+        return false;
+    }
+    memset(summary, 0, sizeof(*summary));
+    summary->timestamp = aggregate->first;
+    summary->boot = aggregate->boot;
+    summary->span_s = (uint16_t)(aggregate->last - aggregate->first);
+    summary->count = aggregate->count;
+    summary->sensor = aggregate->sensor;
+    summary->flags = aggregate->flags;
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        sample_aggregate_channel_t *c = &aggregate->channels[ch];
+        sample_summary_channel_t *s = &summary->channels[ch];
+        if (c->count == 0) {
+            continue;
+        }
+        s->min = c->min;
+        s->max = c->max;
+        s->mean = from_fixed(c->mean);
+        // Variance in 1/65536 of the squared unit, its square root in 1/256 of the unit
+        s->stddev = (uint32_t)from_fixed((int32_t)isqrt64(c->m2 / c->count));
+        c->count = 0; // the mean stays, for the breaches of the next window's first readings
+    }
+    aggregate->count = 0;
+    aggregate->flags = 0;
+    return true;
+}
+
+static uint8_t *put_value(uint8_t *p, uint32_t value, size_t size)
+{
+    for (size_t b = 0; b < size; b++) {
+        *p++ = (value >> (8 * b)) & 0xFF;
+    }
+    return p;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+/* NULL if the value runs past end. */
+static const uint8_t *get_value(const uint8_t *p, const uint8_t *end, size_t size, uint32_t *value)
+{
+    if ((size_t)(end - p) < size) {
+        return NULL;
+    }
+    *value = 0;
+    for (size_t b = 0; b < size; b++) {
+        *value |= (uint32_t)*p++ << (8 * b);
+    }
+    return p;
+}
+
+/* NULL if the value runs past end or over 32 bits. */
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        *v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+size_t sample_summary_encode(const sample_summary_t *summary, uint8_t *buf, size_t size)
+{
+    uint8_t flags = summary->flags & SAMPLE_SUMMARY_FLAGS_MASK;
+    uint8_t *p = buf;
+
+    if (size < SAMPLE_SUMMARY_MAX_SIZE) {
+        return 0;
+    }
+    *p++ = SAMPLE_SUMMARY_VERSION;
+    *p++ = flags | (summary->sensor << 4);
+    p = put_value(p, summary->timestamp, 4);
+    if (!(flags & SAMPLE_TIME_SYNCED)) {
+        p = put_varint(p, summary->boot);
+    }
+    p = put_varint(p, summary->span_s);
+    p = put_varint(p, summary->count);
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        const sample_summary_channel_t *s = &summary->channels[ch];
+        if (!(flags & channel_flags[ch])) {
+            continue;
+        }
+        p = put_value(p, (uint32_t)s->mean, channel_sizes[ch]);
+        p = put_varint(p, (uint32_t)(s->mean - s->min));
+        p = put_varint(p, (uint32_t)(s->max - s->mean));
+        p = put_varint(p, s->stddev);
+    }
+    return p - buf;
+}
+
+bool sample_summary_decode(const uint8_t *buf, size_t len, sample_summary_t *summary)
+{
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + len;
+    uint32_t v[4];
+
+    if (len < 2 || buf[0] != SAMPLE_SUMMARY_VERSION) {
+        return false;
+    }
+    memset(summary, 0, sizeof(*summary));
+    summary->flags = buf[1] & SAMPLE_SUMMARY_FLAGS_MASK;
+    summary->sensor = buf[1] >> 4;
+    p = get_value(p + 2, end, 4, &summary->timestamp);
+    v[0] = 0xFFFF;
+    if (p && !(summary->flags & SAMPLE_TIME_SYNCED)) {
+        p = get_varint(p, end, &v[0]);
+    }
+    p = p ? get_varint(p, end, &v[1]) : NULL;
+    p = p ? get_varint(p, end, &v[2]) : NULL;
+    if (!p) {
+        return false;
+    }
+    summary->boot = (uint16_t)v[0];
+    summary->span_s = (uint16_t)v[1];
+    summary->count = (uint16_t)v[2];
+    for (int ch = 0; ch < SAMPLE_AGGREGATE_CHANNELS; ch++) {
+        sample_summary_channel_t *s = &summary->channels[ch];
+        if (!(summary->flags & channel_flags[ch])) {
+            continue;
+        }
+        p = get_value(p, end, channel_sizes[ch], &v[0]);
+        for (int i = 1; i < 4 && p; i++) {
+            p = get_varint(p, end, &v[i]);
+        }
+        if (!p) {
+            return false;
+        }
+        // The mean back in the type of its sample field
+        s->mean = ch == 0 ? (int16_t)v[0] : (int32_t)v[0];
+        s->min = s->mean - (int32_t)v[1];
+        s->max = s->mean + (int32_t)v[2];
+        s->stddev = v[3];
+    }
+    return p == end;
+}
+
+void sample_summary_mean(const sample_summary_t *summary, sensor_sample_t *sample)
+{
+    *sample = (sensor_sample_t){
+        .timestamp = summary->timestamp,
+        .temperature = (int16_t)summary->channels[0].mean,
+        .humidity = (uint16_t)summary->channels[1].mean,
+        .pressure = (uint32_t)summary->channels[2].mean,
+        .sensor = summary->sensor,
+        .flags = summary->flags,
+        .boot = summary->boot,
+    };
+}
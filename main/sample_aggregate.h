@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Aggregation stage: the readings of a sensor go into windows of a fixed length, each kept as
+ * running minimum, maximum, mean and sum of squared deviations (Welford's method, fixed point),
+ * so a window takes the same memory and the same work per reading whatever its length. A closed
+ * window gives one summary, published in place of its readings. Little endian:
+ *
+ *   u8  version (SAMPLE_SUMMARY_VERSION)
+ *   u8  SAMPLE_HAS_* and SAMPLE_TIME_SYNCED flags in bits 0..3, sensor (SAMPLE_SENSOR_ID) in bits 4..7
+ *   u32 timestamp of the first reading, seconds
+ *   var boot of the node clock         if not SAMPLE_TIME_SYNCED
+ *   var timestamp of the last reading minus the one of the first, seconds
+ *   var number of readings
+ *   per channel, temperature, humidity, pressure, if its SAMPLE_HAS_* flag is set:
+ *     mean, in the width and unit of the sample field (i16, u16, u32)
+ *     var mean minus minimum
+ *     var maximum minus mean
+ *     var population standard deviation
+ *
+ * var: unsigned LEB128, as in sample_codec.h: the spread of a window takes a byte or two.
+ * A channel missing from some readings is summarized over the readings that have it.
+ */
+#define SAMPLE_SUMMARY_VERSION 1
+// Buffer size that always fits an encoded summary
+#define SAMPLE_SUMMARY_MAX_SIZE (1 + 1 + 4 + 3 * 3 + (2 + 3 * 3) + (2 + 3 * 3) + (4 + 3 * 5))
+// Temperature, humidity, pressure, in the order of the SAMPLE_HAS_* bits
+#define SAMPLE_AGGREGATE_CHANNELS 3
+
+/**
+ * Window length and raw passthrough
+ */
+typedef struct
+{
+    uint32_t window_s;          //!< window length, node clock seconds
+    uint32_t breach[SAMPLE_AGGREGATE_CHANNELS]; //!< departure from the window mean that also passes a reading
+                                                //!< on raw, in sample units; 0 for never
+} sample_aggregate_config_t;
+
+/**
+ * Running statistics of one channel over a window
+ */
+typedef struct
+{
+    uint64_t m2;                //!< sum of squared deviations from the mean, 1/65536 of the squared unit
+    int32_t mean;               //!< 1/256 of the sample unit, kept from the last window while a new one is empty
+    int32_t min;
+    int32_t max;
+    uint16_t count;             //!< readings of the channel in the window
+} sample_aggregate_channel_t;
+
+/**
+ * Window of one sensor. All zeros is a free slot.
+ */
+typedef struct
+{
+    sample_aggregate_channel_t channels[SAMPLE_AGGREGATE_CHANNELS];
+    uint32_t opened_s;          //!< node clock at the first reading of the window
+    uint32_t first;             //!< timestamps of the first and last readings
+    uint32_t last;
+    uint16_t count;             //!< readings in the window, 0 for an empty one
+    uint16_t boot;              //!< boot of the first reading
+    uint8_t sensor;             //!< SAMPLE_SENSOR_ID of the sensor
+    uint8_t flags;              //!< SAMPLE_HAS_* of the channels read in the window, SAMPLE_TIME_SYNCED of the first
+    uint8_t seen;               //!< SAMPLE_HAS_* of the channels with a mean, 0 for a free slot
+} sample_aggregate_t;
+
+/**
+ * Statistics of one channel over a closed window, in sample units
+ */
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    uint32_t stddev;            //!< population standard deviation
+} sample_summary_channel_t;
+
+/**
+ * A closed window
+ */
+typedef struct
+{
+    sample_summary_channel_t channels[SAMPLE_AGGREGATE_CHANNELS];
+    uint32_t timestamp;         //!< of the first reading, Unix time with SAMPLE_TIME_SYNCED
+    uint16_t boot;              //!< boot of the node clock, without SAMPLE_TIME_SYNCED
+    uint16_t span_s;            //!< last reading minus first one
+    uint16_t count;             //!< readings in the window
+    uint8_t sensor;             //!< SAMPLE_SENSOR_ID()
+    uint8_t flags;              //!< SAMPLE_HAS_* of the channels summarized, SAMPLE_TIME_SYNCED
+} sample_summary_t;
+
+/**
+  * @brief  Window of a sensor among an array of them, a free slot claimed for a new one.
+  *
+  * @param  aggregates windows, zeroed before first use
+  * @param  count entries in aggregates
+  * @param  sensor SAMPLE_SENSOR_ID of the reading
+  *
+  * @return the window of that sensor, NULL if there is none and no free slot
+  */
+sample_aggregate_t *sample_aggregate_get(sample_aggregate_t *aggregates, size_t count, uint8_t sensor);
+
+/**
+  * @brief  Whether a window is to be closed before taking a reading: it holds readings and is
+  *         window_s old, or the reading's timestamp is not on the same clock as its first one.
+  *
+  * @param  aggregate window of the sensor
+  * @param  config window length
+  * @param  now_s node clock now
+  * @param  next reading about to be added, NULL when checking the time only
+  */
+bool sample_aggregate_due(const sample_aggregate_t *aggregate, const sample_aggregate_config_t *config,
+                          uint32_t now_s, const sensor_sample_t *next);
+
+/**
+  * @brief  Add a reading to the window. The first one opens it. Close a due window first.
+  *
+  * @param  aggregate window of the reading's sensor
+  * @param  config breach thresholds
+  * @param  sample reading with its timestamp set
+  * @param  now_s node clock now
+  *
+  * @return true if a channel departs from the mean of the readings before it by its breach
+  *         threshold: the reading is to be published raw as well. The first reading of a window
+  *         is checked against the mean of the last window.
+  */
+bool sample_aggregate_add(sample_aggregate_t *aggregate, const sample_aggregate_config_t *config,
+                          const sensor_sample_t *sample, uint32_t now_s);
+
+/**
+  * @brief  Close the window: summarize it and empty it for the next readings.
+  *
+  * @param  aggregate window to close
+  * @param  summary output
+  *
+  * @return false if the window held no reading, summary then untouched
+  */
+bool sample_aggregate_close(sample_aggregate_t *aggregate, sample_summary_t *summary);
+
+/**
+  * @brief  Encode a summary.
+  *
+  * @param  summary summary to encode
+  * @param  buf output buffer
+  * @param  size size of buf, SAMPLE_SUMMARY_MAX_SIZE is always enough
+  *
+  * @return number of bytes written, 0 if buf is too small
+  */
+size_t sample_summary_encode(const sample_summary_t *summary, uint8_t *buf, size_t size);
+
+/**
+  * @brief  Decode a summary, for tools. Channels left out are zero, flags tell which are valid.
+  *
+  * @return true on success, false if the message is malformed or of another version
+  */
+bool sample_summary_decode(const uint8_t *buf, size_t len, sample_summary_t *summary);
+
+/**
+  * @brief  The means of a summary as one sample stamped with its first reading, for the
+  *         offline log, which only holds samples.
+  */
+void sample_summary_mean(const sample_summary_t *summary, sensor_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,200 @@
+#include "sample_codec.h"
+#include <string.h>
+#include <stdbool.h>
+
+#define SAMPLE_CODEC_FLAGS_MASK 0x0F
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+/* NULL if the value runs past end or over 32 bits. */
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        *v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static size_t varint_size(uint32_t v)
+{
+    size_t size = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static uint32_t zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static uint32_t unzigzag(uint32_t v)
+{
+    return (v >> 1) ^ -(v & 1);
+}
+
+static size_t values_size(uint8_t flags)
+{
+    return ((flags & SAMPLE_HAS_TEMPERATURE) ? 2 : 0) + ((flags & SAMPLE_HAS_HUMIDITY) ? 2 : 0) +
+           ((flags & SAMPLE_HAS_PRESSURE) ? 4 : 0);
+}
+
+static size_t sample_encoded_size(const sensor_sample_t *s, uint32_t previous, bool first)
+{
+    uint8_t flags = s->flags & SAMPLE_CODEC_FLAGS_MASK;
+
+    return 1 + (first ? 0 : varint_size(zigzag(s->timestamp - previous))) +
+           ((flags & SAMPLE_TIME_SYNCED) ? 0 : varint_size(s->boot)) + values_size(flags);
+}
+
+size_t sample_codec_encode(const sensor_sample_t *samples, size_t count, uint8_t *buf, size_t size)
+{
+    size_t len = SAMPLE_CODEC_HEADER_SIZE;
+
+    if (count == 0 || count > SAMPLE_CODEC_MAX_SAMPLES || size < SAMPLE_CODEC_HEADER_SIZE) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        len += sample_encoded_size(&samples[i], i ? samples[i - 1].timestamp : 0, i == 0);
+    }
+    if (len > size) {
+        return 0;
+    }
+
+    uint8_t *p = buf;
+    *p++ = SAMPLE_CODEC_VERSION;
+    *p++ = count;
+    p = put_u32(p, samples[0].timestamp);
+    for (size_t i = 0; i < count; i++) {
+        const sensor_sample_t *s = &samples[i];
+        uint8_t flags = s->flags & SAMPLE_CODEC_FLAGS_MASK;
+
+        *p++ = flags | (s->sensor << 4);
+        if (i > 0) {
+            p = put_varint(p, zigzag(s->timestamp - samples[i - 1].timestamp));
+        }
+        if (!(flags & SAMPLE_TIME_SYNCED)) {
+            p = put_varint(p, s->boot);
+        }
+        if (flags & SAMPLE_HAS_TEMPERATURE) {
+            p = put_u16(p, (uint16_t)s->temperature);
+        }
+        if (flags & SAMPLE_HAS_HUMIDITY) {
+            p = put_u16(p, s->humidity);
+        }
+        if (flags & SAMPLE_HAS_PRESSURE) {
+            p = put_u32(p, s->pressure);
+        }
+    }
+    return len;
+}
+
+size_t sample_codec_decode(const uint8_t *buf, size_t len, sensor_sample_t *samples, size_t max)
+{
+    const uint8_t *end = buf + len;
+
+    if (len < 2 || (buf[0] != SAMPLE_CODEC_VERSION && buf[0] != 1) || buf[1] > max) {
+        return 0;
+    }
+    bool v1 = buf[0] == 1;
+    const uint8_t *p = buf + 2;
+    uint32_t timestamp = 0;
+    if (!v1) {
+        if (len < SAMPLE_CODEC_HEADER_SIZE) {
+            return 0;
+        }
+        timestamp = get_u32(p);
+        p += 4;
+    }
+
+    size_t count = buf[1];
+    for (size_t i = 0; i < count; i++) {
+        sensor_sample_t *s = &samples[i];
+        uint32_t value;
+
+        if (p >= end) {
+            return 0;
+        }
+        memset(s, 0, sizeof(*s));
+        s->boot = 0xFFFF;
+        s->flags = *p & SAMPLE_CODEC_FLAGS_MASK;
+        s->sensor = *p++ >> 4;
+        if (v1) {
+            s->flags &= ~SAMPLE_TIME_SYNCED;
+            if (end - p < 4) {
+                return 0;
+            }
+            timestamp = get_u32(p);
+            p += 4;
+        } else if (i > 0) {
+            if (!(p = get_varint(p, end, &value))) {
+                return 0;
+            }
+            timestamp += unzigzag(value);
+        }
+        s->timestamp = timestamp;
+        if (!v1 && !(s->flags & SAMPLE_TIME_SYNCED)) {
+            if (!(p = get_varint(p, end, &value)) || value > UINT16_MAX) {
+                return 0;
+            }
+            s->boot = value;
+        }
+        if ((size_t)(end - p) < values_size(s->flags)) {
+            return 0;
+        }
+        if (s->flags & SAMPLE_HAS_TEMPERATURE) {
+            s->temperature = (int16_t)get_u16(p);
+            p += 2;
+        }
+        if (s->flags & SAMPLE_HAS_HUMIDITY) {
+            s->humidity = get_u16(p);
+            p += 2;
+        }
+        if (s->flags & SAMPLE_HAS_PRESSURE) {
+            s->pressure = get_u32(p);
+            p += 4;
+        }
+    }
+    return p == end ? count : 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary batch of samples, as published on the samples topics. Little endian:
+ *
+ *   u8  version (SAMPLE_CODEC_VERSION)
+ *   u8  number of samples
+ *   u32 timestamp of the first sample, seconds
+ *   per sample:
+ *     u8  SAMPLE_HAS_* and SAMPLE_TIME_SYNCED flags in bits 0..3, sensor (SAMPLE_SENSOR_ID) in bits 4..7
+ *     var timestamp minus the one of the previous sample, zigzag   except the first sample
+ *     var boot of the node clock                                   if not SAMPLE_TIME_SYNCED
+ *     i16 temperature, 0.01 degC   if SAMPLE_HAS_TEMPERATURE
+ *     u16 humidity, 0.01 %RH       if SAMPLE_HAS_HUMIDITY
+ *     u32 pressure, Pa             if SAMPLE_HAS_PRESSURE
+ *
+ * var: unsigned LEB128, 7 bits per byte from the lowest, bit 7 set on all bytes but the last.
+ * Zigzag maps a signed difference d, taken modulo 2^32, to (d << 1) ^ (d >> 31): samples a
+ * few seconds apart take one byte, and the difference may be negative, across a sync or with
+ * logged samples. Version 1 batches, without the header timestamp, with a u32 timestamp per
+ * sample and no boot, are still decoded.
+ */
+#define SAMPLE_CODEC_VERSION 2
+#define SAMPLE_CODEC_HEADER_SIZE (2 + 4)
+#define SAMPLE_CODEC_MAX_SAMPLE_SIZE (1 + 5 + 3 + 2 + 2 + 4)
+#define SAMPLE_CODEC_MAX_SAMPLES 255
+
+// Buffer size that always fits a batch of n samples
+#define SAMPLE_CODEC_BATCH_SIZE(n) (SAMPLE_CODEC_HEADER_SIZE + (n) * SAMPLE_CODEC_MAX_SAMPLE_SIZE)
+
+/**
+  * @brief  Encode samples into one batch.
+  *
+  * @param  samples samples to encode, oldest first
+  * @param  count number of samples, 1 to SAMPLE_CODEC_MAX_SAMPLES
+  * @param  buf output buffer
+  * @param  size size of buf, SAMPLE_CODEC_BATCH_SIZE(count) is always enough
+  *
+  * @return number of bytes written, 0 if count is out of range or buf is too small
+  */
+size_t sample_codec_encode(const sensor_sample_t *samples, size_t count, uint8_t *buf, size_t size);
+
+/**
+  * @brief  Decode a batch. Fields absent from a sample are zero, flags tell which are valid;
+  *         boot is 0xFFFF in synced samples and version 1 batches.
+  *
+  * @param  buf encoded batch
+  * @param  len length of the batch
+  * @param  samples output samples
+  * @param  max capacity of samples
+  *
+  * @return number of samples decoded, 0 if the batch is malformed or has more than max samples
+  */
+size_t sample_codec_decode(const uint8_t *buf, size_t len, sensor_sample_t *samples, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+#include "sample_filter.h"
+#include <string.h>
+
+_Static_assert(SAMPLE_FILTER_MEDIAN_N % 2 == 1, "SAMPLE_FILTER_MEDIAN_N must be odd");
+
+// Smoothed values carry 8 fraction bits: pressure in Pa still fits an int32_t
+#define SAMPLE_FILTER_FRAC_BITS 8
+
+static const uint8_t channel_flags[SAMPLE_FILTER_CHANNELS] = {
+    SAMPLE_HAS_TEMPERATURE, SAMPLE_HAS_HUMIDITY, SAMPLE_HAS_PRESSURE,
+};
+
+static int32_t channel_get(const sensor_sample_t *sample, int channel)
+{
+    switch (channel) {
+    case 0:
+        return sample->temperature;
+    case 1:
+        return sample->humidity;
+    default:
+        return (int32_t)sample->pressure;
+    }
+}
+
+static void channel_set(sensor_sample_t *sample, int channel, int32_t value)
+{
+    switch (channel) {
+    case 0:
+        sample->temperature = (int16_t)value;
+        break;
+    case 1:
+        sample->humidity = (uint16_t)value;
+        break;
+    default:
+        sample->pressure = (uint32_t)value;
+        break;
+    }
+}
+
+/* Median of the first count values, count odd or not (the lower one of the middle two). */
+static int32_t median(const int32_t *values, size_t count)
+{
+    int32_t sorted[SAMPLE_FILTER_MEDIAN_N];
+
+    memcpy(sorted, values, count * sizeof(*values));
+    for (size_t i = 1; i < count; i++) {
+        int32_t v = sorted[i];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    return sorted[(count - 1) / 2];
+}
+
+sample_filter_t *sample_filter_get(sample_filter_t *filters, size_t count, uint8_t sensor)
+{
+    sample_filter_t *free_slot = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        if (filters[i].readings == 0) {
+            free_slot = free_slot ? free_slot : &filters[i];
+        } else if (filters[i].sensor == sensor) {
+            return &filters[i];
+        }
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->sensor = sensor;
+    }
+    return free_slot;
+}
+
+bool sample_filter_apply(sample_filter_t *filter, const sample_filter_config_t *config, sensor_sample_t *sample)
+{
+    bool first = filter->readings == 0;
+    size_t readings = filter->readings < SAMPLE_FILTER_MEDIAN_N ? filter->readings + 1u : SAMPLE_FILTER_MEDIAN_N;
+    bool publish = config->heartbeat_s && sample->timestamp - filter->sent_at >= config->heartbeat_s;
+
+    for (int ch = 0; ch < SAMPLE_FILTER_CHANNELS; ch++) {
+        sample_filter_channel_t *c = &filter->channels[ch];
+        if (!(sample->flags & channel_flags[ch])) {
+            continue;
+        }
+        c->window[filter->next] = channel_get(sample, ch);
+        int32_t m = median(c->window, readings) * (1 << SAMPLE_FILTER_FRAC_BITS);
+        c->smoothed = first ? m : c->smoothed + ((m - c->smoothed) >> config->ewma_shift);
+        int32_t value = (c->smoothed + (1 << (SAMPLE_FILTER_FRAC_BITS - 1))) >> SAMPLE_FILTER_FRAC_BITS;
+        channel_set(sample, ch, value);
+
+        uint32_t change = value > c->sent ? (uint32_t)(value - c->sent) : (uint32_t)(c->sent - value);
+        if (!(filter->sent & channel_flags[ch]) || change >= config->deadband[ch]) {
+            publish = true;
+        }
+    }
+    filter->readings = (uint8_t)readings;
+    filter->next = (filter->next + 1) % SAMPLE_FILTER_MEDIAN_N;
+
+    if (publish) {
+        for (int ch = 0; ch < SAMPLE_FILTER_CHANNELS; ch++) {
+            if (sample->flags & channel_flags[ch]) {
+                filter->channels[ch].sent = channel_get(sample, ch);
+            }
+        }
+        filter->sent |= sample->flags;
+        filter->sent_at = sample->timestamp;
+    }
+    return publish;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Readings in the median window, odd: 3 rejects a single-reading spike
+#define SAMPLE_FILTER_MEDIAN_N 3
+// Temperature, humidity, pressure, in the order of the SAMPLE_HAS_* bits
+#define SAMPLE_FILTER_CHANNELS 3
+
+/**
+ * When a filtered sample is worth publishing
+ */
+typedef struct
+{
+    uint8_t ewma_shift;         //!< smoothing factor 1/2^ewma_shift, 0 for none
+    uint32_t deadband[SAMPLE_FILTER_CHANNELS]; //!< change from the last published value that publishes, in
+                                               //!< sample units (0.01 degC, 0.01 %RH, Pa); 0 publishes every sample
+    uint32_t heartbeat_s;       //!< publish at least this often when nothing changes, 0 for never
+} sample_filter_config_t;
+
+/**
+ * One channel of a sensor: median window, smoothed value, last published value
+ */
+typedef struct
+{
+    int32_t window[SAMPLE_FILTER_MEDIAN_N]; //!< last readings, circular
+    int32_t smoothed;                       //!< EWMA of the medians, 1/256 of the sample unit
+    int32_t sent;                           //!< value last passed on for publishing
+} sample_filter_channel_t;
+
+/**
+ * Filter state of one sensor. All zeros is a free slot, so it can live in RTC memory
+ * and be cleared with it.
+ */
+typedef struct
+{
+    sample_filter_channel_t channels[SAMPLE_FILTER_CHANNELS];
+    uint32_t sent_at;           //!< timestamp of the last sample passed on
+    uint8_t sensor;             //!< SAMPLE_SENSOR_ID of the sensor
+    uint8_t readings;           //!< readings in the windows, up to SAMPLE_FILTER_MEDIAN_N; 0 for a free slot
+    uint8_t next;               //!< window slot of the next reading
+    uint8_t sent;               //!< SAMPLE_HAS_* bits of the channels passed on at least once
+} sample_filter_t;
+
+/**
+  * @brief  Filter state of a sensor among an array of them, a free slot claimed for a new one.
+  *
+  * @param  filters filter states, zeroed before first use
+  * @param  count entries in filters
+  * @param  sensor SAMPLE_SENSOR_ID of the sample
+  *
+  * @return the filter of that sensor, NULL if there is none and no free slot
+  */
+sample_filter_t *sample_filter_get(sample_filter_t *filters, size_t count, uint8_t sensor);
+
+/**
+  * @brief  Run a sample through the filter: median of the last SAMPLE_FILTER_MEDIAN_N readings
+  *         against spikes, then EWMA smoothing. The sample is passed on when a channel moved
+  *         by its deadband since the last sample passed on, when the heartbeat is due, and for
+  *         the first sample.
+  *
+  * @param  filter state of the sample's sensor
+  * @param  config publishing policy
+  * @param  sample sample with its timestamp set, its values replaced with the filtered ones
+  *
+  * @return true if the sample is to be published, false if it brings nothing new
+  */
+bool sample_filter_apply(sample_filter_t *filter, const sample_filter_config_t *config, sensor_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
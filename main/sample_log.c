@@ -0,0 +1,371 @@
+/*
+ * Offline sample log: an append-only ring of flash sectors.
+ *
+ * Each sector starts with a header carrying a sequence number that grows by one
+ * every time a sector is (re)formatted; the sector with the highest one is the
+ * head, the next sector is the oldest. Records are appended into the head and
+ * never rewritten, except for clearing the state half-word once delivered,
+ * which only turns bits from 1 to 0. When the head is full the oldest sector is
+ * erased and becomes the new head, so every sector sees the same number of
+ * erases.
+ *
+ * Power loss: a record is only trusted when its CRC matches, so a torn record is
+ * skipped on the next boot and writing resumes after it. A sector erased without
+ * its header written yet reads as blank and is erased again when reached.
+ */
+#include "sample_log.h"
+#include <string.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h> // SPI_FLASH_SEC_SIZE
+#include <esp_log.h>
+#include "crc.h"
+
+#define SAMPLE_LOG_MAGIC 0x474F4C53 // "SLOG"
+#define SAMPLE_LOG_HEADER_SIZE 16
+#define SAMPLE_LOG_RECORD_SIZE 24
+#define SAMPLE_LOG_SLOTS ((SPI_FLASH_SEC_SIZE - SAMPLE_LOG_HEADER_SIZE) / SAMPLE_LOG_RECORD_SIZE)
+
+#define SAMPLE_LOG_STATE_UNSENT 0xFFFF
+#define SAMPLE_LOG_STATE_SENT 0x0000
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv;   // ~seq, catches a torn header
+    uint32_t reserved;
+} sample_log_header_t;
+
+typedef struct
+{
+    uint32_t seq;
+    sensor_sample_t sample;
+    uint16_t crc;       // over seq and sample
+    uint16_t state;     // SAMPLE_LOG_STATE_*, rewritten in place with the crc word
+} sample_log_record_t;
+
+_Static_assert(sizeof(sample_log_header_t) == SAMPLE_LOG_HEADER_SIZE, "sample log header size");
+_Static_assert(sizeof(sample_log_record_t) == SAMPLE_LOG_RECORD_SIZE, "sample log record size");
+
+typedef enum
+{
+    RECORD_EMPTY = 0,
+    RECORD_UNSENT,
+    RECORD_SENT,
+    RECORD_TORN
+} record_status_t;
+
+typedef struct
+{
+    uint16_t sector;
+    uint16_t slot;
+} log_pos_t;
+
+static const char *TAG = "SAMPLE_LOG";
+
+static const esp_partition_t *log_partition;
+static uint16_t log_sectors;
+static uint32_t log_head_seq;       // header seq of the head sector
+static log_pos_t log_head;          // next slot to write
+static log_pos_t log_tail;          // oldest unsent record, valid when log_pending > 0
+static uint32_t log_next_record;    // seq of the next record
+static uint32_t log_pending;
+static uint32_t log_dropped;
+
+static size_t log_slot_offset(log_pos_t pos)
+{
+    return (size_t)pos.sector * SPI_FLASH_SEC_SIZE + SAMPLE_LOG_HEADER_SIZE + (size_t)pos.slot * SAMPLE_LOG_RECORD_SIZE;
+}
+
+static void log_pos_advance(log_pos_t *pos)
+{
+    if (++pos->slot == SAMPLE_LOG_SLOTS) {
+        pos->slot = 0;
+        pos->sector = (pos->sector + 1) % log_sectors;
+    }
+}
+
+/* Position after the newest record, as reached by log_pos_advance. */
+static log_pos_t log_end(void)
+{
+    log_pos_t end = log_head;
+    if (end.slot == SAMPLE_LOG_SLOTS) {
+        end.slot = 0;
+        end.sector = (end.sector + 1) % log_sectors;
+    }
+    return end;
+}
+
+static bool log_pos_equal(log_pos_t a, log_pos_t b)
+{
+    return a.sector == b.sector && a.slot == b.slot;
+}
+
+static uint16_t log_record_crc(const sample_log_record_t *record)
+{
+    return crc16_ccitt(0xFFFF, record, offsetof(sample_log_record_t, crc));
+}
+
+static bool log_read_header(uint16_t sector, uint32_t *seq)
+{
+    sample_log_header_t header;
+
+    if (esp_partition_read(log_partition, (size_t)sector * SPI_FLASH_SEC_SIZE, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    if (header.magic != SAMPLE_LOG_MAGIC || header.seq_inv != ~header.seq) {
+        return false;
+    }
+    *seq = header.seq;
+    return true;
+}
+
+static record_status_t log_read_record(log_pos_t pos, sample_log_record_t *record)
+{
+    static const uint32_t erased[SAMPLE_LOG_RECORD_SIZE / 4] = {
+        0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF
+    };
+
+    if (esp_partition_read(log_partition, log_slot_offset(pos), record, sizeof(*record)) != ESP_OK) {
+        return RECORD_TORN;
+    }
+    if (memcmp(record, erased, sizeof(*record)) == 0) {
+        return RECORD_EMPTY;
+    }
+    if (record->crc != log_record_crc(record)) {
+        return RECORD_TORN;
+    }
+    // A torn state write has already cleared some bits: the record was delivered.
+    return record->state == SAMPLE_LOG_STATE_UNSENT ? RECORD_UNSENT : RECORD_SENT;
+}
+
+/* Erase a sector and make it the head. Unsent records in it are lost. */
+static esp_err_t log_format_sector(uint16_t sector)
+{
+    sample_log_header_t header = {
+        .magic = SAMPLE_LOG_MAGIC,
+        .seq = log_head_seq + 1,
+        .seq_inv = ~(log_head_seq + 1),
+        .reserved = 0xFFFFFFFF,
+    };
+    esp_err_t err;
+
+    err = esp_partition_erase_range(log_partition, (size_t)sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_partition_write(log_partition, (size_t)sector * SPI_FLASH_SEC_SIZE, &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+    log_head_seq = header.seq;
+    log_head.sector = sector;
+    log_head.slot = 0;
+    return ESP_OK;
+}
+
+/* Move the head to the oldest sector, dropping what is still unsent in it. */
+static esp_err_t log_advance_head(void)
+{
+    uint16_t next = (log_head.sector + 1) % log_sectors;
+    uint32_t seq;
+
+    if (log_pending > 0 && log_read_header(next, &seq)) {
+        sample_log_record_t record;
+        uint32_t lost = 0;
+        for (log_pos_t pos = { next, 0 }; pos.sector == next; log_pos_advance(&pos)) {
+            if (log_read_record(pos, &record) == RECORD_UNSENT) {
+                lost++;
+            }
+        }
+        if (lost > 0) {
+            ESP_LOGW(TAG, "Log full, dropping %u unsent samples", lost);
+            log_pending -= lost;
+            log_dropped += lost;
+            log_tail.sector = (next + 1) % log_sectors;
+            log_tail.slot = 0;
+        }
+    }
+    return log_format_sector(next);
+}
+
+/* Find the oldest unsent record and count the unsent ones from there to the head. */
+static void log_recover_tail(void)
+{
+    sample_log_record_t record;
+    log_pos_t end = log_end();
+    bool found = false;
+
+    log_pending = 0;
+    for (uint16_t i = 1; i <= log_sectors; i++) {
+        uint16_t sector = (log_head.sector + i) % log_sectors;
+        uint32_t seq;
+
+        if (!log_read_header(sector, &seq)) {
+            continue;
+        }
+        // Delivery is in order: a sector whose last record is sent has nothing left.
+        log_pos_t last = { sector, SAMPLE_LOG_SLOTS - 1 };
+        if (!found && sector != log_head.sector && log_read_record(last, &record) == RECORD_SENT) {
+            continue;
+        }
+        for (log_pos_t pos = { sector, 0 }; pos.sector == sector; log_pos_advance(&pos)) {
+            if (log_pos_equal(pos, end)) {
+                break;
+            }
+            if (log_read_record(pos, &record) != RECORD_UNSENT) {
+                continue;
+            }
+            if (!found) {
+                log_tail = pos;
+                found = true;
+            }
+            log_pending++;
+        }
+    }
+}
+
+esp_err_t sample_log_init(void)
+{
+    sample_log_record_t record;
+    bool found = false;
+
+    log_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                             SAMPLE_LOG_PARTITION_LABEL);
+    if (!log_partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    log_sectors = log_partition->size / SPI_FLASH_SEC_SIZE;
+    if (log_sectors < 2) {
+        log_partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    log_head_seq = 0;
+    for (uint16_t sector = 0; sector < log_sectors; sector++) {
+        uint32_t seq;
+        if (log_read_header(sector, &seq) && (!found || seq > log_head_seq)) {
+            log_head_seq = seq;
+            log_head.sector = sector;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "No log found, formatting %u sectors", log_sectors);
+        log_next_record = 0;
+        log_pending = 0;
+        esp_err_t err = log_format_sector(0);
+        if (err != ESP_OK) {
+            log_partition = NULL;
+        }
+        return err;
+    }
+
+    // Writing resumes after the last programmed slot, torn or not.
+    log_next_record = 0;
+    log_head.slot = 0;
+    for (log_pos_t pos = { log_head.sector, 0 }; pos.sector == log_head.sector; log_pos_advance(&pos)) {
+        record_status_t status = log_read_record(pos, &record);
+        if (status == RECORD_EMPTY) {
+            continue;
+        }
+        log_head.slot = pos.slot + 1;
+        if (status != RECORD_TORN && record.seq >= log_next_record) {
+            log_next_record = record.seq + 1;
+        }
+    }
+
+    log_recover_tail();
+    ESP_LOGI(TAG, "Log mounted: %u sectors, head %u/%u, %u samples pending",
+             log_sectors, log_head.sector, log_head.slot, log_pending);
+    return ESP_OK;
+}
+
+esp_err_t sample_log_append(const sensor_sample_t *sample)
+{
+    sample_log_record_t record;
+    esp_err_t err;
+
+    if (!log_partition) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (log_head.slot == SAMPLE_LOG_SLOTS) {
+        err = log_advance_head();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    record.seq = log_next_record;
+    record.sample = *sample;
+    record.crc = log_record_crc(&record);
+    record.state = SAMPLE_LOG_STATE_UNSENT;
+
+    log_pos_t pos = log_head;
+    // The slot is consumed even if the write fails half way: it may hold a torn record.
+    log_head.slot++;
+    err = esp_partition_write(log_partition, log_slot_offset(pos), &record, sizeof(record));
+    if (err != ESP_OK) {
+        return err;
+    }
+    log_next_record++;
+    if (log_pending++ == 0) {
+        log_tail = pos;
+    }
+    return ESP_OK;
+}
+
+uint32_t sample_log_pending(void)
+{
+    return log_pending;
+}
+
+size_t sample_log_peek(sensor_sample_t *samples, size_t max)
+{
+    sample_log_record_t record;
+    log_pos_t end = log_end();
+    size_t count = 0;
+
+    if (log_pending == 0) {
+        return 0;
+    }
+    for (log_pos_t pos = log_tail; count < max && !log_pos_equal(pos, end); log_pos_advance(&pos)) {
+        if (log_read_record(pos, &record) == RECORD_UNSENT) {
+            samples[count++] = record.sample;
+        }
+    }
+    return count;
+}
+
+esp_err_t sample_log_mark_sent(size_t count)
+{
+    sample_log_record_t record;
+
+    if (count > log_pending) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (count > 0) {
+        log_pos_t pos = log_tail;
+        log_pos_advance(&log_tail);
+        if (log_read_record(pos, &record) != RECORD_UNSENT) {
+            continue;
+        }
+        // Rewrite the last word: same CRC bits, state bits cleared.
+        record.state = SAMPLE_LOG_STATE_SENT;
+        esp_err_t err = esp_partition_write(log_partition, log_slot_offset(pos) + offsetof(sample_log_record_t, crc),
+                                            &record.crc, sizeof(record.crc) + sizeof(record.state));
+        if (err != ESP_OK) {
+            log_tail = pos;
+            return err;
+        }
+        log_pending--;
+        count--;
+    }
+    return ESP_OK;
+}
+
+uint32_t sample_log_dropped(void)
+{
+    return log_dropped;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Data partition holding the log, see partitions.csv
+#define SAMPLE_LOG_PARTITION_LABEL "samples"
+
+/**
+  * @brief  Mount the offline sample log on the "samples" partition.
+  *         Scans the partition to recover the write position and the oldest unsent sample,
+  *         formatting it if it holds no log. Records torn by a power loss are skipped.
+  *
+  *         The log is a ring of flash sectors written in turn, so erases are spread evenly
+  *         over the partition. When it is full, the oldest sector is erased, unsent samples
+  *         in it included (see sample_log_dropped).
+  *
+  *         The sample_log functions are not thread safe: call them from one task.
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_NOT_FOUND No "samples" partition in the partition table
+  *     - ESP_ERR_INVALID_SIZE Partition smaller than two sectors
+  *     - others Flash error
+  */
+esp_err_t sample_log_init(void);
+
+/**
+  * @brief  Append a sample to the log. The sample is durable once this returns ESP_OK.
+  *
+  * @param  sample sample to store
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_STATE sample_log_init was not called
+  *     - others Flash error
+  */
+esp_err_t sample_log_append(const sensor_sample_t *sample);
+
+/**
+  * @brief  Number of samples stored and not yet marked as sent.
+  */
+uint32_t sample_log_pending(void);
+
+/**
+  * @brief  Copy the oldest unsent samples without consuming them.
+  *
+  * @param  samples output buffer
+  * @param  max capacity of samples
+  *
+  * @return number of samples copied, at most max
+  */
+size_t sample_log_peek(sensor_sample_t *samples, size_t max);
+
+/**
+  * @brief  Mark the oldest count unsent samples as sent, once they have been delivered.
+  *         A power loss between delivery and this call delivers them again after reboot.
+  *
+  * @param  count number of samples, normally the value returned by sample_log_peek
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_ARG More than sample_log_pending samples
+  *     - others Flash error
+  */
+esp_err_t sample_log_mark_sent(size_t count);
+
+/**
+  * @brief  Unsent samples lost because the log wrapped around over them since boot.
+  */
+uint32_t sample_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+#include "sample_rate.h"
+#include <string.h>
+
+// Weight of a new reading in the mean: 1/4, a few periods of memory at any period
+#define SAMPLE_RATE_MEAN_SHIFT 2
+#define SAMPLE_RATE_FRAC_BITS 8
+
+static const uint8_t channel_flags[SAMPLE_RATE_CHANNELS] = {
+    SAMPLE_HAS_TEMPERATURE, SAMPLE_HAS_HUMIDITY, SAMPLE_HAS_PRESSURE,
+};
+
+static int32_t channel_get(const sensor_sample_t *sample, int channel)
+{
+    switch (channel) {
+    case 0:
+        return sample->temperature;
+    case 1:
+        return sample->humidity;
+    default:
+        return (int32_t)sample->pressure;
+    }
+}
+
+static uint32_t distance(int32_t a, int32_t b)
+{
+    return a > b ? (uint32_t)(a - b) : (uint32_t)(b - a);
+}
+
+void sample_rate_init(sample_rate_t *rate, const sample_rate_config_t *config)
+{
+    memset(rate, 0, sizeof(*rate));
+    rate->period_ms = config->min_period_ms;
+}
+
+uint32_t sample_rate_update(sample_rate_t *rate, const sample_rate_config_t *config, const sensor_sample_t *sample)
+{
+    bool transient = false;
+    bool stable = true;
+
+    for (int ch = 0; ch < SAMPLE_RATE_CHANNELS; ch++) {
+        if (!(sample->flags & channel_flags[ch]) || config->change[ch] == 0) {
+            continue;
+        }
+        int32_t value = channel_get(sample, ch);
+        int32_t value_q = value * (1 << SAMPLE_RATE_FRAC_BITS);
+        if (rate->readings == 0) {
+            rate->mean[ch] = value_q;
+        } else {
+            uint32_t step = distance(value, rate->last[ch]);
+            uint32_t spread = distance(value_q, rate->mean[ch]) >> SAMPLE_RATE_FRAC_BITS;
+            uint32_t activity = step > spread ? step : spread;
+            transient |= activity > config->change[ch];
+            stable &= activity * 2 <= config->change[ch];
+            rate->mean[ch] += (value_q - rate->mean[ch]) >> SAMPLE_RATE_MEAN_SHIFT;
+        }
+        rate->last[ch] = value;
+    }
+
+    if (rate->readings++ == 0) {
+        return rate->period_ms;
+    }
+    if (transient) {
+        rate->period_ms = config->min_period_ms;
+    } else if (stable) {
+        uint32_t longer = rate->period_ms + rate->period_ms / 2;
+        rate->period_ms = longer < config->max_period_ms ? longer : config->max_period_ms;
+    }
+    return rate->period_ms;
+}
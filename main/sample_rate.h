@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Temperature, humidity, pressure, in the order of the SAMPLE_HAS_* bits
+#define SAMPLE_RATE_CHANNELS 3
+
+/**
+ * Bounds and sensitivity of an adaptive sampling period
+ */
+typedef struct
+{
+    uint32_t min_period_ms;     //!< period while the readings move
+    uint32_t max_period_ms;     //!< period reached after a stable stretch
+    uint16_t change[SAMPLE_RATE_CHANNELS]; //!< reading change that counts as a transient, in sample units
+                                           //!< (0.01 degC, 0.01 %RH, Pa); 0 ignores the channel
+} sample_rate_config_t;
+
+/**
+ * Adaptive period of one sensor
+ */
+typedef struct
+{
+    int32_t last[SAMPLE_RATE_CHANNELS];     //!< previous reading
+    int32_t mean[SAMPLE_RATE_CHANNELS];     //!< EWMA of the readings, 1/256 of the sample unit
+    uint32_t period_ms;                     //!< current period
+    uint32_t readings;
+} sample_rate_t;
+
+/**
+  * @brief  Start at the shortest period.
+  */
+void sample_rate_init(sample_rate_t *rate, const sample_rate_config_t *config);
+
+/**
+  * @brief  Adapt the period to a new reading. Its activity, per channel, is the larger of the
+  *         change from the previous reading (rate of change) and the distance to the recent
+  *         mean (spread). Above the channel's change threshold the period drops to the minimum
+  *         at once; below half of it on every channel the period grows by half, up to the
+  *         maximum; in between it is kept.
+  *
+  * @param  rate state of the sensor
+  * @param  config bounds and thresholds
+  * @param  sample new reading
+  *
+  * @return the period until the next reading, ms
+  */
+uint32_t sample_rate_update(sample_rate_t *rate, const sample_rate_config_t *config, const sensor_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
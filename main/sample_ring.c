@@ -0,0 +1,48 @@
+#include "sample_ring.h"
+#include <string.h>
+
+_Static_assert((SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1)) == 0, "SAMPLE_RING_SIZE must be a power of two");
+
+// The indexes run freely and wrap at 2^32, which SAMPLE_RING_SIZE divides: head - tail is the count.
+// Acquire/release ordering keeps the slot accesses on the right side of the index updates.
+
+void sample_ring_init(sample_ring_t *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+bool sample_ring_push(sample_ring_t *ring, const sensor_sample_t *sample, uint32_t stamp)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= SAMPLE_RING_SIZE) {
+        ring->overruns++;
+        return false;
+    }
+    ring->samples[head % SAMPLE_RING_SIZE] = *sample;
+    ring->stamps[head % SAMPLE_RING_SIZE] = stamp;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool sample_ring_pop(sample_ring_t *ring, sensor_sample_t *sample, uint32_t *stamp)
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+    *sample = ring->samples[tail % SAMPLE_RING_SIZE];
+    if (stamp) {
+        *stamp = ring->stamps[tail % SAMPLE_RING_SIZE];
+    }
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t sample_ring_count(const sample_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Capacity of a sample ring, a power of two
+#define SAMPLE_RING_SIZE 16
+
+/**
+ * Lock-free single-producer single-consumer queue of samples.
+ * One task pushes, one other task pops; neither blocks or disables interrupts.
+ * Each side only writes its own index, and publishes it after the slot it covers.
+ */
+typedef struct
+{
+    sensor_sample_t samples[SAMPLE_RING_SIZE];
+    uint32_t stamps[SAMPLE_RING_SIZE];  //!< caller-defined, e.g. the time the sample was taken
+    uint32_t head;                      //!< next slot to write, producer only
+    uint32_t tail;                      //!< next slot to read, consumer only
+    uint32_t overruns;                  //!< samples refused because the ring was full, producer only
+} sample_ring_t;
+
+/**
+  * @brief  Empty the ring. Not to be called while either side uses it.
+  */
+void sample_ring_init(sample_ring_t *ring);
+
+/**
+  * @brief  Append a sample, producer side.
+  *
+  * @param  ring the ring
+  * @param  sample sample to copy
+  * @param  stamp value returned with it by sample_ring_pop
+  *
+  * @return false if the ring is full; the sample is then counted in overruns and dropped
+  */
+bool sample_ring_push(sample_ring_t *ring, const sensor_sample_t *sample, uint32_t stamp);
+
+/**
+  * @brief  Take the oldest sample, consumer side.
+  *
+  * @param  ring the ring
+  * @param  sample output
+  * @param  stamp output, may be NULL
+  *
+  * @return false if the ring is empty
+  */
+bool sample_ring_pop(sample_ring_t *ring, sensor_sample_t *sample, uint32_t *stamp);
+
+/**
+  * @brief  Number of samples in the ring, from either side.
+  */
+uint32_t sample_ring_count(const sample_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
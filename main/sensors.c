@@ -0,0 +1,458 @@
+/*
+ * Sensor registry and scheduler.
+ *
+ * Every sensor runs on its own period from one task. The only blocking step is
+ * a DHT read (~25 ms, start signal included, and one at a time: the edge
+ * capture buffer is shared); BME280 conversions run in the sensor, so they are
+ * triggered first and collected when their maximum measurement time is over,
+ * in the gaps between DHT reads. Due times advance by whole periods from the
+ * first one, so the schedule does not drift with the time the reads take.
+ * An adaptive period changes after each reading; when it shortens, the next
+ * reading is brought forward to one new period after the last due time.
+ * A failed DHT read is retried between two due times, never sooner than the
+ * datasheet minimum interval after the failed one: a sensor read too early
+ * answers with the previous conversion or not at all.
+ * Settings changed at run time take effect between two readings: a new period
+ * counts from the last due time, new BME280 oversampling from the next trigger.
+ */
+#include "sensors.h"
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include "freertos/task.h"
+#include "bme280_calib_cache.h"
+#include "trace.h"
+
+#define SENSORS_INSTANCES_MAX 8     // per type, see SAMPLE_SENSOR_ID
+// Datasheet minimum interval between two reads, also the power-up time
+#define DHT11_MIN_PERIOD_MS 1000
+#define DHT22_MIN_PERIOD_MS 2000
+
+static const char *TAG = "SENSORS";
+
+typedef struct
+{
+    sensor_config_t config;
+    uint8_t id;                 // SAMPLE_SENSOR_ID
+    TickType_t period;
+    TickType_t next_due;
+    TickType_t min_gap;         // DHT: minimum interval between two reads
+    TickType_t retry_at;
+    bool retry_pending;
+    uint8_t retries;            // retries used in the current period
+    bool adaptive;
+    sample_rate_config_t rate_config;
+    sample_rate_t rate;
+    bool converting;            // BME280 conversion triggered, not read yet
+    bool reconfigure;           // BME280 settings changed, written before the next trigger
+    bme280_dev_t bme280;        // prebuilt command links point into it: must not move after setup
+    sensor_stats_t stats;
+} sensor_t;
+
+static sensor_t sensors[SENSORS_MAX];
+static size_t sensor_count;     // declared, then in use once sensors_init has run
+static uint8_t instance_count[2];
+
+static bool tick_reached(TickType_t now, TickType_t at)
+{
+    return (int32_t)(now - at) >= 0;
+}
+
+uint32_t sensors_get_min_period_ms(const sensor_config_t *config)
+{
+    if (config->type == SAMPLE_SENSOR_DHT) {
+        return config->dht.model == DHT_TYPE_DHT11 ? DHT11_MIN_PERIOD_MS : DHT22_MIN_PERIOD_MS;
+    }
+    // Humidity included: a BMP280 is only told apart once probed
+    bme280_dev_t dev = { .config = config->bme280, .chip_id = BME280_CHIP_ID };
+    return (bme280_dev_get_measurement_time_us(&dev) + 999) / 1000;
+}
+
+esp_err_t sensors_add(const sensor_config_t *config)
+{
+    if (config->type != SAMPLE_SENSOR_DHT && config->type != SAMPLE_SENSOR_BME280) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sensor_count == SENSORS_MAX || instance_count[config->type] == SENSORS_INSTANCES_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor_t *s = &sensors[sensor_count++];
+    memset(s, 0, sizeof(*s));
+    s->config = *config;
+    s->id = SAMPLE_SENSOR_ID(config->type, instance_count[config->type]++);
+    return ESP_OK;
+}
+
+static bool dht_setup(sensor_t *s)
+{
+    gpio_num_t gpio = s->config.dht.gpio;
+
+    // Keep interrupts enabled while the sensor answers, Wi-Fi timing depends on it
+    return dht_init(gpio, true) == ESP_OK && dht_set_decode_mode(gpio, DHT_DECODE_EDGE_CAPTURE) == ESP_OK;
+}
+
+static bool bme280_setup(sensor_t *s)
+{
+    bme280_dev_t *dev = &s->bme280;
+    uint8_t address = s->config.bme280.address;
+    bme280_calib_t stored;
+
+    if (!bme280_dev_probe(dev, s->config.bme280)) {
+        return false;
+    }
+    // Trimming coefficients are only read from a sensor the first time it is seen
+    bool cached = bme280_calib_cache_load(dev->chip_id, address, &stored);
+    if (!bme280_dev_setup(dev, cached ? &stored : NULL)) {
+        return false;
+    }
+    if (!cached) {
+        bme280_calib_cache_store(dev->chip_id, address, &dev->calib);
+    }
+    ESP_LOGI(TAG, "%s at 0x%02x, %u us conversions", bme280_dev_is_humidity_supported(dev) ? "BME280" : "BMP280",
+             address, bme280_dev_get_measurement_time_us(dev));
+    return true;
+}
+
+/* Period from the configuration, never below the sensor's minimum; restarts the adaptation. */
+static uint32_t sensor_set_period(sensor_t *s)
+{
+    uint32_t min_period_ms = sensors_get_min_period_ms(&s->config);
+    uint32_t period_ms = s->config.period_ms > min_period_ms ? s->config.period_ms : min_period_ms;
+
+    s->period = (period_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    s->adaptive = s->config.max_period_ms > period_ms;
+    s->rate_config.min_period_ms = period_ms;
+    s->rate_config.max_period_ms = s->config.max_period_ms;
+    memcpy(s->rate_config.change, s->config.change, sizeof(s->rate_config.change));
+    sample_rate_init(&s->rate, &s->rate_config);
+    s->stats.period_ms = period_ms;
+    return min_period_ms;
+}
+
+size_t sensors_init(bool powered)
+{
+    size_t declared = sensor_count;
+
+    sensor_count = 0;
+    for (size_t i = 0; i < declared; i++) {
+        sensor_t *s = &sensors[sensor_count];
+        if (sensor_count != i) {
+            *s = sensors[i]; // before setup, nothing points into it yet
+        }
+        bool ok = s->config.type == SAMPLE_SENSOR_DHT ? dht_setup(s) : bme280_setup(s);
+        if (!ok) {
+            ESP_LOGW(TAG, "Sensor %u not found, left out", s->id);
+            continue;
+        }
+
+        memset(&s->stats, 0, sizeof(s->stats));
+        s->stats.sensor = s->id;
+        uint32_t min_period_ms = sensor_set_period(s);
+        // First due once every sensor is set up; a DHT after its power-up time on a cold start
+        s->next_due = !powered && s->config.type == SAMPLE_SENSOR_DHT ? pdMS_TO_TICKS(min_period_ms) : 0;
+        s->min_gap = (min_period_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        s->retry_pending = false;
+        s->retries = 0;
+        s->converting = false;
+        s->reconfigure = false;
+        sensor_count++;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensors[i].next_due += now;
+    }
+    return sensor_count;
+}
+
+size_t sensors_count(void)
+{
+    return sensor_count;
+}
+
+esp_err_t sensors_configure(size_t index, const sensor_config_t *config)
+{
+    if (index >= sensor_count || config->type != sensors[index].config.type) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sensor_t *s = &sensors[index];
+    TickType_t last_due = s->next_due - s->period;
+
+    s->config.period_ms = config->period_ms;
+    s->config.max_period_ms = config->max_period_ms;
+    memcpy(s->config.change, config->change, sizeof(s->config.change));
+    if (s->config.type == SAMPLE_SENSOR_BME280) {
+        s->config.bme280.osrs_t = config->bme280.osrs_t;
+        s->config.bme280.osrs_p = config->bme280.osrs_p;
+        s->config.bme280.osrs_h = config->bme280.osrs_h;
+        s->config.bme280.t_sb = config->bme280.t_sb;
+        s->config.bme280.filter = config->bme280.filter;
+        s->reconfigure = true;
+    }
+    sensor_set_period(s);
+    // A due time already passed is caught up by the next sensors_run call, without a miss
+    s->next_due = last_due + s->period;
+    return ESP_OK;
+}
+
+const sensor_stats_t *sensors_get_stats(size_t index)
+{
+    return index < sensor_count ? &sensors[index].stats : NULL;
+}
+
+/* Next due time, skipping the periods that were missed entirely. */
+static void schedule_next(sensor_t *s, TickType_t now)
+{
+    uint32_t late_ms = (now - s->next_due) * portTICK_PERIOD_MS;
+    if (late_ms > s->stats.late_max_ms) {
+        s->stats.late_max_ms = late_ms;
+    }
+    s->next_due += s->period;
+    if (tick_reached(now, s->next_due)) {
+        uint32_t missed = (now - s->next_due) / s->period + 1;
+        s->stats.missed += missed;
+        s->next_due += missed * s->period;
+    }
+}
+
+/* Adaptive period: set from the reading just taken, before the callback can change it. */
+static void sample_adapt(sensor_t *s, const sensor_sample_t *sample)
+{
+    if (!s->adaptive) {
+        return;
+    }
+    uint32_t period_ms = sample_rate_update(&s->rate, &s->rate_config, sample);
+    TickType_t period = (period_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    if (period < s->period) {
+        // next_due is one old period after the due time of this reading
+        TickType_t sooner = s->next_due - s->period + period;
+        if ((int32_t)(s->next_due - sooner) > 0) {
+            s->next_due = sooner;
+        }
+    }
+    s->period = period;
+    s->stats.period_ms = period_ms;
+}
+
+static void sample_begin(const sensor_t *s, sensor_sample_t *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    sample->sensor = s->id;
+}
+
+/* Time of a driver call that started at start_us. */
+static void busy_add(sensor_t *s, int64_t start_us)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (us > s->stats.busy_max_us) {
+        s->stats.busy_max_us = us;
+    }
+}
+
+static bool dht_sample(sensor_t *s, sensors_sample_cb_t cb, void *arg)
+{
+    int16_t humidity = 0;
+    int16_t temperature = 0;
+    sensor_sample_t sample;
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = dht_read_data(s->config.dht.model, s->config.dht.gpio, &humidity, &temperature);
+    busy_add(s, start_us);
+    uint32_t critical_us = dht_get_last_critical_us();
+    if (critical_us > s->stats.critical_max_us) {
+        s->stats.critical_max_us = critical_us;
+    }
+    if (err != ESP_OK) {
+        s->stats.errors++;
+        if (err > ESP_ERR_DHT_BASE && err <= ESP_ERR_DHT_BASE + DHT_ERR_COUNT) {
+            s->stats.dht_failures[err - ESP_ERR_DHT_BASE - 1]++;
+        }
+        return false;
+    }
+    s->stats.samples++;
+    sample_begin(s, &sample);
+    // Tenths to hundredths
+    sample.temperature = temperature * 10;
+    sample.humidity = humidity * 10;
+    sample.flags = SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_HUMIDITY;
+    sample_adapt(s, &sample);
+    cb(&sample, arg);
+    return true;
+}
+
+/* A DHT read started at start, scheduled or retried. After a failure, a retry is set up one
+ * minimum interval later if there is one left and it comes before the next due time. */
+static void dht_attempt(sensor_t *s, TickType_t start, sensors_sample_cb_t cb, void *arg)
+{
+    bool retry = s->retry_pending;
+
+    s->retry_pending = false;
+    if (dht_sample(s, cb, arg)) {
+        s->stats.recovered += retry;
+        s->retries = 0;
+        return;
+    }
+    TickType_t at = start + s->min_gap;
+    if (s->retries < SENSORS_DHT_RETRIES && !tick_reached(at, s->next_due)) {
+        s->retries++;
+        s->stats.retries++;
+        s->retry_at = at;
+        s->retry_pending = true;
+        return;
+    }
+    s->retries = 0;
+    s->stats.lost++;
+}
+
+static void bme280_start(sensor_t *s)
+{
+    int64_t start_us = esp_timer_get_time();
+    if (s->reconfigure) {
+        s->reconfigure = !bme280_dev_reconfigure(&s->bme280, &s->config.bme280);
+        if (s->reconfigure) {
+            busy_add(s, start_us);
+            s->stats.errors++;
+            return;
+        }
+    }
+    s->converting = bme280_dev_start_forced_read(&s->bme280, NULL, NULL);
+    busy_add(s, start_us);
+    if (!s->converting) {
+        s->stats.errors++;
+    }
+}
+
+static void bme280_sample(sensor_t *s, bme280_read_state_t state, sensors_sample_cb_t cb, void *arg)
+{
+    const bme280_dev_t *dev = &s->bme280;
+    sensor_sample_t sample;
+
+    s->converting = false;
+    if (state != BME280_READ_DONE) {
+        s->stats.errors++;
+        return;
+    }
+    s->stats.samples++;
+    sample_begin(s, &sample);
+    // Temperature in 0.01 degC, pressure in Pa, humidity in Q22.10 %RH
+    sample.temperature = bme280_dev_get_temperature(dev);
+    sample.pressure = bme280_dev_get_pressure(dev);
+    sample.flags = SAMPLE_HAS_TEMPERATURE | SAMPLE_HAS_PRESSURE;
+    if (bme280_dev_is_humidity_supported(dev)) {
+        sample.humidity = (bme280_dev_get_humidity(dev) * 100 + 512) >> 10;
+        sample.flags |= SAMPLE_HAS_HUMIDITY;
+    }
+    sample_adapt(s, &sample);
+    cb(&sample, arg);
+}
+
+/* Read the conversions whose maximum measurement time is over. */
+static void bme280_collect(TickType_t now, sensors_sample_cb_t cb, void *arg)
+{
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->converting && tick_reached(now, bme280_dev_get_ready_tick(&s->bme280))) {
+            int64_t start_us = esp_timer_get_time();
+            bme280_read_state_t state = bme280_dev_poll_forced_read(&s->bme280);
+            busy_add(s, start_us);
+            if (state != BME280_READ_MEASURING) {
+                bme280_sample(s, state, cb, arg);
+            }
+        }
+    }
+}
+
+TickType_t sensors_run(sensors_sample_cb_t cb, void *arg)
+{
+    TRACE_BEGIN(SENSORS_RUN);
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+
+        // Conversions first: they go on in the sensors while the DHTs are read
+        for (size_t i = 0; i < sensor_count; i++) {
+            sensor_t *s = &sensors[i];
+            if (s->config.type == SAMPLE_SENSOR_BME280 && !s->converting && tick_reached(now, s->next_due)) {
+                bme280_start(s);
+                schedule_next(s, now);
+            }
+        }
+        for (size_t i = 0; i < sensor_count; i++) {
+            sensor_t *s = &sensors[i];
+            now = xTaskGetTickCount();
+            if (s->config.type != SAMPLE_SENSOR_DHT) {
+                continue;
+            }
+            if (s->retry_pending ? tick_reached(now, s->retry_at) : tick_reached(now, s->next_due)) {
+                if (!s->retry_pending) {
+                    schedule_next(s, now);
+                }
+                dht_attempt(s, now, cb, arg);
+                bme280_collect(xTaskGetTickCount(), cb, arg);
+            }
+        }
+        bme280_collect(xTaskGetTickCount(), cb, arg);
+
+        // Sleep until the next due time or end of conversion; loop if one passed meanwhile
+        now = xTaskGetTickCount();
+        int32_t wait = INT32_MAX;
+        for (size_t i = 0; i < sensor_count; i++) {
+            const sensor_t *s = &sensors[i];
+            TickType_t at = s->converting ? bme280_dev_get_ready_tick(&s->bme280) :
+                            s->retry_pending ? s->retry_at : s->next_due;
+            if ((int32_t)(at - now) < wait) {
+                wait = (int32_t)(at - now);
+            }
+        }
+        if (wait > 0) {
+            TRACE_END(SENSORS_RUN);
+            return wait == INT32_MAX ? portMAX_DELAY : (TickType_t)wait;
+        }
+    }
+}
+
+void sensors_read_all(sensors_sample_cb_t cb, void *arg)
+{
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->config.type == SAMPLE_SENSOR_BME280 && !s->converting) {
+            bme280_start(s);
+        }
+    }
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->config.type == SAMPLE_SENSOR_DHT) {
+            // Power-up time after a cold start
+            int32_t early = (int32_t)(s->next_due - xTaskGetTickCount());
+            if (early > 0) {
+                vTaskDelay(early);
+            }
+            for (int attempt = 0; ; attempt++) {
+                if (dht_sample(s, cb, arg)) {
+                    s->stats.recovered += attempt > 0;
+                    break;
+                }
+                bme280_collect(xTaskGetTickCount(), cb, arg);
+                if (attempt == SENSORS_DHT_RETRIES) {
+                    s->stats.lost++;
+                    break;
+                }
+                s->stats.retries++;
+                vTaskDelay(s->min_gap);
+            }
+            bme280_collect(xTaskGetTickCount(), cb, arg);
+        }
+    }
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensor_t *s = &sensors[i];
+        if (s->converting) {
+            bme280_sample(s, bme280_dev_wait_forced_read(&s->bme280), cb, arg);
+        }
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    for (size_t i = 0; i < sensor_count; i++) {
+        sensors[i].next_due = now + sensors[i].period;
+        sensors[i].retry_pending = false;
+        sensors[i].retries = 0;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "dht.h"
+#include "i2c_bme280.h"
+#include "sample.h"
+#include "sample_rate.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSORS_MAX 8
+// Extra attempts at a failed DHT read within one period
+#define SENSORS_DHT_RETRIES 2
+
+/**
+ * One sensor of the node, as declared to the registry
+ */
+typedef struct
+{
+    sample_sensor_t type;       //!< SAMPLE_SENSOR_DHT or SAMPLE_SENSOR_BME280
+    uint32_t period_ms;         //!< sampling period, raised to the sensor's minimum (sensors_get_min_period_ms)
+    uint32_t max_period_ms;     //!< above period_ms, the period adapts between the two to how much the
+                                //!< readings move (sample_rate.h); 0 for a fixed period
+    uint16_t change[SAMPLE_RATE_CHANNELS]; //!< adaptive period: reading change that brings it back to
+                                           //!< period_ms, in sample units (temperature, humidity, pressure)
+    union
+    {
+        struct
+        {
+            dht_sensor_type_t model;
+            gpio_num_t gpio;
+        } dht;
+        bme280_config_t bme280; //!< BME280 or BMP280, forced mode
+    };
+} sensor_config_t;
+
+/**
+ * Counters of one registered sensor
+ */
+typedef struct
+{
+    uint8_t sensor;             //!< SAMPLE_SENSOR_ID
+    uint32_t samples;           //!< successful reads
+    uint32_t errors;            //!< failed reads, retries included
+    uint32_t retries;           //!< DHT reads repeated after a failure
+    uint32_t recovered;         //!< DHT samples obtained by a retry
+    uint32_t lost;              //!< DHT periods without a sample, retries exhausted
+    uint32_t dht_failures[DHT_ERR_COUNT]; //!< failed DHT reads by cause, ESP_ERR_DHT_* - ESP_ERR_DHT_BASE - 1
+    uint32_t missed;            //!< periods skipped because the sensor was serviced too late
+    uint32_t late_max_ms;       //!< worst delay between a due time and the read or trigger, tick resolution
+    uint32_t period_ms;         //!< current sampling period
+    uint32_t busy_max_us;       //!< longest driver call: a DHT read, a BME280 trigger or data read
+    uint32_t critical_max_us;   //!< DHT: longest time with interrupts held off (dht_get_last_critical_us)
+} sensor_stats_t;
+
+/**
+ * Called with each new sample. The timestamp and boot are left 0 for the callback to set.
+ */
+typedef void (*sensors_sample_cb_t)(sensor_sample_t *sample, void *arg);
+
+/**
+  * @brief  Declare a sensor. Sensors are identified in samples by their type and their
+  *         registration order among the sensors of that type (SAMPLE_SENSOR_ID).
+  *
+  * @param  config sensor declaration, copied
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_ARG Unknown type
+  *     - ESP_ERR_NO_MEM SENSORS_MAX sensors, or 8 of that type, already declared
+  */
+esp_err_t sensors_add(const sensor_config_t *config);
+
+/**
+  * @brief  Set up the declared sensors. A BME280 that does not answer is left out; a DHT
+  *         cannot be detected and is kept. BME280 trimming coefficients come from
+  *         bme280_calib_cache when known, and are stored there otherwise.
+  *
+  * @param  powered true if the sensors stayed powered since the last reading (wake from
+  *         deep sleep): DHT sensors are then read at once instead of after their power-up time
+  *
+  * @return number of sensors in use
+  */
+size_t sensors_init(bool powered);
+
+/**
+  * @brief  Number of sensors in use after sensors_init.
+  */
+size_t sensors_count(void);
+
+/**
+  * @brief  Shortest period a sensor can be sampled at: the datasheet minimum interval between
+  *         two DHT reads, the maximum measurement time of a BME280 for its oversampling.
+  */
+uint32_t sensors_get_min_period_ms(const sensor_config_t *config);
+
+/**
+  * @brief  Run the sensors that are due, each on its own period. BME280 conversions are
+  *         triggered before the DHT reads, which block the caller, so they overlap; every
+  *         finished conversion is read as soon as its data is ready. A failed DHT read is
+  *         retried up to SENSORS_DHT_RETRIES times, each after the sensor's minimum interval,
+  *         as long as the retry comes before the next period.
+  *         Call it again after the returned delay, from a single task.
+  *
+  * @param  cb called from this function with each new sample
+  * @param  arg passed to cb
+  *
+  * @return ticks until the next sensor is due or a conversion completes, at least 1
+  */
+TickType_t sensors_run(sensors_sample_cb_t cb, void *arg);
+
+/**
+  * @brief  Take one sample from every sensor now, regardless of the periods, overlapping the
+  *         BME280 conversions with the DHT reads. Blocks until all are done, failed DHT reads
+  *         included: their retries wait for the minimum interval.
+  *
+  * @param  cb called from this function with each new sample
+  * @param  arg passed to cb
+  */
+void sensors_read_all(sensors_sample_cb_t cb, void *arg);
+
+/**
+  * @brief  Change the sampling settings of a sensor in use, from the task running the sensors.
+  *         The periods and change thresholds apply at once, the next reading coming one new
+  *         period after the last due time; BME280 oversampling, standby time and filter are
+  *         written to the sensor before its next conversion. Type, pins, address and model
+  *         stay as declared.
+  *
+  * @param  index sensor in [0, sensors_count())
+  * @param  config new settings, of the sensor's type
+  *
+  * @return
+  *     - ESP_OK Success
+  *     - ESP_ERR_INVALID_ARG No such sensor, or of another type
+  */
+esp_err_t sensors_configure(size_t index, const sensor_config_t *config);
+
+/**
+  * @brief  Counters of a sensor in use, by index in [0, sensors_count()).
+  */
+const sensor_stats_t *sensors_get_stats(size_t index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+#include "telemetry.h"
+#include <string.h>
+
+#define TELEMETRY_HEADER_SIZE (1 + 3 * 4 + 1)
+#define TELEMETRY_TASK_SIZE (1 + 2 + 4)
+#define TELEMETRY_TRAILER_SIZE (5 * 2 + 4 * 4 + 1 + TELEMETRY_LATENCY_BUCKETS * 2)
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint8_t *put_u16_saturated(uint8_t *p, uint32_t v)
+{
+    return put_u16(p, v > 0xFFFF ? 0xFFFF : (uint16_t)v);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t telemetry_latency_bucket(uint32_t us)
+{
+    size_t bucket = 0;
+    uint32_t bound = TELEMETRY_LATENCY_BASE_US;
+
+    while (us >= bound && bucket < TELEMETRY_LATENCY_BUCKETS - 1) {
+        bucket++;
+        bound <<= 2;
+    }
+    return bucket;
+}
+
+size_t telemetry_encode(const telemetry_t *t, uint8_t *buf, size_t size)
+{
+    size_t len = TELEMETRY_HEADER_SIZE + t->task_count * TELEMETRY_TASK_SIZE + TELEMETRY_TRAILER_SIZE;
+
+    if (t->task_count > TELEMETRY_TASKS_MAX || len > size) {
+        return 0;
+    }
+
+    uint8_t *p = buf;
+    *p++ = TELEMETRY_VERSION;
+    p = put_u32(p, t->uptime_s);
+    p = put_u32(p, t->free_heap);
+    p = put_u32(p, t->min_free_heap);
+    *p++ = t->task_count;
+    for (size_t i = 0; i < t->task_count; i++) {
+        *p++ = t->tasks[i].id;
+        p = put_u16(p, t->tasks[i].stack_free);
+        p = put_u32(p, t->tasks[i].busy_us);
+    }
+    p = put_u16_saturated(p, t->dht_critical_max_us);
+    p = put_u16_saturated(p, t->i2c_max_us);
+    p = put_u16_saturated(p, t->late_max_ms);
+    p = put_u16_saturated(p, t->run_max_ms);
+    p = put_u16_saturated(p, t->queue_max_ms);
+    p = put_u32(p, t->samples);
+    p = put_u32(p, t->errors);
+    p = put_u32(p, t->filtered);
+    p = put_u32(p, t->dropped);
+    *p++ = TELEMETRY_LATENCY_BUCKETS;
+    for (size_t i = 0; i < TELEMETRY_LATENCY_BUCKETS; i++) {
+        p = put_u16(p, t->publish_latency[i]);
+    }
+    return len;
+}
+
+bool telemetry_decode(const uint8_t *buf, size_t len, telemetry_t *t)
+{
+    const uint8_t *p = buf;
+
+    if (len < TELEMETRY_HEADER_SIZE || buf[0] != TELEMETRY_VERSION ||
+        buf[TELEMETRY_HEADER_SIZE - 1] > TELEMETRY_TASKS_MAX) {
+        return false;
+    }
+    memset(t, 0, sizeof(*t));
+    t->task_count = buf[TELEMETRY_HEADER_SIZE - 1];
+    if (len != TELEMETRY_HEADER_SIZE + t->task_count * TELEMETRY_TASK_SIZE + TELEMETRY_TRAILER_SIZE ||
+        buf[len - 1 - TELEMETRY_LATENCY_BUCKETS * 2] != TELEMETRY_LATENCY_BUCKETS) {
+        return false;
+    }
+    p++;
+    t->uptime_s = get_u32(p);
+    t->free_heap = get_u32(p + 4);
+    t->min_free_heap = get_u32(p + 8);
+    p += 12 + 1;
+    for (size_t i = 0; i < t->task_count; i++) {
+        t->tasks[i].id = p[0];
+        t->tasks[i].stack_free = get_u16(p + 1);
+        t->tasks[i].busy_us = get_u32(p + 3);
+        p += TELEMETRY_TASK_SIZE;
+    }
+    t->dht_critical_max_us = get_u16(p);
+    t->i2c_max_us = get_u16(p + 2);
+    t->late_max_ms = get_u16(p + 4);
+    t->run_max_ms = get_u16(p + 6);
+    t->queue_max_ms = get_u16(p + 8);
+    p += 10;
+    t->samples = get_u32(p);
+    t->errors = get_u32(p + 4);
+    t->filtered = get_u32(p + 8);
+    t->dropped = get_u32(p + 12);
+    p += 16 + 1;
+    for (size_t i = 0; i < TELEMETRY_LATENCY_BUCKETS; i++) {
+        t->publish_latency[i] = get_u16(p + 2 * i);
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Self-metrics of the node, as published on the diagnostics topic. Little endian:
+ *
+ *   u8  version (TELEMETRY_VERSION)
+ *   u32 uptime, seconds
+ *   u32 free heap, bytes
+ *   u32 lowest free heap since boot, bytes
+ *   u8  number of tasks
+ *   per task:
+ *     u8  TELEMETRY_TASK_* id
+ *     u16 stack high-water mark: least free stack since the task started
+ *     u32 busy time since boot, us, wrapping: time spent in the task's own work
+ *   u16 longest DHT critical section, us           (saturated at 0xFFFF)
+ *   u16 longest BME280 I2C call, us                (saturated)
+ *   u16 worst sampling delay past a due time, ms   (saturated)
+ *   u16 longest sensors_run call, ms               (saturated)
+ *   u16 longest wait of a sample for the publisher, ms (saturated)
+ *   u32 samples taken
+ *   u32 failed sensor reads
+ *   u32 samples filtered out
+ *   u32 samples dropped, sampler ahead of the publisher
+ *   u8  number of publish latency buckets
+ *   per bucket: u16 publishes that took under 250 us << 2 * bucket, the last bucket counts
+ *               every slower one (saturated)
+ *
+ * Counters run since boot: a regression shows as a change of slope between reports.
+ */
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_TASKS_MAX 4
+#define TELEMETRY_LATENCY_BUCKETS 8
+#define TELEMETRY_LATENCY_BASE_US 250
+
+// Buffer size that always fits an encoded report
+#define TELEMETRY_MAX_SIZE (1 + 3 * 4 + 1 + TELEMETRY_TASKS_MAX * (1 + 2 + 4) + 5 * 2 + 4 * 4 + \
+                            1 + TELEMETRY_LATENCY_BUCKETS * 2)
+
+typedef enum
+{
+    TELEMETRY_TASK_SAMPLER = 0,
+    TELEMETRY_TASK_PUBLISHER,
+    TELEMETRY_TASK_MQTT,
+} telemetry_task_id_t;
+
+typedef struct
+{
+    uint8_t id;                 //!< telemetry_task_id_t
+    uint16_t stack_free;        //!< uxTaskGetStackHighWaterMark
+    uint32_t busy_us;
+} telemetry_task_t;
+
+/**
+ * One report
+ */
+typedef struct
+{
+    uint32_t uptime_s;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint8_t task_count;
+    telemetry_task_t tasks[TELEMETRY_TASKS_MAX];
+    uint32_t dht_critical_max_us;
+    uint32_t i2c_max_us;
+    uint32_t late_max_ms;
+    uint32_t run_max_ms;
+    uint32_t queue_max_ms;
+    uint32_t samples;
+    uint32_t errors;
+    uint32_t filtered;
+    uint32_t dropped;
+    uint16_t publish_latency[TELEMETRY_LATENCY_BUCKETS];
+} telemetry_t;
+
+/**
+  * @brief  Latency histogram bucket of a duration: 0 under TELEMETRY_LATENCY_BASE_US, then
+  *         one bucket per factor of 4, the last one open-ended.
+  */
+size_t telemetry_latency_bucket(uint32_t us);
+
+/**
+  * @brief  Encode a report.
+  *
+  * @param  t report, at most TELEMETRY_TASKS_MAX tasks
+  * @param  buf output buffer
+  * @param  size size of buf, TELEMETRY_MAX_SIZE is always enough
+  *
+  * @return number of bytes written, 0 if buf is too small or there are too many tasks
+  */
+size_t telemetry_encode(const telemetry_t *t, uint8_t *buf, size_t size);
+
+/**
+  * @brief  Decode a report. Durations come back saturated as they were sent.
+  *
+  * @return true if buf holds a whole report of this version
+  */
+bool telemetry_decode(const uint8_t *buf, size_t len, telemetry_t *t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+#include "trace.h"
+#include <stdio.h>
+
+#define TRACE_EVENT_NAME(name, track) #name,
+#define TRACE_EVENT_TRACK(name, track) track,
+static const char *const event_names[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_EVENT_NAME) };
+static const char *const event_tracks[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_EVENT_TRACK) };
+
+const char *trace_event_name(uint8_t event)
+{
+    return event < TRACE_EVENT_COUNT ? event_names[event] : NULL;
+}
+
+const char *trace_event_track(uint8_t event)
+{
+    return event < TRACE_EVENT_COUNT ? event_tracks[event] : NULL;
+}
+
+#if TRACE_ENABLED
+#include <sdkconfig.h>
+#include <esp_attr.h>
+#include <driver/soc.h> // soc_get_ccount
+
+_Static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of two");
+
+// Tag of a complete entry, never 0: 0 marks a slot being written
+#define TRACE_SEQ(index) ((uint16_t)(0x8000 | ((index) & 0x7FFF)))
+
+typedef struct
+{
+    uint32_t ccount;
+    uint8_t event;
+    uint8_t phase;
+    uint16_t seq;
+} trace_entry_t;
+
+static trace_entry_t trace_entries[TRACE_BUFFER_SIZE];
+static uint32_t trace_head;     // next index to claim, all writers; runs freely like sample_ring
+static uint32_t trace_tail;     // next index to dump, trace_dump only
+static uint32_t trace_lost;
+
+void IRAM_ATTR trace_record(trace_event_t event, uint8_t phase)
+{
+    uint32_t ccount = soc_get_ccount();
+    uint32_t index = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    trace_entry_t *e = &trace_entries[index % TRACE_BUFFER_SIZE];
+
+    // Invalidate, fill, tag: a dump reading the slot meanwhile sees the tag change and skips it
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->ccount = ccount;
+    e->event = event;
+    e->phase = phase;
+    __atomic_store_n(&e->seq, TRACE_SEQ(index), __ATOMIC_RELEASE);
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+size_t trace_dump(uint8_t *buf, size_t size)
+{
+    if (size < TRACE_DUMP_HEADER_SIZE) {
+        return 0;
+    }
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+    uint32_t index = head - trace_tail > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : trace_tail;
+    size_t max = (size - TRACE_DUMP_HEADER_SIZE) / TRACE_DUMP_ENTRY_SIZE;
+    uint8_t *p = buf + TRACE_DUMP_HEADER_SIZE;
+    uint16_t count = 0;
+
+    trace_lost += index - trace_tail;
+    // What does not fit in buf is left for the next dump
+    for (; index != head && count < max; index++) {
+        const trace_entry_t *e = &trace_entries[index % TRACE_BUFFER_SIZE];
+        uint16_t seq = TRACE_SEQ(index);
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq) {
+            trace_lost++; // overwritten by a newer entry, or still being written
+            continue;
+        }
+        trace_entry_t entry = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq) {
+            trace_lost++;
+            continue;
+        }
+        p = put_u32(p, entry.ccount);
+        *p++ = entry.event;
+        *p++ = entry.phase;
+        count++;
+    }
+    trace_tail = index;
+
+    buf[0] = TRACE_DUMP_VERSION;
+    buf[1] = CONFIG_ESP8266_DEFAULT_CPU_FREQ_MHZ;
+    put_u16(buf + 2, count);
+    put_u32(buf + 4, trace_lost);
+    trace_lost = 0;
+    return p - buf;
+}
+
+void trace_print(void)
+{
+    static uint8_t dump[TRACE_DUMP_MAX_SIZE];
+    size_t len = trace_dump(dump, sizeof(dump));
+
+    printf("trace> ");
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", dump[i]);
+    }
+    printf("\n");
+}
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hot-path tracing: TRACE_BEGIN/TRACE_END/TRACE_MARK record (event, phase, CCOUNT) into a
+ * static ring. Writers, tasks and ISRs alike, claim a slot with one atomic increment and
+ * never wait; the oldest entries are overwritten. trace_dump() drains the ring into a
+ * binary dump, sent over MQTT or printed on the UART (trace_print), which
+ * host/trace_to_chrome turns into Chrome trace JSON (chrome://tracing, Perfetto).
+ *
+ * Built with TRACE_ENABLED=1 only; otherwise the macros compile to nothing and only the
+ * event names are left, for the tools.
+ *
+ * Dump, little endian:
+ *
+ *   u8  version (TRACE_DUMP_VERSION)
+ *   u8  CPU frequency, MHz
+ *   u16 number of entries
+ *   u32 entries lost since the previous dump: overwritten, or written while dumping
+ *   per entry, oldest first:
+ *     u32 CCOUNT, wraps every 2^32 cycles (53 s at 80 MHz)
+ *     u8  event, trace_event_t
+ *     u8  phase, 'B' begin, 'E' end, 'I' instant
+ */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+// Entries kept, a power of two: 8 bytes each
+#define TRACE_BUFFER_SIZE 256
+#define TRACE_DUMP_VERSION 1
+#define TRACE_DUMP_HEADER_SIZE 8
+#define TRACE_DUMP_ENTRY_SIZE 6
+// Buffer size that always fits a dump of the whole ring
+#define TRACE_DUMP_MAX_SIZE (TRACE_DUMP_HEADER_SIZE + TRACE_BUFFER_SIZE * TRACE_DUMP_ENTRY_SIZE)
+
+// Event, track (one timeline per track in the trace viewer)
+#define TRACE_EVENTS(X)              \
+    X(SENSORS_RUN, "sensors")        \
+    X(DHT_READ, "sensors")           \
+    X(DHT_FETCH, "sensors")          \
+    X(DHT_CAPTURE, "sensors")        \
+    X(DHT_DECODE, "sensors")         \
+    X(I2C_CMD, "i2c")                \
+    X(BME280_COMPENSATE, "i2c")      \
+    X(PUBLISH_FLUSH, "publisher")    \
+    X(MQTT_PUBLISH, "publisher")     \
+    X(LOG_APPEND, "publisher")       \
+    X(LOG_DRAIN, "publisher")
+
+typedef enum
+{
+#define TRACE_EVENT_ENUM(name, track) TRACE_##name,
+    TRACE_EVENTS(TRACE_EVENT_ENUM)
+#undef TRACE_EVENT_ENUM
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(event) trace_record(TRACE_##event, 'B')
+#define TRACE_END(event) trace_record(TRACE_##event, 'E')
+#define TRACE_MARK(event) trace_record(TRACE_##event, 'I')
+#else
+#define TRACE_BEGIN(event) ((void)0)
+#define TRACE_END(event) ((void)0)
+#define TRACE_MARK(event) ((void)0)
+#endif
+
+/**
+  * @brief  Record an event now. Safe from tasks and ISRs; use the macros.
+  */
+void trace_record(trace_event_t event, uint8_t phase);
+
+/**
+  * @brief  Move the entries recorded since the previous dump into buf. Recording goes on
+  *         meanwhile: entries overwritten before they are copied are counted as lost, the ones
+  *         that do not fit in buf are left for the next dump. From one task at a time.
+  *
+  * @param  buf output buffer
+  * @param  size size of buf, TRACE_DUMP_MAX_SIZE is always enough
+  *
+  * @return number of bytes written, 0 if buf cannot hold the header
+  */
+size_t trace_dump(uint8_t *buf, size_t size);
+
+/**
+  * @brief  trace_dump() printed on the console as one "trace> <hex>" line.
+  */
+void trace_print(void);
+
+/**
+  * @brief  Name and track of an event, for tools.
+  *
+  * @return NULL for an unknown event
+  */
+const char *trace_event_name(uint8_t event);
+const char *trace_event_track(uint8_t event);
+
+#ifdef __cplusplus
+}
+#endif